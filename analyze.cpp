@@ -0,0 +1,108 @@
+#include "./include/CaptureAnalyzer.hpp"
+
+#include <fstream>
+#include <getopt.h>
+#include <iostream>
+#include <thread>
+
+/**
+ * @brief  Prints analyzer help
+ * @retval None
+ */
+void printAnalyzeHelp() {
+  std::cout << "usage: isa-analyze [ <option> ... ] <capture.pcap[ng]>"
+            << std::endl
+            << "Options:" << std::endl
+            << "[-h | --help]" << std::endl
+            << "  Show this help" << std::endl
+            << "[-c | --capture-port] <port>" << std::endl
+            << "  Server port in the capture (default 32323)" << std::endl
+            << "[-j | --threads]  <count>" << std::endl
+            << "  Number of worker threads (default number of cores)"
+            << std::endl
+            << "--json <file>" << std::endl
+            << "  Export the report in JSON format" << std::endl;
+}
+
+/**
+ * @brief  Prints problem with analyzer arguments and exits
+ * @param  problem: type of problem
+ * @retval None
+ */
+void analyzeProblem(const std::string problem) {
+  std::cerr << "Invalid " << problem
+            << " , see help {-h | --help} for more info." << std::endl;
+  exit(1);
+}
+
+/**
+ * @brief  Analyzer main function
+ * @param  argc: number of strings pointed to by argv
+ * @param  **argv: array of arguments
+ * @retval 0
+ */
+int main(int argc, char **argv) {
+  int capture_port{32323};
+  int threads = static_cast<int>(std::thread::hardware_concurrency());
+  std::string json_file;
+
+  static struct option long_options[] = {
+      {"capture-port", required_argument, 0, 'c'},
+      {"threads", required_argument, 0, 'j'},
+      {"json", required_argument, 0, 'J'},
+      {"help", no_argument, 0, 'h'},
+      {0, 0, 0, 0}};
+
+  int c;
+  int option_index;
+  try {
+    while ((c = getopt_long(argc, argv, "c:j:h", long_options,
+                            &option_index)) != -1) {
+      switch (c) {
+      case 'c':
+        capture_port = std::stoi(optarg);
+        if (capture_port <= 0 || capture_port > 65535) {
+          analyzeProblem("capture port");
+        }
+        break;
+      case 'j':
+        threads = std::stoi(optarg);
+        if (threads <= 0) {
+          analyzeProblem("threads");
+        }
+        break;
+      case 'J':
+        json_file = optarg;
+        break;
+      case 'h':
+        printAnalyzeHelp();
+        exit(0);
+      default:
+        analyzeProblem("option");
+      }
+    }
+  } catch (const std::exception &) {
+    analyzeProblem("option value");
+  }
+  if (optind != argc - 1) {
+    analyzeProblem("arguments");
+  }
+
+  CaptureAnalyzer analyzer(static_cast<uint16_t>(capture_port), threads);
+  if (!analyzer.analyze(argv[optind])) {
+    std::cerr << "ERR: Capture could not be read :(" << std::endl;
+    exit(1);
+  }
+  analyzer.printReport(std::cout);
+
+  if (!json_file.empty()) {
+    std::ofstream file(json_file);
+    if (!file.is_open()) {
+      std::cerr << "ERR: Report could not be saved :(" << std::endl;
+      exit(1);
+    }
+    analyzer.writeJson(file);
+  }
+
+  return 0;
+}
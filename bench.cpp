@@ -0,0 +1,331 @@
+#include "./include/ArgsParser.hpp"
+#include "./include/LoadGenerator.hpp"
+#include "./include/Stats.hpp"
+#include "./include/TraceWriter.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <getopt.h>
+#include <iostream>
+#include <thread>
+
+/**
+ * @brief  Prints load generator help
+ * @retval None
+ */
+void printBenchHelp() {
+  std::cout << "usage: isa-bench [ <option> ... ]" << std::endl
+            << "Options:" << std::endl
+            << "[-h | --help]" << std::endl
+            << "  Show this help" << std::endl
+            << "[-a | --address]  <address>" << std::endl
+            << "  Server hostname or address to connect to (default localhost)"
+            << std::endl
+            << "[-p | --port]     <port>" << std::endl
+            << "  Server port to connect to (default 32323)" << std::endl
+            << "[-u | --users]    <count>" << std::endl
+            << "  Number of simulated users (default 1)" << std::endl
+            << "[-d | --duration] <seconds>" << std::endl
+            << "  Duration of the measured phase (default 10)" << std::endl
+            << "[-n | --requests] <count>" << std::endl
+            << "  Total number of requests, overrides duration" << std::endl
+            << "[-m | --mix]      <command>=<weight>,..." << std::endl
+            << "  Operation mix (default list=4,fetch=4,send=2,login=1,"
+               "logout=1)"
+            << std::endl
+            << "[-s | --body-size] <bytes>" << std::endl
+            << "  Size of bodies of sent messages (default 64)" << std::endl
+            << "--csv <file>" << std::endl
+            << "  Export results in CSV format" << std::endl
+            << "--json <file>" << std::endl
+            << "  Export results in JSON format" << std::endl
+            << "--async" << std::endl
+            << "  Run all users as coroutines of one event loop thread"
+            << std::endl
+            << "--shards <count>" << std::endl
+            << "  Run async users on event loops pinned to cores, 0 for one "
+               "per core, implies"
+            << std::endl
+            << "  --async" << std::endl
+            << "[-t | --timeout] <ms>" << std::endl
+            << "  Time limit of one request in the async mode (default none)"
+            << std::endl
+            << "--hedge <percentile>" << std::endl
+            << "  Duplicate list and fetch not answered within the percentile "
+               "of latencies, implies --async"
+            << std::endl
+            << "--hedge-address <address>" << std::endl
+            << "  Server receiving duplicates (default the server)" << std::endl
+            << "--hedge-port <port>" << std::endl
+            << "  Port of the server receiving duplicates (default the port)"
+            << std::endl
+            << "--trace <file>" << std::endl
+            << "  Export spans of requests in Chrome Trace Event format"
+            << std::endl
+            << "--max-allocs <count>" << std::endl
+            << "  Fail when steady-state requests of an operation allocate "
+               "more on average"
+            << std::endl
+            << "--pool <count>" << std::endl
+            << "  Take connections from a pool of at most count per server, "
+               "spares connect"
+            << std::endl
+            << "  while the response is handled" << std::endl
+            << "--pool-idle <ms>" << std::endl
+            << "  Time an idle pooled connection is kept (default 5000)"
+            << std::endl;
+}
+
+/**
+ * @brief  Prints problem with bench arguments and exits
+ * @param  problem: type of problem
+ * @retval None
+ */
+void benchProblem(const std::string problem) {
+  std::cerr << "Invalid " << problem
+            << " , see help {-h | --help} for more info." << std::endl;
+  exit(1);
+}
+
+/**
+ * @brief  Writes exported results to the file
+ * @param  &generator: finished load generator run
+ * @param  filename: output file
+ * @param  csv: True: CSV format | False: JSON format
+ * @retval None
+ */
+void exportResults(const LoadGenerator &generator, const std::string filename,
+                   bool csv) {
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    std::cerr << "ERR: Results could not be saved :(" << std::endl;
+    exit(1);
+  }
+  if (csv) {
+    generator.writeCsv(file);
+  } else {
+    generator.writeJson(file);
+  }
+}
+
+/**
+ * @brief  Writes collected trace to the file
+ * @param  &trace: collected spans
+ * @param  filename: output file
+ * @retval None
+ */
+void exportTrace(const TraceWriter &trace, const std::string filename) {
+  std::ofstream file(filename);
+  if (!file.is_open()) {
+    std::cerr << "ERR: Trace could not be saved :(" << std::endl;
+    exit(1);
+  }
+  trace.write(file);
+}
+
+/**
+ * @brief  Load generator main function
+ * @param  argc: number of strings pointed to by argv
+ * @param  **argv: array of arguments
+ * @retval 0
+ */
+int main(int argc, char **argv) {
+  LoadConfig config;
+  std::string csv_file;
+  std::string json_file;
+  std::string trace_file;
+  std::string hedge_address;
+  int hedge_port{};
+  double max_allocs{-1};
+  size_t pool_size{};
+  uint64_t pool_idle{5000};
+
+  static struct option long_options[] = {
+      {"address", required_argument, 0, 'a'},
+      {"port", required_argument, 0, 'p'},
+      {"users", required_argument, 0, 'u'},
+      {"duration", required_argument, 0, 'd'},
+      {"requests", required_argument, 0, 'n'},
+      {"mix", required_argument, 0, 'm'},
+      {"body-size", required_argument, 0, 's'},
+      {"csv", required_argument, 0, 'C'},
+      {"json", required_argument, 0, 'J'},
+      {"trace", required_argument, 0, 'T'},
+      {"async", no_argument, 0, 'A'},
+      {"shards", required_argument, 0, 'X'},
+      {"timeout", required_argument, 0, 't'},
+      {"hedge", required_argument, 0, 'H'},
+      {"hedge-address", required_argument, 0, 'R'},
+      {"hedge-port", required_argument, 0, 'P'},
+      {"max-allocs", required_argument, 0, 'M'},
+      {"pool", required_argument, 0, 'O'},
+      {"pool-idle", required_argument, 0, 'I'},
+      {"help", no_argument, 0, 'h'},
+      {0, 0, 0, 0}};
+
+  int c;
+  int option_index;
+  try {
+    while ((c = getopt_long(argc, argv, "a:p:u:d:n:m:s:t:h", long_options,
+                            &option_index)) != -1) {
+      switch (c) {
+      case 'a':
+        if (!ArgsParser::resolveAddress(optarg, config.address,
+                                        config.is_v6)) {
+          benchProblem("address");
+        }
+        break;
+      case 'p':
+        config.port = std::stoi(optarg);
+        if (config.port <= 0 || config.port > 65535) {
+          benchProblem("port");
+        }
+        break;
+      case 'u':
+        config.users = std::stoi(optarg);
+        if (config.users <= 0) {
+          benchProblem("users");
+        }
+        break;
+      case 'd':
+        config.duration = std::stod(optarg);
+        break;
+      case 'n':
+        config.requests = std::stoull(optarg);
+        break;
+      case 'm':
+        if (!LoadGenerator::parseMix(optarg, config.mix)) {
+          benchProblem("mix");
+        }
+        break;
+      case 's':
+        config.body_size = std::stoul(optarg);
+        break;
+      case 'C':
+        csv_file = optarg;
+        break;
+      case 'J':
+        json_file = optarg;
+        break;
+      case 'T':
+        trace_file = optarg;
+        break;
+      case 'A':
+        config.async = true;
+        break;
+      case 'X': {
+        int shards = std::stoi(optarg);
+        if (shards < 0) {
+          benchProblem("shards");
+        }
+        config.shards = shards ? shards : std::thread::hardware_concurrency();
+        config.shards = std::max<size_t>(config.shards, 1);
+        config.async = true;
+        break;
+      }
+      case 't':
+        config.timeout = std::stoull(optarg);
+        break;
+      case 'H':
+        config.hedge = std::stod(optarg);
+        if (config.hedge <= 0 || config.hedge > 100) {
+          benchProblem("hedge percentile");
+        }
+        config.async = true;
+        break;
+      case 'R':
+        if (!ArgsParser::resolveAddress(optarg, config.secondary.address,
+                                        config.secondary.is_v6)) {
+          benchProblem("hedge address");
+        }
+        hedge_address = optarg;
+        break;
+      case 'P':
+        hedge_port = std::stoi(optarg);
+        if (hedge_port <= 0 || hedge_port > 65535) {
+          benchProblem("hedge port");
+        }
+        break;
+      case 'M':
+        max_allocs = std::stod(optarg);
+        if (max_allocs < 0) {
+          benchProblem("allocation limit");
+        }
+        break;
+      case 'O':
+        pool_size = std::stoul(optarg);
+        if (!pool_size) {
+          benchProblem("pool size");
+        }
+        break;
+      case 'I':
+        pool_idle = std::stoull(optarg);
+        break;
+      case 'h':
+        printBenchHelp();
+        exit(0);
+      default:
+        benchProblem("option");
+      }
+    }
+  } catch (const std::exception &) {
+    benchProblem("option value");
+  }
+
+  /* Allocations are counted per thread, async users share one */
+  if (max_allocs >= 0 && config.async) {
+    benchProblem("allocation limit, it is not available in the async mode");
+  }
+
+  /* Hedge policy is kept by one event loop */
+  if (config.shards && config.hedge > 0) {
+    benchProblem("hedge, it is not available with shards");
+  }
+
+  /* Coroutines of the async mode connect within the event loop */
+  if (pool_size && config.async) {
+    benchProblem("pool, it is not available in the async mode");
+  }
+
+  /* Duplicates go to the server itself unless told otherwise */
+  if (hedge_address.empty()) {
+    config.secondary.address = config.address;
+    config.secondary.is_v6 = config.is_v6;
+  }
+  config.secondary.port = hedge_port ? hedge_port : config.port;
+
+  TraceWriter trace("isa-bench");
+  if (!trace_file.empty()) {
+    config.trace = &trace;
+    trace.setTrackName(0, "main");
+  }
+
+  ConnectionPool pool(pool_size, pool_idle * 1000000);
+  if (pool_size) {
+    config.pool = &pool;
+  }
+
+  LoadGenerator generator(config);
+  generator.run();
+
+  uint64_t start = Stats::now();
+  generator.printReport(std::cout);
+  if (!csv_file.empty()) {
+    exportResults(generator, csv_file, true);
+  }
+  if (!json_file.empty()) {
+    exportResults(generator, json_file, false);
+  }
+
+  if (!trace_file.empty()) {
+    trace.addSpan(0, "output", "client", start, Stats::now());
+    exportTrace(trace, trace_file);
+  }
+
+  if (max_allocs >= 0 && generator.checkAllocations(max_allocs, std::cerr)) {
+    exit(1);
+  }
+
+  return 0;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#ifndef ALLOC_COUNTER_HPP
+#define ALLOC_COUNTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief  Number and total size of heap allocations
+ * @retval None
+ */
+struct AllocCount {
+  uint64_t allocations;
+  uint64_t bytes;
+};
+
+/**
+ * @brief  Class reading allocations counted by the replaced global operator
+ * new, every thread is counted separately, the replacement is an optional
+ * hook linked only into the benchmarks and nothing is counted without it
+ * @retval None
+ */
+class AllocCounter {
+private:
+  static bool _enabled;
+
+public:
+  static void enable();
+  static bool isEnabled();
+  static void record(std::size_t size);
+  static AllocCount get();
+  static AllocCount since(const AllocCount &start);
+};
+
+#endif
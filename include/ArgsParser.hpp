@@ -2,6 +2,8 @@
 #ifndef ARGS_PARSER_HPP
 #define ARGS_PARSER_HPP
 
+#include "Commands.hpp"
+#include "CommunicationBase.hpp"
 #include <arpa/inet.h>
 #include <getopt.h>
 #include <iostream>
@@ -9,9 +11,7 @@
 #include <netdb.h>
 #include <string>
 #include <sys/socket.h>
-
-enum class CommandType { REGISTER, LOGIN, LIST, SEND, FETCH, LOGOUT };
-enum class CommandArg { USERNAME, PASSWORD, RECIPIENT, SUBJECT, BODY, ID };
+#include <vector>
 
 /**
  * @brief  Class for parsing program arguments
@@ -25,24 +25,40 @@ public:
   void printHelp();
   static bool IPv4Check(const std::string address);
   static bool IPv6Check(const std::string address);
+  static bool resolveAddress(const std::string address, std::string &resolved,
+                             bool &is_v6);
+  static std::string base64Encode(const std::string data);
+  static bool parseEndpoint(const std::string text, int default_port,
+                            Endpoint &endpoint);
   bool isNumber(const std::string str);
 
   std::string getAddress() const;
   bool isV6() const;
   int getPort() const;
+  const std::vector<Endpoint> &getEndpoints() const;
   CommandType getCommandType() const;
-  std::map<CommandArg, std::string> getCommandArgs() const;
+  const CommandArgs &getCommandArgs() const;
+  bool useOutbox() const;
+  bool isResume() const;
+  std::string getUser() const;
+  std::string getRing() const;
+  bool useIndex() const;
 
 private:
   std::string _address{"::1"};
   bool _is_v6{true};
   int _port{32323};
+  std::vector<Endpoint> _endpoints;
   static option _long_options[];
   CommandType _command_type;
-  std::map<CommandArg, std::string> _command_args;
+  CommandArgs _command_args;
+  bool _outbox{false};
+  bool _resume{false};
+  std::string _user;
+  std::string _ring;
+  bool _index{false};
 
   void printProblem(const std::string problem, std::string problem_arg);
-  std::string base64Encode(const std::string data);
 };
 
 std::string getCommandTypeEq(const CommandType _command_type);
@@ -0,0 +1,104 @@
+#pragma once
+#ifndef ASYNC_SESSION_HPP
+#define ASYNC_SESSION_HPP
+
+#include "ArgsParser.hpp"
+#include "Client.hpp"
+#include "CommunicationBase.hpp"
+#include "EventLoop.hpp"
+#include "HedgePolicy.hpp"
+#include "Stats.hpp"
+#include "Task.hpp"
+#include <array>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class AsyncStatus { OK, SERVER_ERROR, FAILED, TIMEOUT, CANCELLED };
+
+/**
+ * @brief  Outcome of the asynchronous command, message holds the raw server
+ * response, or the text of the error response
+ * @retval None
+ */
+template <typename T> struct AsyncResult {
+  AsyncStatus status{AsyncStatus::FAILED};
+  T value{};
+  std::string message;
+
+  bool ok() const { return status == AsyncStatus::OK; }
+};
+
+/**
+ * @brief  State shared by the original and the duplicate connection of one
+ * hedged request, the first successful response wins
+ * @retval None
+ */
+struct HedgeRace {
+  AsyncResult<std::string> result;
+  RequestTiming timing{};
+  std::array<int, 2> sockets{-1, -1};
+  int event{-1};
+  int running{};
+  int winner{-1};
+};
+
+/**
+ * @brief  Class issuing commands of one user over non-blocking connections
+ * driven by the event loop
+ * @retval None
+ */
+class AsyncSession {
+private:
+  EventLoop &_loop;
+  Endpoint _endpoint;
+  Endpoint _secondary;
+  HedgePolicy *_hedge{};
+  std::shared_ptr<HedgeRace> _race;
+  std::string _token;
+  uint64_t _timeout{};
+  bool _cancelled{};
+  int _fd{-1};
+  RequestTiming _timing{};
+
+  static AsyncStatus getWaitStatus(WaitResult result);
+  uint64_t getDeadline() const;
+  Task<AsyncResult<std::string>> exchange(const std::string data,
+                                          const Endpoint endpoint,
+                                          uint64_t deadline, int &fd,
+                                          RequestTiming &timing);
+  Task<> runHedgeLeg(std::shared_ptr<HedgeRace> race, const std::string data,
+                     uint64_t deadline, int leg);
+  Task<AsyncResult<std::string>> hedgedExchange(const std::string data);
+
+public:
+  AsyncSession(EventLoop &loop, std::string address, bool isV6, int port);
+  ~AsyncSession() = default;
+
+  static const char *getStatusName(AsyncStatus status);
+
+  void setTimeout(uint64_t timeout);
+  void setHedge(HedgePolicy *hedge, const Endpoint secondary);
+  void setToken(const std::string token);
+  const std::string &getToken() const;
+  const RequestTiming &getTiming() const;
+  void cancel();
+
+  Task<AsyncResult<std::string>>
+  request(CommandType command, CommandArgs command_args);
+
+  Task<AsyncResult<std::string>> registerUser(const std::string username,
+                                              const std::string password);
+  Task<AsyncResult<std::string>> login(const std::string username,
+                                       const std::string password);
+  Task<AsyncResult<std::vector<ListEntry>>> list();
+  Task<AsyncResult<std::string>> send(const std::string recipient,
+                                      const std::string subject,
+                                      const std::string body);
+  Task<AsyncResult<FetchedMessage>> fetch(const std::string id);
+  Task<AsyncResult<std::string>> logout();
+};
+
+#endif
@@ -0,0 +1,66 @@
+#pragma once
+#ifndef CAPTURE_ANALYZER_HPP
+#define CAPTURE_ANALYZER_HPP
+
+#include "Histogram.hpp"
+#include "TcpReassembler.hpp"
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief  Statistics of one command found in the capture
+ * @retval None
+ */
+struct CommandStats {
+  uint64_t requests{};
+  uint64_t errors{};
+  uint64_t unanswered{};
+  Histogram request_size;
+  Histogram response_size;
+  Histogram latency;
+  std::map<std::string, uint64_t> error_messages;
+
+  void merge(const CommandStats &other);
+};
+
+/**
+ * @brief  Class decoding protocol messages of the capture, connections are
+ * analyzed in parallel by worker threads
+ * @retval None
+ */
+class CaptureAnalyzer {
+private:
+  uint16_t _port{};
+  int _threads{};
+  std::map<std::string, CommandStats> _commands;
+  uint64_t _flows{};
+  uint64_t _packets{};
+  uint64_t _segments{};
+
+  std::mutex _mutex;
+  std::condition_variable _ready;
+  std::condition_variable _space;
+  std::deque<std::vector<TcpFlow>> _batches;
+  bool _done{};
+
+  void enqueue(std::vector<TcpFlow> &batch);
+  void worker(std::map<std::string, CommandStats> &commands);
+  static std::string getCommand(const std::string &request);
+  static void analyzeFlow(const TcpFlow &flow,
+                          std::map<std::string, CommandStats> &commands);
+
+public:
+  CaptureAnalyzer(uint16_t port, int threads);
+  ~CaptureAnalyzer() = default;
+
+  bool analyze(const std::string filename);
+  void printReport(std::ostream &os) const;
+  void writeJson(std::ostream &os) const;
+};
+
+#endif
@@ -3,46 +3,142 @@
 #define CLIENT_HPP
 
 #include "ArgsParser.hpp"
+#include "Outbox.hpp"
+#include "RingBuffer.hpp"
+#include "TokenStore.hpp"
+#include <ostream>
 #include <string>
+#include <string_view>
 #include <vector>
 
+/**
+ * @brief  One item of the server message of the list type
+ * @retval None
+ */
+struct ListEntry {
+  std::string id;
+  std::string sender;
+  std::string subject;
+};
+
+/**
+ * @brief  Content of the server message of the fetch type
+ * @retval None
+ */
+struct FetchedMessage {
+  std::string sender;
+  std::string subject;
+  std::string body;
+};
+
 /**
  * @brief  Class encapsulating client functionality
  * @retval None
  */
 class Client {
 private:
-  static std::string findReplace(std::string data, std::string to_replace,
-                                 std::string replace_by);
-  static std::string escapeData(std::string data);
-  static std::string unEscapeData(std::string data);
-  static std::string
-  getFormattedData(CommandType command,
-                   std::map<CommandArg, std::string> command_args);
-
-  static void saveTokenToFile(std::string message);
-  static std::string getToken();
-
-  static bool isMessageOk(const std::string message);
-  static std::string cutOffHeader(std::string message);
-  static std::string cutOutServerMessageContent(std::string message);
-  static std::string cutOffFirstLeftBracket(std::string message);
-  static std::string cutOffLastRightBracket(std::string message);
-  static std::string cutOffPrimaryWrapping(std::string message);
-  static std::string cutOffBracketWrapping(std::string message);
-  static std::string cutOffQuotesWrapping(std::string message);
-  static std::vector<std::string> splitByChar(std::string message, char cut_by);
-  static std::vector<std::string> splitByString(std::string message,
-                                                std::string cut_by);
-  static void processLogin(std::string message);
-  static void printList(std::string message);
-  static void printFetch(std::string message);
+  static std::string getToken(TokenStore &store, const std::string &server,
+                              const ArgsParser &args);
+  static void updateSession(TokenStore &store, const std::string &server,
+                            const ArgsParser &args, std::string_view message);
+
+  static bool skipString(std::string_view message, size_t &position);
+  static bool readString(std::string_view message, size_t &position,
+                         std::string &value, bool newlines);
+  static void printList(std::string_view message, std::ostream &os);
   static void processServerMessage(const CommandType command,
-                                   std::string message);
+                                   const std::string &message,
+                                   std::ostream &os, Outbox *outbox = nullptr,
+                                   OutboxRef entry = {});
+  static void publishRecord(RingWriter &ring, RingRecordType type, bool ok,
+                            const std::string_view (&fields)[RING_FIELDS]);
+  static void publishServerMessage(RingWriter &ring, const ArgsParser &args,
+                                   const std::string &message,
+                                   std::ostream &os);
+  static void resumeOutbox(const ArgsParser &args);
+  static void printSearch(const std::string &query, std::ostream &os);
 
 public:
-  Client(ArgsParser args);
+  Client(const ArgsParser &args);
   ~Client() = default;
+
+  static bool needsToken(const CommandType command);
+  static void openTokenStore(TokenStore &store);
+  static bool findUser(TokenStore &store, const std::string &server,
+                       const ArgsParser &args, std::string &user);
+  static std::string getFormattedData(CommandType command,
+                                      const CommandArgs &command_args,
+                                      const std::string &token);
+  static void getFormattedData(CommandType command,
+                               const CommandArgs &command_args,
+                               const std::string &token, std::string &data);
+
+  static bool isMessageOk(std::string_view message);
+  static bool isMessageErr(std::string_view message);
+  static void parseMessageContent(std::string_view message,
+                                  std::string &content);
+  static std::string parseMessageContent(std::string_view message);
+  static void parseLoginToken(std::string_view message, std::string &token);
+  static std::string parseLoginToken(std::string_view message);
+  static void parseList(std::string_view message,
+                        std::vector<ListEntry> &entries);
+  static std::vector<ListEntry> parseList(std::string_view message);
+  static void parseFetch(std::string_view message, FetchedMessage &fetched);
+  static FetchedMessage parseFetch(std::string_view message);
+  static void printFetch(std::string_view message, std::ostream &os);
+  static void indexFetch(const std::string &server, const std::string &id,
+                         std::string_view message);
+};
+
+/**
+ * @brief  Type the ok response of the given shape is decoded into, the token
+ * for login and the un-escaped text for the other plain responses
+ * @retval None
+ */
+template <ResponseShape S> struct ResponseValue {
+  using type = std::string;
 };
+template <> struct ResponseValue<ResponseShape::LIST> {
+  using type = std::vector<ListEntry>;
+};
+template <> struct ResponseValue<ResponseShape::FETCH> {
+  using type = FetchedMessage;
+};
+
+template <CommandType C>
+using ResponseOf = typename ResponseValue<describeCommand(C).response>::type;
+
+/**
+ * @brief  Decodes the ok response of the command into the value, memory of
+ * the value is reused
+ * @param  message: message data from the server
+ * @param  &value: decoded response
+ * @retval None
+ */
+template <CommandType C>
+void decodeResponse(std::string_view message, ResponseOf<C> &value) {
+  constexpr ResponseShape shape = describeCommand(C).response;
+  if constexpr (shape == ResponseShape::LOGIN) {
+    Client::parseLoginToken(message, value);
+  } else if constexpr (shape == ResponseShape::LIST) {
+    Client::parseList(message, value);
+  } else if constexpr (shape == ResponseShape::FETCH) {
+    Client::parseFetch(message, value);
+  } else {
+    Client::parseMessageContent(message, value);
+  }
+}
+
+/**
+ * @brief  Decodes the ok response of the command
+ * @param  message: message data from the server
+ * @retval decoded response
+ */
+template <CommandType C>
+ResponseOf<C> decodeResponse(std::string_view message) {
+  ResponseOf<C> value;
+  decodeResponse<C>(message, value);
+  return value;
+}
 
-#endif
\ No newline at end of file
+#endif
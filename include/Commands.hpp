@@ -0,0 +1,316 @@
+#pragma once
+#ifndef COMMANDS_HPP
+#define COMMANDS_HPP
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+enum class CommandType { REGISTER, LOGIN, LIST, SEND, FETCH, LOGOUT, SEARCH };
+enum class CommandArg {
+  USERNAME,
+  PASSWORD,
+  RECIPIENT,
+  SUBJECT,
+  BODY,
+  ID,
+  QUERY
+};
+
+/* Form of the ok response, LOCAL commands are never sent to the server */
+enum class ResponseShape { TEXT, LOGIN, LIST, FETCH, LOCAL };
+enum class SessionEffect { NONE, START, END };
+
+const size_t MAX_ARITY = 3;
+
+/**
+ * @brief  Description of one command argument, quoted arguments are sent in
+ * quotes with special characters escaped, the others as they are
+ * @retval None
+ */
+struct ArgDescriptor {
+  CommandArg arg;
+  const char *name;
+  bool quoted;
+  bool base64;
+};
+
+/**
+ * @brief  Description of one command, arguments are sent in the order of args
+ * @retval None
+ */
+struct CommandDescriptor {
+  CommandType type;
+  const char *name;
+  size_t arity;
+  std::array<CommandArg, MAX_ARITY> args;
+  bool token;
+  bool read_only;
+  SessionEffect session;
+  ResponseShape response;
+};
+
+/* Indexed by CommandArg */
+inline constexpr std::array<ArgDescriptor, 7> COMMAND_ARGS{{
+    {CommandArg::USERNAME, "USERNAME", true, false},
+    {CommandArg::PASSWORD, "PASSWORD", true, true},
+    {CommandArg::RECIPIENT, "RECIPIENT", true, false},
+    {CommandArg::SUBJECT, "SUBJECT", true, false},
+    {CommandArg::BODY, "BODY", true, false},
+    {CommandArg::ID, "ID", false, false},
+    {CommandArg::QUERY, "QUERY", true, false},
+}};
+
+/* Indexed by CommandType, adding a command is one entry */
+inline constexpr std::array<CommandDescriptor, 7> COMMANDS{{
+    {CommandType::REGISTER,
+     "register",
+     2,
+     {CommandArg::USERNAME, CommandArg::PASSWORD},
+     false,
+     false,
+     SessionEffect::NONE,
+     ResponseShape::TEXT},
+    {CommandType::LOGIN,
+     "login",
+     2,
+     {CommandArg::USERNAME, CommandArg::PASSWORD},
+     false,
+     false,
+     SessionEffect::START,
+     ResponseShape::LOGIN},
+    {CommandType::LIST,
+     "list",
+     0,
+     {},
+     true,
+     true,
+     SessionEffect::NONE,
+     ResponseShape::LIST},
+    {CommandType::SEND,
+     "send",
+     3,
+     {CommandArg::RECIPIENT, CommandArg::SUBJECT, CommandArg::BODY},
+     true,
+     false,
+     SessionEffect::NONE,
+     ResponseShape::TEXT},
+    {CommandType::FETCH,
+     "fetch",
+     1,
+     {CommandArg::ID},
+     true,
+     true,
+     SessionEffect::NONE,
+     ResponseShape::FETCH},
+    {CommandType::LOGOUT,
+     "logout",
+     0,
+     {},
+     true,
+     false,
+     SessionEffect::END,
+     ResponseShape::TEXT},
+    {CommandType::SEARCH,
+     "search",
+     1,
+     {CommandArg::QUERY},
+     false,
+     true,
+     SessionEffect::NONE,
+     ResponseShape::LOCAL},
+}};
+
+/**
+ * @brief  Checks that the tables are indexed by their enums
+ * @retval True: tables are consistent | False: an entry is out of place
+ */
+constexpr bool isCommandTableValid() {
+  for (size_t i = 0; i < COMMAND_ARGS.size(); i++) {
+    if (static_cast<size_t>(COMMAND_ARGS[i].arg) != i) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < COMMANDS.size(); i++) {
+    if (static_cast<size_t>(COMMANDS[i].type) != i ||
+        COMMANDS[i].arity > MAX_ARITY) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static_assert(isCommandTableValid(), "Command table out of enum order");
+
+/**
+ * @brief  Returns description of the command
+ * @param  command: command type
+ * @retval command descriptor
+ */
+constexpr const CommandDescriptor &describeCommand(CommandType command) {
+  return COMMANDS[static_cast<size_t>(command)];
+}
+
+/**
+ * @brief  Returns description of the command argument
+ * @param  arg: command argument type
+ * @retval argument descriptor
+ */
+constexpr const ArgDescriptor &describeArg(CommandArg arg) {
+  return COMMAND_ARGS[static_cast<size_t>(arg)];
+}
+
+/**
+ * @brief  Arguments of any command, indexed by the argument type
+ * @retval None
+ */
+struct CommandArgs {
+  std::array<std::string, COMMAND_ARGS.size()> values;
+
+  std::string &operator[](CommandArg arg) {
+    return values[static_cast<size_t>(arg)];
+  }
+  const std::string &operator[](CommandArg arg) const {
+    return values[static_cast<size_t>(arg)];
+  }
+};
+
+/**
+ * @brief  Arguments of one command in the order they are sent
+ * @retval None
+ */
+template <CommandType C> struct CommandRequest {
+  static constexpr CommandDescriptor descriptor = describeCommand(C);
+  std::array<std::string_view, descriptor.arity> args;
+};
+
+/**
+ * @brief  Picks arguments of the command, the request refers to their data
+ * @param  &command_args: arguments of any command
+ * @retval arguments of the command
+ */
+template <CommandType C>
+CommandRequest<C> getRequest(const CommandArgs &command_args) {
+  CommandRequest<C> request;
+  for (size_t i = 0; i < request.args.size(); i++) {
+    request.args[i] = command_args[CommandRequest<C>::descriptor.args[i]];
+  }
+  return request;
+}
+
+/**
+ * @brief  Appends the text with backslashes and quotes escaped, a written out
+ * \n stays a newline escape
+ * @param  &data: encoded data
+ * @param  text: text to be escaped
+ * @retval None
+ */
+inline void appendEscaped(std::string &data, std::string_view text) {
+  for (size_t i = 0; i < text.size(); i++) {
+    if (text[i] == '\\' && i + 1 < text.size() && text[i + 1] == 'n') {
+      data += "\\n";
+      i++;
+    } else if (text[i] == '\\' || text[i] == '"') {
+      data += '\\';
+      data += text[i];
+    } else {
+      data += text[i];
+    }
+  }
+}
+
+/**
+ * @brief  Appends one argument in the form given by its descriptor
+ * @param  &data: encoded data
+ * @param  value: argument
+ * @retval None
+ */
+template <CommandArg A>
+void appendArg(std::string &data, std::string_view value) {
+  data += ' ';
+  if constexpr (describeArg(A).quoted) {
+    data += '"';
+    appendEscaped(data, value);
+    data += '"';
+  } else {
+    data += value;
+  }
+}
+
+/**
+ * @brief  Appends arguments of the command one after another
+ * @param  &data: encoded data
+ * @param  &request: arguments of the command
+ * @retval None
+ */
+template <CommandType C, size_t... I>
+void appendArgs(std::string &data, const CommandRequest<C> &request,
+                std::index_sequence<I...>) {
+  (appendArg<CommandRequest<C>::descriptor.args[I]>(data, request.args[I]),
+   ...);
+}
+
+/**
+ * @brief  Encodes the command for the server into the buffer, it grows at
+ * most once and its memory is reused by the next command
+ * @param  &request: arguments of the command
+ * @param  token: login token used by the commands that require it
+ * @param  &data: encoded command
+ * @retval None
+ */
+template <CommandType C>
+void encodeCommand(const CommandRequest<C> &request, std::string_view token,
+                   std::string &data) {
+  constexpr CommandDescriptor descriptor = CommandRequest<C>::descriptor;
+  constexpr std::string_view name = descriptor.name;
+
+  /* Escaping at most doubles an argument */
+  size_t size = name.size() + 2;
+  if constexpr (descriptor.token) {
+    size += token.size() + 1;
+  }
+  for (auto &arg : request.args) {
+    size += arg.size() * 2 + 3;
+  }
+
+  data.clear();
+  data.reserve(size);
+  data += '(';
+  data += name;
+  if constexpr (descriptor.token) {
+    data += ' ';
+    data += token;
+  }
+  appendArgs<C>(data, request, std::make_index_sequence<descriptor.arity>{});
+  data += ')';
+}
+
+/**
+ * @brief  Calls the visitor with the command type as a compile-time constant
+ * @param  command: command type
+ * @param  &&visitor: callable taking std::integral_constant<CommandType, C>
+ * @retval None
+ */
+template <typename F, size_t... I>
+void visitCommand(CommandType command, F &&visitor, std::index_sequence<I...>) {
+  ((command == COMMANDS[I].type
+        ? (visitor(std::integral_constant<CommandType, COMMANDS[I].type>{}),
+           true)
+        : false) ||
+   ...);
+}
+
+/**
+ * @brief  Calls the visitor with the command type as a compile-time constant
+ * @param  command: command type
+ * @param  &&visitor: callable taking std::integral_constant<CommandType, C>
+ * @retval None
+ */
+template <typename F> void visitCommand(CommandType command, F &&visitor) {
+  visitCommand(command, visitor, std::make_index_sequence<COMMANDS.size()>{});
+}
+
+#endif
@@ -2,10 +2,25 @@
 #ifndef COMMUNICATION_BASE_HPP
 #define COMMUNICATION_BASE_HPP
 
+#include "Stats.hpp"
 #include <arpa/inet.h>
 #include <string>
 #include <sys/socket.h>
 
+enum class IoStatus { DONE, AGAIN, FAILED };
+
+/**
+ * @brief  Resolved address and port of the server
+ * @retval None
+ */
+struct Endpoint {
+  std::string address{"::1"};
+  bool is_v6{true};
+  int port{32323};
+};
+
+std::string getEndpointName(const Endpoint &endpoint);
+
 /**
  * @brief  Class providing a connection to the server
  * @retval None
@@ -16,21 +31,35 @@ private:
   bool _is_v6{};
   int _port{};
 
-  int _sockfd{};
+  int _sockfd{-1};
   struct sockaddr_in _server_address;
   struct sockaddr_in6 _server6_address;
+  RequestTiming _timing{};
 
-  void createSocket();
   void sinAssign();
-  void connectToServer();
 
 public:
   CommunicationBase(std::string address, bool isV6, int port);
-  ~CommunicationBase() = default;
+  CommunicationBase(const CommunicationBase &) = delete;
+  CommunicationBase &operator=(const CommunicationBase &) = delete;
+  CommunicationBase(CommunicationBase &&other) noexcept;
+  ~CommunicationBase();
 
+  bool tryConnection();
   void setConnection();
+  bool tryCommunicate(const std::string &data, std::string &message);
   std::string communicate(std::string data);
+  void communicate(const std::string &data, std::string &message);
   void endConnection();
+  const RequestTiming &getTiming() const;
+
+  bool startConnection();
+  bool finishConnection();
+  IoStatus sendSome(const std::string &data, size_t &sent);
+  IoStatus receiveSome(std::string &message);
+  int getSocket() const;
+  void adoptSocket(int fd, uint64_t connect_start);
+  int releaseSocket();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,101 @@
+#pragma once
+#ifndef CONNECTION_POOL_HPP
+#define CONNECTION_POOL_HPP
+
+#include "CommunicationBase.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <shared_mutex>
+#include <vector>
+
+/**
+ * @brief  Socket waiting in the pool, connecting may still be in progress
+ * @retval None
+ */
+struct PooledSocket {
+  int fd;
+  uint64_t since;
+};
+
+/**
+ * @brief  Orders endpoints so that the pool is looked up without building
+ * their names
+ * @retval None
+ */
+struct EndpointLess {
+  bool operator()(const Endpoint &a, const Endpoint &b) const;
+};
+
+/**
+ * @brief  Class handing connected sockets to worker threads, the server
+ * answers one request per connection, so a used socket is closed and a
+ * spare one is connected in its place while the worker handles the response
+ * @retval None
+ */
+class ConnectionPool {
+private:
+  /* Free lists of one endpoint, a thread starts at its own one */
+  static const size_t SHARDS = 8;
+  /* Time a spare socket is given to finish connecting */
+  static const int CONNECT_WAIT = 1000;
+
+  struct Shard {
+    std::mutex mutex;
+    std::vector<PooledSocket> idle;
+  };
+
+  struct EndpointPool {
+    sockaddr_storage address{};
+    socklen_t address_length{};
+    /* Sockets of the endpoint, idle and handed out, within the cap */
+    std::atomic<size_t> open{0};
+    std::atomic<size_t> idle{0};
+    std::atomic<size_t> waiting{0};
+    Shard shards[SHARDS];
+    std::mutex wait_mutex;
+    std::condition_variable released;
+  };
+
+  size_t _max_per_endpoint{};
+  uint64_t _idle_timeout{};
+  std::shared_mutex _mutex;
+  std::map<Endpoint, std::unique_ptr<EndpointPool>, EndpointLess> _pools;
+
+  std::atomic<uint64_t> _hits{0};
+  std::atomic<uint64_t> _misses{0};
+  std::atomic<uint64_t> _discarded{0};
+  std::atomic<uint64_t> _reaped{0};
+  std::atomic<uint64_t> _waits{0};
+  /* Time the next release closes sockets past the idle timeout */
+  std::atomic<uint64_t> _next_reap{0};
+
+  static size_t getHomeShard();
+  static int startSocket(const EndpointPool &pool);
+  static bool checkSocket(int fd);
+  EndpointPool &getPool(const Endpoint &endpoint);
+  bool popIdle(EndpointPool &pool, PooledSocket &socket);
+  void pushIdle(EndpointPool &pool, int fd);
+  bool reserve(EndpointPool &pool);
+  void free(EndpointPool &pool);
+  void notify(EndpointPool &pool);
+
+public:
+  ConnectionPool(size_t max_per_endpoint, uint64_t idle_timeout);
+  ConnectionPool(const ConnectionPool &) = delete;
+  ConnectionPool &operator=(const ConnectionPool &) = delete;
+  ~ConnectionPool();
+
+  bool acquire(const Endpoint &endpoint, CommunicationBase &connection);
+  void release(const Endpoint &endpoint, CommunicationBase &connection);
+  size_t reap();
+
+  void printReport(std::ostream &os) const;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#pragma once
+#ifndef EVENT_LOOP_HPP
+#define EVENT_LOOP_HPP
+
+#include "Task.hpp"
+#include <coroutine>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <unordered_map>
+
+enum class WaitResult { READY, TIMEOUT, CANCELLED, FAILED };
+
+class EventLoop;
+
+/**
+ * @brief  Coroutine suspended until its descriptor is ready or its deadline
+ * passes
+ * @retval None
+ */
+struct EventWaiter {
+  std::coroutine_handle<> handle;
+  int fd{-1};
+  WaitResult result{WaitResult::FAILED};
+  bool has_timer{};
+  std::multimap<uint64_t, EventWaiter *>::iterator timer;
+};
+
+/**
+ * @brief  Awaitable suspending the coroutine until the descriptor is ready
+ * @retval None
+ */
+class EventWait {
+private:
+  EventLoop &_loop;
+  EventWaiter _waiter;
+  uint32_t _events{};
+  uint64_t _deadline{};
+
+public:
+  EventWait(EventLoop &loop, int fd, uint32_t events, uint64_t deadline);
+
+  bool await_ready() const noexcept { return false; }
+  bool await_suspend(std::coroutine_handle<> handle);
+  WaitResult await_resume() const noexcept { return _waiter.result; }
+};
+
+/**
+ * @brief  Single-threaded epoll loop resuming coroutines waiting for
+ * descriptors and timers
+ * @retval None
+ */
+class EventLoop {
+private:
+  int _epoll_fd{-1};
+  std::deque<std::coroutine_handle<>> _ready;
+  std::unordered_map<int, EventWaiter *> _waiters;
+  std::multimap<uint64_t, EventWaiter *> _timers;
+  std::function<bool()> _idle;
+  int _wake_fd{-1};
+
+  void complete(EventWaiter *waiter, WaitResult result);
+  void expireTimers();
+
+  friend class EventWait;
+  bool add(EventWaiter *waiter, uint32_t events, uint64_t deadline);
+
+public:
+  EventLoop();
+  EventLoop(const EventLoop &) = delete;
+  EventLoop &operator=(const EventLoop &) = delete;
+  ~EventLoop();
+
+  void spawn(Task<> task);
+  EventWait wait(int fd, uint32_t events, uint64_t deadline = 0);
+  EventWait sleep(uint64_t duration);
+  bool cancel(int fd);
+  void setIdle(std::function<bool()> idle, int wake_fd);
+  void run();
+};
+
+#endif
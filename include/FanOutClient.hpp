@@ -0,0 +1,42 @@
+#pragma once
+#ifndef FAN_OUT_CLIENT_HPP
+#define FAN_OUT_CLIENT_HPP
+
+#include "ArgsParser.hpp"
+#include "AsyncSession.hpp"
+#include "CommunicationBase.hpp"
+#include "EventLoop.hpp"
+#include "Task.hpp"
+#include "TokenStore.hpp"
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief  Class communicating with several servers holding parts of the
+ * mailbox, one request per server runs concurrently within the event loop
+ * @retval None
+ */
+class FanOutClient {
+private:
+  std::vector<Endpoint> _endpoints;
+  EventLoop _loop;
+  std::vector<AsyncSession> _sessions;
+  std::vector<AsyncResult<std::string>> _results;
+
+  Task<> requestEndpoint(size_t index, CommandType command,
+                         CommandArgs command_args);
+  void requestAll(const std::vector<size_t> &indexes, CommandType command,
+                  CommandArgs command_args);
+  void printResult(size_t index, std::ostream &os);
+  void printMergedList(std::ostream &os);
+
+public:
+  FanOutClient(ArgsParser args);
+  ~FanOutClient() = default;
+
+  static bool parseTag(const std::string tagged, size_t &endpoint,
+                       std::string &id);
+};
+
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+#ifndef HEDGE_POLICY_HPP
+#define HEDGE_POLICY_HPP
+
+#include "Histogram.hpp"
+#include <cstdint>
+#include <ostream>
+
+/**
+ * @brief  Class deciding when a read-only request is duplicated, the delay is
+ * a percentile of latencies observed so far
+ * @retval None
+ */
+class HedgePolicy {
+private:
+  static const uint64_t MIN_SAMPLES = 100;
+
+  double _percentile{95.0};
+  uint64_t _initial_delay{};
+  uint64_t _min_delay{};
+  Histogram _latencies;
+  uint64_t _requests{};
+  uint64_t _hedged{};
+  uint64_t _secondary_wins{};
+
+public:
+  HedgePolicy(double percentile, uint64_t initial_delay, uint64_t min_delay);
+  ~HedgePolicy() = default;
+
+  uint64_t getDelay() const;
+  void recordLatency(uint64_t latency);
+  void recordRequest(bool hedged, bool secondary_won);
+
+  uint64_t getRequests() const;
+  uint64_t getHedged() const;
+  uint64_t getSecondaryWins() const;
+  void printReport(std::ostream &os) const;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+#include <array>
+#include <cstdint>
+
+/**
+ * @brief  Log-bucketed histogram of latencies in nanoseconds, every power of
+ * two is divided into linear sub-buckets (relative error below 1/16)
+ * @retval None
+ */
+class Histogram {
+private:
+  static const int SUB_BUCKET_BITS = 4;
+  static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static const int BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+  std::array<uint64_t, BUCKETS> _counts{};
+  uint64_t _total{};
+  uint64_t _sum{};
+  uint64_t _min{UINT64_MAX};
+  uint64_t _max{};
+
+  static int bucketIndex(uint64_t value);
+  static uint64_t bucketUpperBound(int index);
+
+public:
+  Histogram() = default;
+  ~Histogram() = default;
+
+  void record(uint64_t value);
+  void merge(const Histogram &other);
+  void reset();
+
+  uint64_t count() const;
+  uint64_t min() const;
+  uint64_t max() const;
+  double mean() const;
+  uint64_t percentile(double percentile) const;
+};
+
+#endif
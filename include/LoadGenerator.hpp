@@ -0,0 +1,163 @@
+#pragma once
+#ifndef LOAD_GENERATOR_HPP
+#define LOAD_GENERATOR_HPP
+
+#include "AllocCounter.hpp"
+#include "ArgsParser.hpp"
+#include "AsyncSession.hpp"
+#include "Client.hpp"
+#include "CommunicationBase.hpp"
+#include "ConnectionPool.hpp"
+#include "EventLoop.hpp"
+#include "HedgePolicy.hpp"
+#include "Histogram.hpp"
+#include "ShardGroup.hpp"
+#include "Stats.hpp"
+#include "Task.hpp"
+#include "TraceWriter.hpp"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+/**
+ * @brief  Settings of the load generator run
+ * @retval None
+ */
+struct LoadConfig {
+  std::string address{"::1"};
+  bool is_v6{true};
+  int port{32323};
+  int users{1};
+  double duration{10.0};
+  uint64_t requests{};
+  std::map<CommandType, int> mix;
+  size_t body_size{64};
+  std::string prefix{"bench"};
+  TraceWriter *trace{};
+  ConnectionPool *pool{};
+  bool async{};
+  /* Event loops of the async mode, each in its own thread */
+  size_t shards{};
+  uint64_t timeout{};
+  double hedge{};
+  Endpoint secondary;
+};
+
+/**
+ * @brief  Latencies, error count and allocations of one operation, the first
+ * request of the operation by every user is a warm-up and allocations of it
+ * are not counted
+ * @retval None
+ */
+struct OperationStats {
+  Histogram latency;
+  uint64_t errors{};
+  uint64_t alloc_requests{};
+  uint64_t allocations{};
+  uint64_t alloc_bytes{};
+};
+
+/**
+ * @brief  Class simulating one user issuing commands to the server
+ * @retval None
+ */
+class VirtualUser {
+private:
+  /* Responses parsed by whichever shard is idle */
+  static const size_t OFFLOAD_SIZE = 64 << 10;
+
+  const LoadConfig &_config;
+  int _index{};
+  std::string _username;
+  std::string _password;
+  std::string _token;
+  std::vector<std::string> _message_ids;
+  std::mt19937 _random;
+  std::map<CommandType, OperationStats> _stats;
+  RequestTiming _timing{};
+
+  /* Buffers reused by every request of the user */
+  Endpoint _endpoint;
+  CommunicationBase _connection;
+  CommandArgs _command_args;
+  std::string _request;
+  std::string _response;
+  std::string _text;
+  std::vector<ListEntry> _entries;
+  FetchedMessage _fetched;
+
+  bool request(CommandType command);
+  void setCommandArgs(CommandType command);
+  void processResponse(CommandType command, const std::string &message);
+
+public:
+  VirtualUser(const LoadConfig &config, int index);
+  VirtualUser(VirtualUser &&) = default;
+  ~VirtualUser() = default;
+
+  void setUp();
+  Task<> setUpAsync(AsyncSession &session);
+  void runOperation(CommandType command);
+  Task<> runOperationAsync(AsyncSession &session, CommandType command,
+                           ShardGroup *shards = nullptr, size_t shard = 0);
+  const std::string &getUsername() const;
+  const std::map<CommandType, OperationStats> &getStats() const;
+};
+
+/**
+ * @brief  Class running virtual users against the server and collecting
+ * per-operation latencies
+ * @retval None
+ */
+class LoadGenerator {
+private:
+  /* Hedge delay before latencies are known and its lower limit */
+  static const uint64_t HEDGE_INITIAL_DELAY = 10000000;
+  static const uint64_t HEDGE_MIN_DELAY = 1000000;
+
+  LoadConfig _config;
+  std::vector<VirtualUser> _users;
+  std::map<CommandType, OperationStats> _results;
+  std::atomic<bool> _stop{false};
+  std::atomic<uint64_t> _issued{0};
+  double _elapsed{};
+  std::vector<CommandType> _commands;
+  std::vector<int> _weights;
+  std::unique_ptr<HedgePolicy> _hedge;
+  std::unique_ptr<ShardGroup> _shards;
+  std::vector<size_t> _user_shards;
+
+  void runUser(VirtualUser &user, unsigned seed);
+  Task<> runUserAsync(VirtualUser &user, AsyncSession &session,
+                      unsigned seed, size_t shard = 0);
+  Task<> stopAfter(EventLoop &loop);
+  void setUpUsers();
+  void setUpUsersAsync();
+  void runMeasured();
+  void runMeasuredAsync();
+  void runShards(bool measured);
+
+public:
+  LoadGenerator(LoadConfig config);
+  ~LoadGenerator() = default;
+
+  static bool parseMix(const std::string mix,
+                       std::map<CommandType, int> &weights);
+
+  void run();
+  double getElapsed() const;
+  const std::map<CommandType, OperationStats> &getResults() const;
+
+  static double getAllocationsPerRequest(const OperationStats &stats);
+  size_t checkAllocations(double limit, std::ostream &os) const;
+
+  void printReport(std::ostream &os) const;
+  void writeCsv(std::ostream &os) const;
+  void writeJson(std::ostream &os) const;
+};
+
+#endif
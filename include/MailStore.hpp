@@ -0,0 +1,57 @@
+#pragma once
+#ifndef MAIL_STORE_HPP
+#define MAIL_STORE_HPP
+
+#include "SExpression.hpp"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief  One message stored in the mailbox
+ * @retval None
+ */
+struct Mail {
+  std::string sender;
+  std::string subject;
+  std::string body;
+};
+
+/**
+ * @brief  Class holding users, login tokens and mailboxes in memory and
+ * answering protocol requests
+ * @retval None
+ */
+class MailStore {
+private:
+  std::unordered_map<std::string, std::string> _passwords;
+  std::unordered_map<std::string, std::string> _tokens;
+  std::unordered_map<std::string, std::vector<Mail>> _mailboxes;
+  unsigned long _token_counter{};
+
+  static std::string ok(const std::string message);
+  static std::string err(const std::string message);
+  static bool hasStringArgs(const SExpression &request, size_t count);
+
+  std::string createToken(const std::string &username);
+  const std::string *getUser(const SExpression &token) const;
+
+  std::string handleRegister(const SExpression &request);
+  std::string handleLogin(const SExpression &request);
+  std::string handleList(const SExpression &request) const;
+  std::string handleSend(const SExpression &request);
+  std::string handleFetch(const SExpression &request) const;
+  std::string handleLogout(const SExpression &request);
+
+public:
+  MailStore() = default;
+  ~MailStore() = default;
+
+  std::string handle(const std::string &data);
+  std::string handle(const SExpression &request);
+
+  bool save(const std::string filename) const;
+  bool load(const std::string filename);
+};
+
+#endif
@@ -0,0 +1,123 @@
+#pragma once
+#ifndef MESSAGE_INDEX_HPP
+#define MESSAGE_INDEX_HPP
+
+#include "Client.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+const char INDEX_FILENAME[] = "message-index";
+
+/**
+ * @brief  Fetched message known to the index, identified by its server and id
+ * @retval None
+ */
+struct IndexedMessage {
+  std::string server;
+  std::string id;
+  std::string sender;
+  std::string subject;
+  uint64_t hash;
+};
+
+/**
+ * @brief  Occurrences of one term within one message
+ * @retval None
+ */
+struct Posting {
+  uint32_t document;
+  std::vector<uint32_t> positions;
+};
+
+/**
+ * @brief  Encoded posting list of one term, new messages are appended without
+ * decoding the older ones
+ * @retval None
+ */
+struct PostingList {
+  uint32_t count;
+  uint32_t last;
+  std::string data;
+};
+
+/**
+ * @brief  Part of the index file with its own tables, messages are numbered
+ * within the segment and follow the messages of the previous segments
+ * @retval None
+ */
+struct IndexSegment {
+  size_t offset;
+  size_t terms_offset;
+  size_t blob_offset;
+  size_t end;
+  uint32_t base;
+  uint32_t document_count;
+  uint32_t term_count;
+};
+
+/**
+ * @brief  Class keeping the inverted index of fetched messages, the file is
+ * memory-mapped and searched in place, it is a chain of segments and an
+ * update appends one segment under the file lock
+ * @retval None
+ */
+class MessageIndex {
+private:
+  std::string _filename;
+  int _fd{-1};
+  const uint8_t *_data{};
+  size_t _size{};
+  std::vector<IndexSegment> _segments;
+  uint32_t _document_count{};
+  /* End of the last segment and bytes of the linked segments */
+  size_t _end{};
+  size_t _live{};
+
+  bool map();
+  void unmap();
+  int lockFile() const;
+  uint32_t read32(size_t offset) const;
+  uint64_t read64(size_t offset) const;
+  bool readBlob(const IndexSegment &segment, uint32_t offset,
+                uint32_t length, std::string &text) const;
+  bool readDocument(const IndexSegment &segment, uint32_t document,
+                    IndexedMessage &message) const;
+  bool readTerm(const IndexSegment &segment, uint32_t term,
+                std::string &text) const;
+  bool readPostings(const IndexSegment &segment, uint32_t term,
+                    std::vector<Posting> &postings) const;
+  bool readSegment(const IndexSegment &segment, uint32_t shift,
+                   std::vector<IndexedMessage> &messages,
+                   std::map<std::string, PostingList> &terms) const;
+  bool findTerm(const IndexSegment &segment, const std::string &term,
+                std::vector<Posting> &postings) const;
+  std::vector<uint32_t>
+  matchPhrase(const IndexSegment &segment,
+              const std::vector<std::string> &terms) const;
+  static bool buildSegment(const std::vector<IndexedMessage> &messages,
+                           const std::map<std::string, PostingList> &terms,
+                           std::string &segment);
+  bool append(int fd, const std::string &server, const std::string &id,
+              const FetchedMessage &message);
+  bool compact() const;
+
+public:
+  MessageIndex(const std::string filename);
+  MessageIndex(const MessageIndex &) = delete;
+  MessageIndex &operator=(const MessageIndex &) = delete;
+  ~MessageIndex();
+
+  static std::vector<std::string> tokenize(const std::string &text);
+  static std::vector<std::vector<std::string>>
+  parseQuery(const std::string &query);
+
+  bool add(const std::string server, const std::string id,
+           const FetchedMessage &message);
+  std::vector<IndexedMessage> search(const std::string &query) const;
+  size_t getMessageCount() const;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#pragma once
+#ifndef OUTBOX_HPP
+#define OUTBOX_HPP
+
+#include "Commands.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+const char OUTBOX_FILENAME[] = "outbox";
+
+/**
+ * @brief  Position of an entry in the journal, the sequence number tells it
+ * apart from a later entry written to the same offset after compaction
+ * @retval None
+ */
+struct OutboxRef {
+  uint64_t offset;
+  uint64_t sequence;
+};
+
+/**
+ * @brief  Message waiting in the outbox for the ok response of the server
+ * @retval None
+ */
+struct OutboxEntry {
+  OutboxRef ref;
+  std::string server;
+  std::string user;
+  std::string recipient;
+  std::string subject;
+  std::string body;
+};
+
+/**
+ * @brief  Class keeping the append-only journal of sent messages, the file is
+ * memory-mapped and an entry is acknowledged in place once the server
+ * answered it
+ * @retval None
+ */
+class Outbox {
+private:
+  static const size_t INITIAL_SIZE = 1 << 16;
+  /* Acknowledgements made durable by one fsync */
+  static const size_t GROUP_COMMIT = 32;
+
+  std::string _filename;
+  int _fd{-1};
+  int _resume_fd{-1};
+  uint8_t *_data{};
+  size_t _size{};
+  size_t _unsynced{};
+
+  bool map(size_t size);
+  void unmap();
+  bool refresh();
+  uint64_t getTail() const;
+  void setTail(uint64_t tail);
+  bool readEntry(uint64_t offset, uint64_t tail, OutboxEntry *entry,
+                 uint8_t &state, uint64_t &next) const;
+  bool sync(uint64_t end);
+
+public:
+  Outbox(const std::string filename);
+  Outbox(const Outbox &) = delete;
+  Outbox &operator=(const Outbox &) = delete;
+  ~Outbox();
+
+  bool open();
+  bool lock(bool wait);
+  void unlock();
+  bool lockResume();
+
+  bool append(const std::string &server, const std::string &user,
+              const CommandArgs &command_args, OutboxRef &ref);
+  void acknowledge(const OutboxRef &ref, bool accepted);
+  bool commit();
+  std::vector<OutboxEntry> getPending(const std::string &server,
+                                      const std::string &user);
+  bool compact();
+};
+
+#endif
@@ -0,0 +1,87 @@
+#pragma once
+#ifndef PCAP_READER_HPP
+#define PCAP_READER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief  One packet record of the capture, data point into the mapped file
+ * @retval None
+ */
+struct CapturedPacket {
+  uint64_t timestamp{};
+  uint32_t linktype{};
+  uint32_t length{};
+  const uint8_t *data{};
+};
+
+/**
+ * @brief  TCP segment decoded from the captured packet
+ * @retval None
+ */
+struct TcpSegment {
+  uint64_t timestamp{};
+  std::string source;
+  std::string destination;
+  uint16_t source_port{};
+  uint16_t destination_port{};
+  uint32_t sequence{};
+  uint8_t flags{};
+  uint32_t length{};
+  const uint8_t *payload{};
+};
+
+const uint8_t TCP_FIN = 0x01;
+const uint8_t TCP_SYN = 0x02;
+const uint8_t TCP_RST = 0x04;
+const uint8_t TCP_ACK = 0x10;
+
+/**
+ * @brief  Interface of the pcapng capture
+ * @retval None
+ */
+struct CaptureInterface {
+  uint32_t linktype{};
+  uint64_t units_per_second{1000000};
+};
+
+/**
+ * @brief  Class reading packets of the pcap or pcapng file mapped into memory
+ * @retval None
+ */
+class PcapReader {
+private:
+  int _fd{-1};
+  const uint8_t *_data{};
+  size_t _size{};
+  size_t _offset{};
+  bool _swapped{};
+  bool _nano{};
+  bool _ng{};
+  uint32_t _linktype{};
+  std::vector<CaptureInterface> _interfaces;
+
+  uint16_t read16(size_t offset) const;
+  uint32_t read32(size_t offset) const;
+  bool nextPcap(CapturedPacket &packet);
+  bool nextPcapng(CapturedPacket &packet);
+  void readInterface(size_t offset, size_t length);
+
+public:
+  PcapReader() = default;
+  ~PcapReader();
+  PcapReader(const PcapReader &) = delete;
+  PcapReader &operator=(const PcapReader &) = delete;
+
+  bool open(const std::string filename);
+  bool next(CapturedPacket &packet);
+  size_t getOffset() const;
+  size_t getSize() const;
+
+  static bool decodeTcp(const CapturedPacket &packet, TcpSegment &segment);
+};
+
+#endif
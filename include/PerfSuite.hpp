@@ -0,0 +1,54 @@
+#pragma once
+#ifndef PERF_SUITE_HPP
+#define PERF_SUITE_HPP
+
+#include "LoadGenerator.hpp"
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief  Class running microbenchmarks of the client hot paths and the end to
+ * end benchmark, every metric is a time where lower is better
+ * @retval None
+ */
+class PerfSuite {
+private:
+  /* Every benchmark runs in rounds of at least this many nanoseconds, the
+   * fastest round counts */
+  static const uint64_t ROUND_TIME = 100000000;
+  static const int ROUNDS = 5;
+
+  std::map<std::string, double> _metrics;
+  std::map<std::string, size_t> _sizes;
+  /* Steady-state allocations per request of the end to end operations */
+  std::map<std::string, double> _allocations;
+  size_t _sink{};
+
+  template <typename F> double measure(F &&benchmark);
+  void add(const std::string name, size_t size, double nanoseconds);
+
+public:
+  PerfSuite() = default;
+  ~PerfSuite() = default;
+
+  static std::string getSizeName(size_t size);
+  static std::string makeBody(size_t size);
+  static std::string makeList(size_t size);
+  static std::string makeFetch(const std::string &body);
+
+  void runMicro(const std::vector<size_t> &sizes);
+  void runEndToEnd(const LoadConfig &config);
+
+  static bool readJson(const std::string filename,
+                       std::map<std::string, double> &metrics);
+  void writeJson(std::ostream &os) const;
+  void printReport(std::ostream &os) const;
+  size_t compare(const std::map<std::string, double> &baseline,
+                 double threshold, std::ostream &os) const;
+  size_t checkAllocations(double limit, std::ostream &os) const;
+};
+
+#endif
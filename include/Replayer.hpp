@@ -0,0 +1,71 @@
+#pragma once
+#ifndef REPLAYER_HPP
+#define REPLAYER_HPP
+
+#include "SExpression.hpp"
+#include "TraceWriter.hpp"
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief  Client request extracted from the capture with its response
+ * @retval None
+ */
+struct ReplayRequest {
+  uint64_t timestamp{};
+  uint64_t captured_latency{};
+  std::string request;
+  std::string captured_response;
+};
+
+enum class ReplayMatch { EXACT, STRUCTURAL, MISMATCH };
+
+/**
+ * @brief  Outcome of one replayed request
+ * @retval None
+ */
+struct ReplayResult {
+  std::string command;
+  uint64_t latency{};
+  ReplayMatch match{ReplayMatch::MISMATCH};
+  std::string response;
+};
+
+/**
+ * @brief  Class replaying client requests of the capture against a server
+ * @retval None
+ */
+class Replayer {
+private:
+  std::string _address{};
+  bool _is_v6{};
+  int _port{};
+  std::vector<ReplayRequest> _requests;
+  std::vector<ReplayResult> _results;
+  std::map<std::string, std::string> _tokens;
+  TraceWriter *_trace{};
+
+  static bool sameStructure(const SExpression &captured,
+                            const SExpression &replayed);
+  static ReplayMatch compare(const std::string &captured,
+                             const std::string &replayed);
+  static std::string getLoginToken(const std::string &response);
+  std::string substituteTokens(std::string request) const;
+
+public:
+  Replayer(std::string address, bool isV6, int port);
+  ~Replayer() = default;
+
+  void setTrace(TraceWriter *trace);
+  bool load(const std::string filename, uint16_t capture_port);
+  void run(bool original_timing, double speed);
+  void printReport(std::ostream &os, bool verbose) const;
+
+  size_t getRequestCount() const;
+  size_t getMismatchCount() const;
+};
+
+#endif
@@ -0,0 +1,87 @@
+#pragma once
+#ifndef RING_BUFFER_HPP
+#define RING_BUFFER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+const size_t RING_CAPACITY = 1 << 20;
+
+enum class RingRecordType : uint16_t { PAD, LIST_ENTRY, FETCH, END };
+enum RingField { RING_ID, RING_SENDER, RING_SUBJECT, RING_BODY, RING_FIELDS };
+
+/**
+ * @brief  Record read from the ring, fields point into the shared memory and
+ * stay valid until the next record is read, END closes the output of one
+ * command and its body holds the error of a failed command, a record larger
+ * than half of the ring is split and its fields continue in the following
+ * records while more is set
+ * @retval None
+ */
+struct RingRecord {
+  RingRecordType type{RingRecordType::END};
+  bool ok{};
+  bool more{};
+  std::string_view fields[RING_FIELDS];
+};
+
+/**
+ * @brief  Class publishing records into the shared-memory ring, one writer
+ * holds the ring at a time
+ * @retval None
+ */
+class RingWriter {
+private:
+  /* Time the writer waits for the reader to free space */
+  static const int FULL_WAIT = 1000;
+
+  int _fd{-1};
+  uint8_t *_data{};
+  size_t _size{};
+  uint64_t _head{};
+
+  bool waitForSpace(uint64_t needed);
+  bool writeRecord(RingRecordType type, uint16_t flags,
+                   const std::string_view (&fields)[RING_FIELDS]);
+
+public:
+  RingWriter() = default;
+  RingWriter(const RingWriter &) = delete;
+  RingWriter &operator=(const RingWriter &) = delete;
+  ~RingWriter();
+
+  bool open(const std::string &name);
+  bool lock();
+  bool write(RingRecordType type, bool ok,
+             const std::string_view (&fields)[RING_FIELDS]);
+  void flush();
+};
+
+/**
+ * @brief  Class taking records out of the shared-memory ring, a small
+ * library for consumers on the same host
+ * @retval None
+ */
+class RingReader {
+private:
+  int _fd{-1};
+  uint8_t *_data{};
+  size_t _size{};
+  uint64_t _tail{};
+  uint32_t _current{};
+
+  void consume();
+
+public:
+  RingReader() = default;
+  RingReader(const RingReader &) = delete;
+  RingReader &operator=(const RingReader &) = delete;
+  ~RingReader();
+
+  bool open(const std::string &name, size_t capacity = RING_CAPACITY);
+  bool next(RingRecord &record, int timeout);
+};
+
+#endif
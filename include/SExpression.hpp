@@ -0,0 +1,30 @@
+#pragma once
+#ifndef S_EXPRESSION_HPP
+#define S_EXPRESSION_HPP
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief  Parsed protocol message, i.e. bracketed list of atoms, quoted
+ * strings and nested lists
+ * @retval None
+ */
+struct SExpression {
+  enum class Type { LIST, STRING, ATOM };
+
+  Type type{Type::LIST};
+  std::string value;
+  std::vector<SExpression> items;
+
+  static size_t findEnd(const std::string &data, size_t offset = 0);
+  static bool parse(const std::string &data, SExpression &result);
+  static std::string quote(const std::string &value);
+
+  bool isString() const;
+  bool isAtom() const;
+  bool isList() const;
+  std::string toString() const;
+};
+
+#endif
@@ -0,0 +1,57 @@
+#pragma once
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include "MailStore.hpp"
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief  State of one client connection
+ * @retval None
+ */
+struct ServerConnection {
+  std::string request;
+  std::string response;
+  size_t written{};
+};
+
+/**
+ * @brief  Class serving protocol requests from an epoll event loop, one
+ * request per connection
+ * @retval None
+ */
+class Server {
+private:
+  std::string _address{};
+  bool _is_v6{};
+  int _port{};
+  MailStore &_store;
+  std::string _snapshot{};
+  int _snapshot_interval{};
+
+  int _listenfd{-1};
+  int _epollfd{-1};
+  int _signalfd{-1};
+  int _timerfd{-1};
+  bool _running{};
+  std::unordered_map<int, ServerConnection> _connections;
+
+  void createListener();
+  void createEventSources();
+  void watch(int fd, unsigned events, bool modify = false);
+  void acceptConnections();
+  void readConnection(int fd);
+  void writeConnection(int fd);
+  void closeConnection(int fd);
+  void saveSnapshot();
+
+public:
+  Server(std::string address, bool isV6, int port, MailStore &store);
+  ~Server();
+
+  void setSnapshot(const std::string filename, int interval);
+  void run();
+};
+
+#endif
@@ -0,0 +1,80 @@
+#pragma once
+#ifndef SHARD_GROUP_HPP
+#define SHARD_GROUP_HPP
+
+#include "EventLoop.hpp"
+#include "Task.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief  Work moved out of the coroutine, the eventfd is written once the
+ * work is done by any shard
+ * @retval None
+ */
+struct ShardJob {
+  std::function<void()> work;
+  int done_fd{-1};
+};
+
+/**
+ * @brief  Counters of one shard, written only by its thread
+ * @retval None
+ */
+struct alignas(64) ShardCounters {
+  uint64_t operations{};
+  uint64_t offloaded{};
+  uint64_t jobs{};
+  uint64_t stolen{};
+};
+
+/**
+ * @brief  Class running one event loop per core, sessions stay on the shard
+ * of their user and heavy work is queued so that idle shards can steal it
+ * @retval None
+ */
+class ShardGroup {
+private:
+  struct Shard {
+    EventLoop loop;
+    int wake_fd{-1};
+    std::atomic<bool> sleeping{false};
+    std::mutex mutex;
+    std::deque<ShardJob *> jobs;
+    ShardCounters counters;
+  };
+
+  std::vector<std::unique_ptr<Shard>> _shards;
+
+  ShardJob *popJob(size_t index, bool &stolen);
+  bool runJob(size_t index);
+  void wakeOne(size_t except);
+  static void pinThread(size_t index);
+
+public:
+  ShardGroup(size_t count);
+  ShardGroup(const ShardGroup &) = delete;
+  ShardGroup &operator=(const ShardGroup &) = delete;
+  ~ShardGroup();
+
+  size_t size() const;
+  size_t getShard(const std::string &key) const;
+  EventLoop &getLoop(size_t index);
+  ShardCounters &getCounters(size_t index);
+
+  Task<> offload(size_t index, std::function<void()> work);
+  void run(const std::function<void(size_t, EventLoop &)> &body);
+
+  ShardCounters getTotal() const;
+  void printReport(std::ostream &os) const;
+};
+
+#endif
@@ -0,0 +1,75 @@
+#pragma once
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include "AllocCounter.hpp"
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+enum class Phase {
+  ARGS,
+  TOKEN,
+  CONNECT,
+  ENCODE,
+  SEND,
+  FIRST_BYTE,
+  LAST_BYTE,
+  PARSE,
+  OUTPUT
+};
+
+const int PHASE_COUNT = 9;
+
+/**
+ * @brief  Monotonic timestamps and counters of one request on the connection
+ * @retval None
+ */
+struct RequestTiming {
+  uint64_t connect_start{};
+  uint64_t connect_end{};
+  uint64_t send_start{};
+  uint64_t send_end{};
+  uint64_t first_byte{};
+  uint64_t last_byte{};
+  uint64_t bytes_sent{};
+  uint64_t bytes_received{};
+  uint64_t syscalls{};
+};
+
+/**
+ * @brief  Class collecting per-phase durations of the client run and
+ * reporting them on request
+ * @retval None
+ */
+class Stats {
+private:
+  std::array<uint64_t, PHASE_COUNT> _durations{};
+  std::array<AllocCount, PHASE_COUNT> _allocations{};
+  AllocCount _alloc_start{};
+  AllocCount _alloc_mark{};
+  uint64_t _start{};
+  uint64_t _bytes_sent{};
+  uint64_t _bytes_received{};
+  uint64_t _syscalls{};
+  bool _enabled{};
+  bool _json{};
+
+  Stats();
+  void addAllocations(Phase phase);
+
+public:
+  static Stats &instance();
+  static uint64_t now();
+  static const char *getPhaseName(Phase phase);
+
+  void enable(bool json);
+  bool isEnabled() const;
+  void add(Phase phase, uint64_t start);
+  void addRequest(const RequestTiming &timing);
+  uint64_t getDuration(Phase phase) const;
+  AllocCount getAllocations(Phase phase) const;
+  void print(std::ostream &os) const;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#pragma once
+#ifndef TASK_HPP
+#define TASK_HPP
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+/**
+ * @brief  Resumes the awaiting coroutine when the task finishes
+ * @retval None
+ */
+struct TaskFinalAwaiter {
+  bool await_ready() const noexcept { return false; }
+
+  template <typename Promise>
+  std::coroutine_handle<>
+  await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+    auto continuation = handle.promise().continuation;
+    return continuation ? continuation : std::noop_coroutine();
+  }
+
+  void await_resume() const noexcept {}
+};
+
+/**
+ * @brief  Part of the task promise common to all result types
+ * @retval None
+ */
+struct TaskPromiseBase {
+  std::coroutine_handle<> continuation;
+  std::exception_ptr exception;
+
+  std::suspend_always initial_suspend() const noexcept { return {}; }
+  TaskFinalAwaiter final_suspend() const noexcept { return {}; }
+  void unhandled_exception() { exception = std::current_exception(); }
+
+  void rethrow() const {
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+  }
+};
+
+/**
+ * @brief  Promise storing the result of the task
+ * @retval None
+ */
+template <typename T> struct TaskPromise : TaskPromiseBase {
+  std::optional<T> value;
+
+  void return_value(T result) { value = std::move(result); }
+
+  T result() {
+    rethrow();
+    return std::move(*value);
+  }
+};
+
+/**
+ * @brief  Promise of the task without result
+ * @retval None
+ */
+template <> struct TaskPromise<void> : TaskPromiseBase {
+  void return_void() const noexcept {}
+  void result() const { rethrow(); }
+};
+
+/**
+ * @brief  Lazily started coroutine, runs when awaited and resumes the awaiting
+ * coroutine when it finishes
+ * @retval None
+ */
+template <typename T = void> class Task {
+public:
+  struct promise_type : TaskPromise<T> {
+    Task get_return_object() {
+      return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+  };
+
+private:
+  std::coroutine_handle<promise_type> _handle;
+
+  explicit Task(std::coroutine_handle<promise_type> handle)
+      : _handle(handle) {}
+
+public:
+  Task(Task &&other) noexcept : _handle(std::exchange(other._handle, {})) {}
+  Task(const Task &) = delete;
+  Task &operator=(const Task &) = delete;
+  ~Task() {
+    if (_handle) {
+      _handle.destroy();
+    }
+  }
+
+  bool await_ready() const noexcept { return !_handle || _handle.done(); }
+
+  std::coroutine_handle<>
+  await_suspend(std::coroutine_handle<> awaiting) noexcept {
+    _handle.promise().continuation = awaiting;
+    return _handle;
+  }
+
+  T await_resume() { return _handle.promise().result(); }
+};
+
+#endif
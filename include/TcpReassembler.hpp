@@ -0,0 +1,74 @@
+#pragma once
+#ifndef TCP_REASSEMBLER_HPP
+#define TCP_REASSEMBLER_HPP
+
+#include "PcapReader.hpp"
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief  Complete protocol message cut out of the TCP stream
+ * @retval None
+ */
+struct StreamMessage {
+  std::string data;
+  uint64_t first_timestamp{};
+  uint64_t last_timestamp{};
+};
+
+/**
+ * @brief  Data of one direction of the TCP connection in sequence order
+ * @retval None
+ */
+struct TcpStream {
+  std::string data;
+  std::vector<std::pair<size_t, uint64_t>> arrivals;
+  std::map<uint32_t, std::pair<std::string, uint64_t>> pending;
+  uint32_t next_sequence{};
+  bool started{};
+  bool closed{};
+
+  void add(const TcpSegment &segment);
+  uint64_t timestampAt(size_t offset) const;
+  std::vector<StreamMessage> messages() const;
+};
+
+/**
+ * @brief  Both directions of one TCP connection to the server port
+ * @retval None
+ */
+struct TcpFlow {
+  std::string client_address;
+  uint16_t client_port{};
+  std::string server_address;
+  uint16_t server_port{};
+  uint64_t start{};
+  TcpStream request;
+  TcpStream response;
+};
+
+/**
+ * @brief  Class reassembling TCP connections to the server port, finished
+ * connections are handed over to the callback
+ * @retval None
+ */
+class TcpReassembler {
+private:
+  uint16_t _port{};
+  std::function<void(TcpFlow &)> _on_flow;
+  std::unordered_map<std::string, TcpFlow> _flows;
+
+  void finish(const std::string &key);
+
+public:
+  TcpReassembler(uint16_t port, std::function<void(TcpFlow &)> on_flow);
+  ~TcpReassembler() = default;
+
+  void add(const TcpSegment &segment);
+  void flush();
+};
+
+#endif
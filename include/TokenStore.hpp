@@ -0,0 +1,60 @@
+#pragma once
+#ifndef TOKEN_STORE_HPP
+#define TOKEN_STORE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+const char TOKEN_STORE_FILENAME[] = "login-tokens";
+
+/**
+ * @brief  Class keeping login tokens of many users on many servers, the file
+ * is a memory-mapped open-addressing hash table shared by processes under
+ * file locks, slots refer to variable-length records of the key and token
+ * kept behind the table
+ * @retval None
+ */
+class TokenStore {
+private:
+  static const size_t INITIAL_CAPACITY = 64;
+  static const size_t SLOT_LENGTH = 32;
+  static const size_t INITIAL_RECORDS = 1 << 12;
+
+  std::string _filename;
+  int _fd{-1};
+  uint8_t *_data{};
+  size_t _size{};
+
+  bool map(size_t size);
+  void unmap();
+  bool lock(bool exclusive);
+  void unlock();
+  bool refresh();
+  uint64_t readHeader(size_t field) const;
+  void writeHeader(size_t field, uint64_t value);
+  uint8_t *getSlot(uint64_t index) const;
+  const uint8_t *getRecord(const uint8_t *slot) const;
+  uint64_t findSlot(const std::string &key, uint64_t hash, bool insert) const;
+  bool grow(uint64_t extra);
+
+public:
+  TokenStore(const std::string filename);
+  TokenStore(const TokenStore &) = delete;
+  TokenStore &operator=(const TokenStore &) = delete;
+  ~TokenStore();
+
+  static std::string makeKey(const std::string &server,
+                             const std::string &user);
+
+  bool open();
+  bool get(const std::string &server, const std::string &user,
+           std::string &token);
+  std::vector<std::string> getUsers(const std::string &server);
+  bool put(const std::string &server, const std::string &user,
+           const std::string &token);
+  bool remove(const std::string &server, const std::string &user);
+};
+
+#endif
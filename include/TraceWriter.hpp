@@ -0,0 +1,53 @@
+#pragma once
+#ifndef TRACE_WRITER_HPP
+#define TRACE_WRITER_HPP
+
+#include "Stats.hpp"
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief  One span of the trace, timestamps are monotonic nanoseconds
+ * @retval None
+ */
+struct TraceEvent {
+  std::string name;
+  std::string category;
+  int track;
+  uint64_t start;
+  uint64_t end;
+  std::string args;
+};
+
+/**
+ * @brief  Class collecting spans of requests and writing them in Chrome Trace
+ * Event format, loadable by Perfetto and chrome://tracing
+ * @retval None
+ */
+class TraceWriter {
+private:
+  std::string _process;
+  std::vector<TraceEvent> _events;
+  std::map<int, std::string> _tracks;
+  mutable std::mutex _mutex;
+
+  static void writeEscaped(std::ostream &os, const std::string &value);
+
+public:
+  TraceWriter(std::string process);
+  ~TraceWriter() = default;
+
+  void setTrackName(int track, const std::string name);
+  void addSpan(int track, const std::string name, const std::string category,
+               uint64_t start, uint64_t end, const std::string args = "");
+  void addRequest(int track, const std::string command,
+                  const RequestTiming &timing, uint64_t parse_end);
+  size_t getEventCount() const;
+  void write(std::ostream &os) const;
+};
+
+#endif
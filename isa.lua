@@ -1,66 +1,343 @@
 isa_proto = Proto("ISAproto", "ISA Protocol") -- declare the protocol
 
+local ISA_PORT = 32323
+
 -- create and assign the fields to ISAproto
-message_length = ProtoField.int32("isa.message_length", "Message length", base.DEC)
-state = ProtoField.string("isa.state", "State", base.ASCII)
-i_data = ProtoField.string("isa.data", "Data", base.ASCII)
-isa_proto.fields = {message_length, state, i_data}
+local message_length = ProtoField.int32("isa.message_length", "Message length", base.DEC)
+local state = ProtoField.string("isa.state", "State", base.ASCII)
+local command = ProtoField.string("isa.command", "Command", base.ASCII)
+local status = ProtoField.string("isa.status", "Status", base.ASCII)
+local token = ProtoField.string("isa.token", "Login token", base.ASCII)
+local argument = ProtoField.string("isa.argument", "Argument", base.ASCII)
+local i_data = ProtoField.string("isa.data", "Data", base.ASCII)
+local response_in = ProtoField.framenum("isa.response_in", "Response in", base.NONE, frametype.RESPONSE)
+local request_in = ProtoField.framenum("isa.request_in", "Request in", base.NONE, frametype.REQUEST)
+local response_time = ProtoField.relative_time("isa.response_time", "Response time")
+isa_proto.fields = {message_length, state, command, status, token, argument, i_data,
+                    response_in, request_in, response_time}
 
--- declare dst and src port fields for reading
-tcp_src_f = Field.new("tcp.srcport")
-tcp_dst_f = Field.new("tcp.dstport")
+-- expert info for slow and failed replies
+local slow_expert = ProtoExpert.new("isa.slow_response", "Slow server response",
+                                    expert.group.SEQUENCE, expert.severity.WARN)
+local error_expert = ProtoExpert.new("isa.error_response", "Server returned an error",
+                                     expert.group.RESPONSE_CODE, expert.severity.NOTE)
+local unanswered_expert = ProtoExpert.new("isa.unanswered", "Request without response",
+                                          expert.group.SEQUENCE, expert.severity.NOTE)
+isa_proto.experts = {slow_expert, error_expert, unanswered_expert}
 
--- dissecting function
-function isa_proto.dissector(buffer, pinfo, tree)
-    length = tostring(buffer:len()) -- get message length
-    if length == 0 then
+isa_proto.prefs.slow_threshold = Pref.uint("Slow response threshold [ms]", 100,
+                                           "Responses slower than this get an expert warning")
+
+-- labels of request arguments by command, token arguments get the token field
+local REQUEST_ARGUMENTS = {
+    register = {"Username", "Password (base64)"},
+    login = {"Username", "Password (base64)"},
+    list = {"Login token"},
+    send = {"Login token", "Recipient", "Subject", "Body"},
+    fetch = {"Login token", "Message id"},
+    logout = {"Login token"},
+}
+
+-- declare tcp stream field for conversation tracking
+local tcp_stream_f = Field.new("tcp.stream")
+
+-- requests and responses of every tcp stream, filled in the first pass
+local conversations = {}
+local messages = {}
+
+function isa_proto.init()
+    conversations = {}
+    messages = {}
+end
+
+-- find closing bracket of the message starting at start, nil if it is not complete
+local function find_end(data, start)
+    local depth = 0
+    local pos = start
+    while true do
+        local i = string.find(data, '[()"]', pos)
+        if not i then
+            return nil
+        end
+        local c = string.sub(data, i, i)
+        if c == '"' then
+            -- skip quoted string, escaped chars included
+            local j = i + 1
+            while true do
+                local k = string.find(data, '[\\"]', j)
+                if not k then
+                    return nil
+                end
+                if string.sub(data, k, k) == "\\" then
+                    j = k + 2
+                else
+                    pos = k + 1
+                    break
+                end
+            end
+        elseif c == "(" then
+            depth = depth + 1
+            pos = i + 1
+        else
+            depth = depth - 1
+            pos = i + 1
+            if depth <= 0 then
+                return i
+            end
+        end
+    end
+end
+
+-- parse list, quoted string or atom at pos, returns element and position behind it
+local function parse_element(data, pos)
+    pos = string.find(data, "%S", pos)
+    if not pos then
+        return nil
+    end
+    local c = string.sub(data, pos, pos)
+
+    if c == "(" then
+        local list = {kind = "list", start = pos, items = {}}
+        pos = pos + 1
+        while true do
+            pos = string.find(data, "%S", pos)
+            if not pos then
+                return nil
+            end
+            if string.sub(data, pos, pos) == ")" then
+                list.stop = pos
+                return list, pos + 1
+            end
+            local element
+            element, pos = parse_element(data, pos)
+            if not element then
+                return nil
+            end
+            table.insert(list.items, element)
+        end
+    end
+
+    if c == '"' then
+        local j = pos + 1
+        while true do
+            local k = string.find(data, '[\\"]', j)
+            if not k then
+                return nil
+            end
+            if string.sub(data, k, k) == "\\" then
+                j = k + 2
+            else
+                local value = (string.gsub(string.sub(data, pos + 1, k - 1), "\\(.)", function(e)
+                    if e == "n" then
+                        return "\n"
+                    end
+                    return e
+                end))
+                return {kind = "string", value = value, start = pos, stop = k}, k + 1
+            end
+        end
+    end
+
+    if c == ")" then
+        return nil
+    end
+
+    local stop = (string.find(data, '[%s()"]', pos) or (#data + 1)) - 1
+    return {kind = "atom", value = string.sub(data, pos, stop), start = pos, stop = stop}, stop + 1
+end
+
+-- range of the buffer covered by the parsed element
+local function element_range(buffer, element)
+    return buffer(element.start - 1, element.stop - element.start + 1)
+end
+
+-- add element of the message to the tree under the label
+local function add_element(buffer, tree, field, element, label)
+    if element.kind == "list" then
+        local subtree = tree:add(element_range(buffer, element), label)
+        for i, item in ipairs(element.items) do
+            add_element(buffer, subtree, argument, item, "Item " .. i)
+        end
+        return subtree
+    end
+    return tree:add(field, element_range(buffer, element), element.value):set_text(label .. ": " .. element.value)
+end
+
+-- add arguments of the client request
+local function add_request(buffer, subtree, message, command_str)
+    local labels = REQUEST_ARGUMENTS[command_str] or {}
+    for i = 2, #message.items do
+        local label = labels[i - 1] or "Argument"
+        local field = label == "Login token" and token or argument
+        add_element(buffer, subtree, field, message.items[i], label)
+    end
+end
+
+-- add content of the server response according to the command it answers
+local function add_response(buffer, subtree, message, command_str)
+    local content = message.items[2]
+    if not content then
         return
     end
 
-    if string.char(buffer(length - 1, 1):uint()) ~= ")" then -- if packet does not end properly try desegment one more segment
-        pinfo.desegment_len = DESEGMENT_ONE_MORE_SEGMENT
+    if command_str == "list" and content.kind == "list" then
+        local listing = subtree:add(element_range(buffer, content), "Messages: " .. #content.items)
+        for _, entry in ipairs(content.items) do
+            if entry.kind == "list" and #entry.items >= 3 then
+                local item = listing:add(element_range(buffer, entry), "Message " .. entry.items[1].value)
+                add_element(buffer, item, argument, entry.items[2], "From")
+                add_element(buffer, item, argument, entry.items[3], "Subject")
+            end
+        end
+    elseif command_str == "fetch" and content.kind == "list" then
+        local labels = {"From", "Subject", "Body"}
+        for i, item in ipairs(content.items) do
+            add_element(buffer, subtree, argument, item, labels[i] or "Argument")
+        end
+    else
+        add_element(buffer, subtree, argument, content, "Message")
+        for i = 3, #message.items do
+            local is_token = command_str == "login" and i == 3
+            add_element(buffer, subtree, is_token and token or argument, message.items[i],
+                        is_token and "Login token" or "Argument")
+        end
     end
+end
 
-    if tostring(buffer:reported_len()) ~= length then -- if packet is cut off due to user limit, do not dissect
-        return 0
+-- convert seconds to the relative time value
+local function to_nstime(seconds)
+    local whole = math.floor(seconds)
+    return NSTime.new(whole, math.floor((seconds - whole) * 1e9))
+end
+
+-- pair the message with its request or response and show the response time
+local function track_conversation(pinfo, subtree, start, is_request, command_str)
+    local key = pinfo.number .. ":" .. start
+    if not pinfo.visited and not messages[key] then
+        local stream = tcp_stream_f().value
+        local conversation = conversations[stream]
+        if not conversation then
+            conversation = {requests = {}, responses = {}}
+            conversations[stream] = conversation
+        end
+        local list = is_request and conversation.requests or conversation.responses
+        table.insert(list, {frame = pinfo.number, time = pinfo.abs_ts, command = command_str})
+        messages[key] = {conversation = conversation, index = #list, request = is_request}
+    end
+
+    local info = messages[key]
+    if not info then
+        return nil
     end
+    local request = info.conversation.requests[info.index]
+    local response = info.conversation.responses[info.index]
 
-    -- cut message status from message data char by char
-    local t = {}
-    local i = 0
-    while string.char(buffer(i, 1):uint()) ~= " " do
-        t[i] = tostring(string.char(buffer(i, 1):uint()))
-        i = i + 1
+    if info.request then
+        if response then
+            subtree:add(response_in, response.frame):set_generated()
+            subtree:add(response_time, to_nstime(response.time - request.time)):set_generated()
+        elseif pinfo.visited then
+            subtree:add_proto_expert_info(unanswered_expert)
+        end
+        return command_str
     end
 
-    state_str = table.concat(t, "") -- make string from the char array
+    if not request then
+        return nil
+    end
+    subtree:add(request_in, request.frame):set_generated()
+    local delta = response.time - request.time
+    local time_item = subtree:add(response_time, to_nstime(delta))
+    time_item:set_generated()
+    if delta * 1000 >= isa_proto.prefs.slow_threshold then
+        time_item:add_proto_expert_info(slow_expert, string.format("Slow server response: %.3f ms", delta * 1000))
+    end
+    return request.command
+end
 
-    local tcp_src = tcp_src_f() -- get source port
-    local tcp_dst = tcp_dst_f() -- get destination port
+-- dissect one complete message between start and stop (1-based positions)
+local function dissect_message(buffer, pinfo, tree, data, start, stop)
+    local length = stop - start + 1
+    local is_request = pinfo.dst_port == ISA_PORT
+    local message = parse_element(data, start)
+    local head = message and message.kind == "list" and message.items[1]
+    local head_str = head and head.value or ""
 
     -- decision on the direction on the basis of the port
-    if tostring(tcp_src) == "32323" then
-        if (state_str ~= "ok" and state_str ~= "err") then
-            state_str = "Server response"
-        else
-            state_str = "Server response: " .. state_str
+    local state_str
+    if is_request then
+        state_str = "Client request: " .. head_str
+    elseif head_str == "ok" or head_str == "err" then
+        state_str = "Server response: " .. head_str
+    else
+        state_str = "Server response"
+    end
+
+    local subtree = tree:add(isa_proto, buffer(start - 1, length), "ISA Protocol Data") -- create Protocol tree
+
+    -- add items to the tree
+    subtree:add(message_length, buffer(start - 1, length), length)
+    subtree:add(state, buffer(start - 1, length), state_str)
+    if length > 2 then
+        subtree:add(i_data, buffer(start, length - 2))
+    end
+
+    local command_str = track_conversation(pinfo, subtree, start, is_request, head_str)
+    if not head then
+        return state_str
+    end
+
+    if is_request then
+        subtree:add(command, element_range(buffer, head), head_str)
+        add_request(buffer, subtree, message, head_str)
+    else
+        subtree:add(status, element_range(buffer, head), head_str)
+        if head_str == "err" and message.items[2] then
+            subtree:add_proto_expert_info(error_expert, "Server error: " .. tostring(message.items[2].value))
+        end
+        add_response(buffer, subtree, message, command_str)
+        if command_str then
+            state_str = state_str .. " (" .. command_str .. ")"
         end
     end
+    return state_str
+end
 
-    if tostring(tcp_dst) == "32323" then
-        state_str = "Client request: " .. state_str
+-- dissecting function
+function isa_proto.dissector(buffer, pinfo, tree)
+    local length = buffer:len() -- get message length
+    if length == 0 then
+        return 0
     end
 
-    pinfo.cols.protocol = isa_proto.name
+    if buffer:reported_len() ~= length then -- if packet is cut off due to user limit, do not dissect
+        return 0
+    end
 
-    pinfo.cols.info = state_str
-    local subtree = tree:add(isa_proto, buffer(), "ISA Protocol Data") -- create Protocol tree
+    local data = buffer():string()
+    local infos = {}
+    local offset = 1
+    while offset <= length do
+        local start = string.find(data, "(", offset, true)
+        if not start then
+            break
+        end
+        local stop = find_end(data, start)
+        if not stop then -- if message does not end properly try desegment one more segment
+            pinfo.desegment_offset = start - 1
+            pinfo.desegment_len = DESEGMENT_ONE_MORE_SEGMENT
+            break
+        end
+        table.insert(infos, dissect_message(buffer, pinfo, tree, data, start, stop))
+        offset = stop + 1
+    end
 
-    -- add items to the tree
-    subtree:add(message_length, length)
-    subtree:add(state, state_str)
-    subtree:add(i_data, buffer(1, length - 2))
+    if #infos > 0 then
+        pinfo.cols.protocol = isa_proto.name
+        pinfo.cols.info = table.concat(infos, "; ")
+    end
+    return length
 end
 
 tcp_port = DissectorTable.get("tcp.port")
-tcp_port:add(32323, isa_proto) -- register the protocol
+tcp_port:add(ISA_PORT, isa_proto) -- register the protocol
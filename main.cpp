@@ -1,6 +1,7 @@
 #include "./include/ArgsParser.hpp"
 #include "./include/Client.hpp"
 #include "./include/CommunicationBase.hpp"
+#include "./include/FanOutClient.hpp"
 
 /**
  * @brief  Main function
@@ -10,7 +11,14 @@
  */
 int main(int argc, char **argv) {
 
-  Client client(ArgsParser(argc, argv));
+  ArgsParser args(argc, argv);
+  /* Search is answered from the local index whatever the servers are */
+  if (args.getEndpoints().size() > 1 &&
+      args.getCommandType() != CommandType::SEARCH) {
+    FanOutClient client(args);
+  } else {
+    Client client(args);
+  }
 
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,199 @@
+#include "./include/ArgsParser.hpp"
+#include "./include/LoadGenerator.hpp"
+#include "./include/PerfSuite.hpp"
+
+#include <fstream>
+#include <getopt.h>
+#include <iostream>
+
+/**
+ * @brief  Prints benchmark suite help
+ * @retval None
+ */
+void printPerfHelp() {
+  std::cout << "usage: isa-perf [ <option> ... ]" << std::endl
+            << "Options:" << std::endl
+            << "[-h | --help]" << std::endl
+            << "  Show this help" << std::endl
+            << "[-a | --address]  <address>" << std::endl
+            << "  Server of the end to end benchmark (default localhost)"
+            << std::endl
+            << "[-p | --port]     <port>" << std::endl
+            << "  Port of the server (default 32323)" << std::endl
+            << "[-u | --users]    <count>" << std::endl
+            << "  Users of the end to end benchmark (default 4)" << std::endl
+            << "[-n | --requests] <count>" << std::endl
+            << "  Requests of the end to end benchmark (default 4000)"
+            << std::endl
+            << "--max-size <bytes>" << std::endl
+            << "  Largest data of microbenchmarks, sizes are 1 KB, 1 MB and "
+               "100 MB (default 100 MB)"
+            << std::endl
+            << "--micro-only" << std::endl
+            << "  Skip the end to end benchmark" << std::endl
+            << "--json <file>" << std::endl
+            << "  Export results in JSON format" << std::endl
+            << "--baseline <file>" << std::endl
+            << "  Compare results with the baseline exported earlier"
+            << std::endl
+            << "--threshold <percent>" << std::endl
+            << "  Allowed slowdown against the baseline (default 50)"
+            << std::endl
+            << "--max-allocs <count>" << std::endl
+            << "  Fail when steady-state requests of an end to end operation "
+               "allocate more on"
+            << std::endl
+            << "  average" << std::endl;
+}
+
+/**
+ * @brief  Prints problem with benchmark arguments and exits
+ * @param  problem: type of problem
+ * @retval None
+ */
+void perfProblem(const std::string problem) {
+  std::cerr << "Invalid " << problem
+            << " , see help {-h | --help} for more info." << std::endl;
+  exit(1);
+}
+
+/**
+ * @brief  Benchmark suite main function
+ * @param  argc: number of strings pointed to by argv
+ * @param  **argv: array of arguments
+ * @retval 0: no metric regressed | 1: some metric regressed or allocations
+ * exceeded the limit
+ */
+int main(int argc, char **argv) {
+  LoadConfig config;
+  config.users = 4;
+  config.requests = 4000;
+  config.prefix = "perf";
+  size_t max_size{100 << 20};
+  bool micro_only{false};
+  std::string json_file;
+  std::string baseline_file;
+  double threshold{50};
+  double max_allocs{-1};
+
+  static struct option long_options[] = {
+      {"address", required_argument, 0, 'a'},
+      {"port", required_argument, 0, 'p'},
+      {"users", required_argument, 0, 'u'},
+      {"requests", required_argument, 0, 'n'},
+      {"max-size", required_argument, 0, 'S'},
+      {"micro-only", no_argument, 0, 'M'},
+      {"json", required_argument, 0, 'J'},
+      {"baseline", required_argument, 0, 'B'},
+      {"threshold", required_argument, 0, 'T'},
+      {"max-allocs", required_argument, 0, 'A'},
+      {"help", no_argument, 0, 'h'},
+      {0, 0, 0, 0}};
+
+  int c;
+  int option_index;
+  try {
+    while ((c = getopt_long(argc, argv, "a:p:u:n:h", long_options,
+                            &option_index)) != -1) {
+      switch (c) {
+      case 'a':
+        if (!ArgsParser::resolveAddress(optarg, config.address,
+                                        config.is_v6)) {
+          perfProblem("address");
+        }
+        break;
+      case 'p':
+        config.port = std::stoi(optarg);
+        if (config.port <= 0 || config.port > 65535) {
+          perfProblem("port");
+        }
+        break;
+      case 'u':
+        config.users = std::stoi(optarg);
+        if (config.users <= 0) {
+          perfProblem("users");
+        }
+        break;
+      case 'n':
+        config.requests = std::stoull(optarg);
+        if (!config.requests) {
+          perfProblem("requests");
+        }
+        break;
+      case 'S':
+        max_size = std::stoull(optarg);
+        break;
+      case 'M':
+        micro_only = true;
+        break;
+      case 'J':
+        json_file = optarg;
+        break;
+      case 'B':
+        baseline_file = optarg;
+        break;
+      case 'T':
+        threshold = std::stod(optarg);
+        if (threshold < 0) {
+          perfProblem("threshold");
+        }
+        break;
+      case 'A':
+        max_allocs = std::stod(optarg);
+        if (max_allocs < 0) {
+          perfProblem("allocation limit");
+        }
+        break;
+      case 'h':
+        printPerfHelp();
+        exit(0);
+      default:
+        perfProblem("option");
+      }
+    }
+  } catch (const std::exception &) {
+    perfProblem("option value");
+  }
+
+  std::map<std::string, double> baseline;
+  if (!baseline_file.empty() &&
+      !PerfSuite::readJson(baseline_file, baseline)) {
+    std::cerr << "ERR: Baseline could not be read :(" << std::endl;
+    exit(1);
+  }
+
+  std::vector<size_t> sizes;
+  for (size_t size : {size_t{1} << 10, size_t{1} << 20, size_t{100} << 20}) {
+    if (size <= max_size) {
+      sizes.push_back(size);
+    }
+  }
+
+  PerfSuite suite;
+  suite.runMicro(sizes);
+  if (!micro_only) {
+    suite.runEndToEnd(config);
+  }
+  suite.printReport(std::cout);
+
+  if (!json_file.empty()) {
+    std::ofstream file(json_file);
+    if (!file.is_open()) {
+      std::cerr << "ERR: Results could not be saved :(" << std::endl;
+      exit(1);
+    }
+    suite.writeJson(file);
+  }
+
+  if (!baseline_file.empty() &&
+      suite.compare(baseline, threshold, std::cout) > 0) {
+    std::cerr << "ERR: Performance regressed against the baseline :("
+              << std::endl;
+    exit(1);
+  }
+  if (max_allocs >= 0 && suite.checkAllocations(max_allocs, std::cerr) > 0) {
+    exit(1);
+  }
+
+  return 0;
+}
@@ -0,0 +1,156 @@
+#include "./include/ArgsParser.hpp"
+#include "./include/Replayer.hpp"
+#include "./include/Stats.hpp"
+#include "./include/TraceWriter.hpp"
+
+#include <fstream>
+#include <getopt.h>
+#include <iostream>
+
+/**
+ * @brief  Prints replay tool help
+ * @retval None
+ */
+void printReplayHelp() {
+  std::cout << "usage: isa-replay [ <option> ... ] <capture.pcap>" << std::endl
+            << "Options:" << std::endl
+            << "[-h | --help]" << std::endl
+            << "  Show this help" << std::endl
+            << "[-a | --address]  <address>" << std::endl
+            << "  Target server hostname or address (default localhost)"
+            << std::endl
+            << "[-p | --port]     <port>" << std::endl
+            << "  Target server port (default 32323)" << std::endl
+            << "[-c | --capture-port] <port>" << std::endl
+            << "  Server port in the capture (default 32323)" << std::endl
+            << "[-f | --fast]" << std::endl
+            << "  Send requests as fast as possible instead of the original "
+               "timing"
+            << std::endl
+            << "[-s | --speed]    <factor>" << std::endl
+            << "  Speed up the original timing (default 1)" << std::endl
+            << "[-v | --verbose]" << std::endl
+            << "  Show responses that did not match" << std::endl
+            << "--trace <file>" << std::endl
+            << "  Export spans of requests in Chrome Trace Event format"
+            << std::endl
+            << "Exits with 2 if any response does not match the capture."
+            << std::endl;
+}
+
+/**
+ * @brief  Prints problem with replay arguments and exits
+ * @param  problem: type of problem
+ * @retval None
+ */
+void replayProblem(const std::string problem) {
+  std::cerr << "Invalid " << problem
+            << " , see help {-h | --help} for more info." << std::endl;
+  exit(1);
+}
+
+/**
+ * @brief  Replay tool main function
+ * @param  argc: number of strings pointed to by argv
+ * @param  **argv: array of arguments
+ * @retval 0 if all responses match, 2 otherwise
+ */
+int main(int argc, char **argv) {
+  std::string address{"::1"};
+  bool is_v6{true};
+  int port{32323};
+  int capture_port{32323};
+  bool original_timing{true};
+  double speed{1.0};
+  bool verbose{false};
+  std::string trace_file;
+
+  static struct option long_options[] = {
+      {"address", required_argument, 0, 'a'},
+      {"port", required_argument, 0, 'p'},
+      {"capture-port", required_argument, 0, 'c'},
+      {"fast", no_argument, 0, 'f'},
+      {"speed", required_argument, 0, 's'},
+      {"verbose", no_argument, 0, 'v'},
+      {"trace", required_argument, 0, 'T'},
+      {"help", no_argument, 0, 'h'},
+      {0, 0, 0, 0}};
+
+  int c;
+  int option_index;
+  try {
+    while ((c = getopt_long(argc, argv, "a:p:c:fs:vh", long_options,
+                            &option_index)) != -1) {
+      switch (c) {
+      case 'a':
+        if (!ArgsParser::resolveAddress(optarg, address, is_v6)) {
+          replayProblem("address");
+        }
+        break;
+      case 'p':
+        port = std::stoi(optarg);
+        if (port <= 0 || port > 65535) {
+          replayProblem("port");
+        }
+        break;
+      case 'c':
+        capture_port = std::stoi(optarg);
+        if (capture_port <= 0 || capture_port > 65535) {
+          replayProblem("capture port");
+        }
+        break;
+      case 'f':
+        original_timing = false;
+        break;
+      case 's':
+        speed = std::stod(optarg);
+        if (speed <= 0) {
+          replayProblem("speed");
+        }
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      case 'T':
+        trace_file = optarg;
+        break;
+      case 'h':
+        printReplayHelp();
+        exit(0);
+      default:
+        replayProblem("option");
+      }
+    }
+  } catch (const std::exception &) {
+    replayProblem("option value");
+  }
+  if (optind != argc - 1) {
+    replayProblem("arguments");
+  }
+
+  Replayer replayer(address, is_v6, port);
+  if (!replayer.load(argv[optind], static_cast<uint16_t>(capture_port))) {
+    std::cerr << "ERR: Capture could not be read :(" << std::endl;
+    exit(1);
+  }
+  TraceWriter trace("isa-replay");
+  if (!trace_file.empty()) {
+    replayer.setTrace(&trace);
+    trace.setTrackName(0, "main");
+  }
+  replayer.run(original_timing, speed);
+
+  uint64_t start = Stats::now();
+  replayer.printReport(std::cout, verbose);
+  if (!trace_file.empty()) {
+    trace.addSpan(0, "output", "client", start, Stats::now());
+    std::ofstream file(trace_file);
+    if (!file.is_open()) {
+      std::cerr << "ERR: Trace could not be saved :(" << std::endl;
+      exit(1);
+    }
+    trace.write(file);
+  }
+
+  return replayer.getMismatchCount() ? 2 : 0;
+}
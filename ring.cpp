@@ -0,0 +1,149 @@
+#include "./include/RingBuffer.hpp"
+
+#include <getopt.h>
+#include <iostream>
+
+/**
+ * @brief  Prints ring reader help
+ * @retval None
+ */
+void printRingHelp() {
+  std::cout << "usage: isa-ring [ <option> ... ] <name>" << std::endl
+            << "Options:" << std::endl
+            << "[-h | --help]" << std::endl
+            << "  Show this help" << std::endl
+            << "[-c | --capacity] <bytes>" << std::endl
+            << "  Capacity of a created ring, power of two (default 1 MB)"
+            << std::endl
+            << "[-n | --count]    <count>" << std::endl
+            << "  Stop after the output of count commands (default never)"
+            << std::endl
+            << "[-t | --timeout]  <ms>" << std::endl
+            << "  Stop when no record comes in time (default never)"
+            << std::endl;
+}
+
+/**
+ * @brief  Prints problem with ring reader arguments and exits
+ * @param  problem: type of problem
+ * @retval None
+ */
+void ringProblem(const std::string problem) {
+  std::cerr << "Invalid " << problem
+            << " , see help {-h | --help} for more info." << std::endl;
+  exit(1);
+}
+
+/**
+ * @brief  Writes the record, fields are separated by tabs
+ * @param  &record: record read from the ring
+ * @param  &os: output stream
+ * @retval None
+ */
+void printRecord(const RingRecord &record, std::ostream &os) {
+  switch (record.type) {
+  case RingRecordType::LIST_ENTRY:
+    os << "list\t" << record.fields[RING_ID] << "\t"
+       << record.fields[RING_SENDER] << "\t" << record.fields[RING_SUBJECT]
+       << std::endl;
+    break;
+  case RingRecordType::FETCH:
+    os << "fetch\t" << record.fields[RING_ID] << "\t"
+       << record.fields[RING_SENDER] << "\t" << record.fields[RING_SUBJECT]
+       << std::endl
+       << record.fields[RING_BODY] << std::endl;
+    break;
+  default:
+    os << "end\t" << (record.ok ? "ok" : "error") << "\t"
+       << record.fields[RING_BODY] << std::endl;
+    break;
+  }
+}
+
+/**
+ * @brief  Ring reader main function
+ * @param  argc: number of strings pointed to by argv
+ * @param  **argv: array of arguments
+ * @retval 0
+ */
+int main(int argc, char **argv) {
+  size_t capacity{RING_CAPACITY};
+  long count{-1};
+  int timeout{-1};
+
+  static struct option long_options[] = {
+      {"capacity", required_argument, 0, 'c'},
+      {"count", required_argument, 0, 'n'},
+      {"timeout", required_argument, 0, 't'},
+      {"help", no_argument, 0, 'h'},
+      {0, 0, 0, 0}};
+
+  int c;
+  int option_index;
+  try {
+    while ((c = getopt_long(argc, argv, "c:n:t:h", long_options,
+                            &option_index)) != -1) {
+      switch (c) {
+      case 'c':
+        capacity = std::stoul(optarg);
+        break;
+      case 'n':
+        count = std::stol(optarg);
+        if (count <= 0) {
+          ringProblem("count");
+        }
+        break;
+      case 't':
+        timeout = std::stoi(optarg);
+        if (timeout < 0) {
+          ringProblem("timeout");
+        }
+        break;
+      case 'h':
+        printRingHelp();
+        exit(0);
+      default:
+        ringProblem("option");
+      }
+    }
+  } catch (const std::exception &) {
+    ringProblem("option value");
+  }
+  if (optind != argc - 1) {
+    ringProblem("arguments");
+  }
+
+  RingReader reader;
+  if (!reader.open(argv[optind], capacity)) {
+    std::cerr << "ERR: Ring could not be opened :(" << std::endl;
+    exit(1);
+  }
+
+  RingRecord record;
+  std::string parts[RING_FIELDS];
+  bool continued{false};
+  while (count && reader.next(record, timeout)) {
+    /* Fields of a split record are joined before it is printed */
+    if (record.more || continued) {
+      for (size_t i = 0; i < RING_FIELDS; i++) {
+        parts[i].append(record.fields[i]);
+      }
+      continued = record.more;
+      if (continued) {
+        continue;
+      }
+      for (size_t i = 0; i < RING_FIELDS; i++) {
+        record.fields[i] = parts[i];
+      }
+    }
+    printRecord(record, std::cout);
+    for (auto &part : parts) {
+      part.clear();
+    }
+    if (record.type == RingRecordType::END) {
+      std::cout << std::flush;
+      count--;
+    }
+  }
+  return 0;
+}
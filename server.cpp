@@ -0,0 +1,108 @@
+#include "./include/ArgsParser.hpp"
+#include "./include/MailStore.hpp"
+#include "./include/Server.hpp"
+
+#include <getopt.h>
+#include <iostream>
+
+/**
+ * @brief  Prints server help
+ * @retval None
+ */
+void printServerHelp() {
+  std::cout << "usage: isa-server [ <option> ... ]" << std::endl
+            << "Options:" << std::endl
+            << "[-h | --help]" << std::endl
+            << "  Show this help" << std::endl
+            << "[-a | --address]  <address>" << std::endl
+            << "  Address to listen on (default :: i.e. any)" << std::endl
+            << "[-p | --port]     <port>" << std::endl
+            << "  Port to listen on (default 32323)" << std::endl
+            << "[-s | --snapshot] <file>" << std::endl
+            << "  Load users and mailboxes from the file and save them there "
+               "on exit"
+            << std::endl
+            << "[-i | --snapshot-interval] <seconds>" << std::endl
+            << "  Save the snapshot also periodically" << std::endl;
+}
+
+/**
+ * @brief  Prints problem with server arguments and exits
+ * @param  problem: type of problem
+ * @retval None
+ */
+void serverProblem(const std::string problem) {
+  std::cerr << "Invalid " << problem
+            << " , see help {-h | --help} for more info." << std::endl;
+  exit(1);
+}
+
+/**
+ * @brief  Server main function
+ * @param  argc: number of strings pointed to by argv
+ * @param  **argv: array of arguments
+ * @retval 0
+ */
+int main(int argc, char **argv) {
+  std::string address{"::"};
+  bool is_v6{true};
+  int port{32323};
+  std::string snapshot;
+  int snapshot_interval{};
+
+  static struct option long_options[] = {
+      {"address", required_argument, 0, 'a'},
+      {"port", required_argument, 0, 'p'},
+      {"snapshot", required_argument, 0, 's'},
+      {"snapshot-interval", required_argument, 0, 'i'},
+      {"help", no_argument, 0, 'h'},
+      {0, 0, 0, 0}};
+
+  int c;
+  int option_index;
+  try {
+    while ((c = getopt_long(argc, argv, "a:p:s:i:h", long_options,
+                            &option_index)) != -1) {
+      switch (c) {
+      case 'a':
+        if (!ArgsParser::resolveAddress(optarg, address, is_v6)) {
+          serverProblem("address");
+        }
+        break;
+      case 'p':
+        port = std::stoi(optarg);
+        if (port <= 0 || port > 65535) {
+          serverProblem("port");
+        }
+        break;
+      case 's':
+        snapshot = optarg;
+        break;
+      case 'i':
+        snapshot_interval = std::stoi(optarg);
+        break;
+      case 'h':
+        printServerHelp();
+        exit(0);
+      default:
+        serverProblem("option");
+      }
+    }
+  } catch (const std::exception &) {
+    serverProblem("option value");
+  }
+
+  MailStore store;
+  if (!snapshot.empty() && !store.load(snapshot)) {
+    std::cerr << "Snapshot " << snapshot << " not loaded, starting empty"
+              << std::endl;
+  }
+
+  Server server(address, is_v6, port, store);
+  if (!snapshot.empty()) {
+    server.setSnapshot(snapshot, snapshot_interval);
+  }
+  server.run();
+
+  return 0;
+}
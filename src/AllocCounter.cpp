@@ -0,0 +1,43 @@
+#include "../include/AllocCounter.hpp"
+
+/* Trivial type, the thread local needs no initialization guard */
+static thread_local AllocCount counter{};
+
+bool AllocCounter::_enabled{false};
+
+/**
+ * @brief  Marks allocations as counted, called by the allocation hook
+ * @retval None
+ */
+void AllocCounter::enable() { _enabled = true; }
+
+/**
+ * @brief  Returns whether the allocation hook is linked in
+ * @retval True: allocations are counted | False: counts stay zero
+ */
+bool AllocCounter::isEnabled() { return _enabled; }
+
+/**
+ * @brief  Counts one allocation of the calling thread
+ * @param  size: number of bytes
+ * @retval None
+ */
+void AllocCounter::record(std::size_t size) {
+  counter.allocations++;
+  counter.bytes += size;
+}
+
+/**
+ * @brief  Returns allocations of the calling thread since it started
+ * @retval allocation count and bytes
+ */
+AllocCount AllocCounter::get() { return counter; }
+
+/**
+ * @brief  Returns allocations of the calling thread since the snapshot
+ * @param  &start: earlier snapshot of the same thread
+ * @retval allocation count and bytes
+ */
+AllocCount AllocCounter::since(const AllocCount &start) {
+  return {counter.allocations - start.allocations, counter.bytes - start.bytes};
+}
@@ -0,0 +1,108 @@
+#include "../include/AllocCounter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+/**
+ * @brief  Turns counting on before main runs
+ * @retval None
+ */
+static struct AllocHook {
+  AllocHook() { AllocCounter::enable(); }
+} hook;
+
+/**
+ * @brief  Allocates memory and counts the allocation, the new handler is
+ * called until the memory is available
+ * @param  size: number of bytes
+ * @retval allocated memory, nullptr when there is no new handler
+ */
+static void *allocate(std::size_t size) {
+  AllocCounter::record(size);
+  if (size == 0) {
+    size = 1;
+  }
+  while (true) {
+    void *memory = std::malloc(size);
+    if (memory) {
+      return memory;
+    }
+    std::new_handler handler = std::get_new_handler();
+    if (!handler) {
+      return nullptr;
+    }
+    handler();
+  }
+}
+
+/**
+ * @brief  Replaced global allocation function
+ * @param  size: number of bytes
+ * @retval allocated memory
+ */
+void *operator new(std::size_t size) {
+  void *memory = allocate(size);
+  if (!memory) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+/**
+ * @brief  Replaced global array allocation function
+ * @param  size: number of bytes
+ * @retval allocated memory
+ */
+void *operator new[](std::size_t size) { return operator new(size); }
+
+/**
+ * @brief  Replaced global allocation function not throwing on failure
+ * @param  size: number of bytes
+ * @retval allocated memory, nullptr on failure
+ */
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return allocate(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+/**
+ * @brief  Replaced global array allocation function not throwing on failure
+ * @param  size: number of bytes
+ * @retval allocated memory, nullptr on failure
+ */
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept {
+  return operator new(size, tag);
+}
+
+/**
+ * @brief  Replaced global deallocation function
+ * @param  *memory: memory allocated by operator new
+ * @retval None
+ */
+void operator delete(void *memory) noexcept { std::free(memory); }
+
+/**
+ * @brief  Replaced global array deallocation function
+ * @param  *memory: memory allocated by operator new[]
+ * @retval None
+ */
+void operator delete[](void *memory) noexcept { std::free(memory); }
+
+/**
+ * @brief  Replaced global sized deallocation function
+ * @param  *memory: memory allocated by operator new
+ * @retval None
+ */
+void operator delete(void *memory, std::size_t) noexcept { std::free(memory); }
+
+/**
+ * @brief  Replaced global sized array deallocation function
+ * @param  *memory: memory allocated by operator new[]
+ * @retval None
+ */
+void operator delete[](void *memory, std::size_t) noexcept {
+  std::free(memory);
+}
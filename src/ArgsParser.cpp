@@ -1,9 +1,12 @@
 #include "../include/ArgsParser.hpp"
+#include "../include/Stats.hpp"
+#include <algorithm>
 #include <arpa/inet.h>
 #include <cstring>
 #include <getopt.h>
 #include <netdb.h>
 #include <regex>
+#include <sstream>
 
 /**
  * @brief  Base64 string encoder
@@ -40,7 +43,7 @@ std::string ArgsParser::base64Encode(const std::string data) {
   size_t i;
   char *p = const_cast<char *>(ret.c_str());
 
-  for (i = 0; i < in_len - 2; i += 3) {
+  for (i = 0; in_len > 2 && i < in_len - 2; i += 3) {
     *p++ = sEncodingTable[(data[i] >> 2) & 0x3F];
     *p++ = sEncodingTable[((data[i] & 0x3) << 4) |
                           ((int)(data[i + 1] & 0xF0) >> 4)];
@@ -83,6 +86,15 @@ bool ArgsParser::isV6() const { return _is_v6; }
  */
 int ArgsParser::getPort() const { return _port; }
 
+/**
+ * @brief  Returns servers to communicate with, the server given by address
+ * and port when no endpoints were given
+ * @retval servers in the order given by the user
+ */
+const std::vector<Endpoint> &ArgsParser::getEndpoints() const {
+  return _endpoints;
+}
+
 /**
  * @brief  Returns command type
  * @retval command type
@@ -93,9 +105,38 @@ CommandType ArgsParser::getCommandType() const { return _command_type; }
  * @brief  Returns command arguments
  * @retval command arguments
  */
-std::map<CommandArg, std::string> ArgsParser::getCommandArgs() const {
-  return _command_args;
-}
+const CommandArgs &ArgsParser::getCommandArgs() const { return _command_args; }
+
+/**
+ * @brief  Returns whether the sent message is journaled in the outbox
+ * @retval True: message is journaled | False: message is only sent
+ */
+bool ArgsParser::useOutbox() const { return _outbox; }
+
+/**
+ * @brief  Returns whether pending messages of the outbox are sent again
+ * @retval True: outbox is resumed | False: command is processed
+ */
+bool ArgsParser::isResume() const { return _resume; }
+
+/**
+ * @brief  Returns user whose login token is used, empty when not given
+ * @retval username
+ */
+std::string ArgsParser::getUser() const { return _user; }
+
+/**
+ * @brief  Returns shared-memory ring receiving list and fetch output, empty
+ * when the output is written as text
+ * @retval name of the ring
+ */
+std::string ArgsParser::getRing() const { return _ring; }
+
+/**
+ * @brief  Returns whether the fetched message is added to the search index
+ * @retval True: message is indexed | False: message is only written out
+ */
+bool ArgsParser::useIndex() const { return _index; }
 
 /**
  * @brief Operator (<<) applied to an output stream
@@ -109,9 +150,10 @@ std::ostream &operator<<(std::ostream &os, const ArgsParser &ap) {
   os << "Address:" << ap.getAddress() << std::endl
      << "Port:" << ap.getPort() << std::endl
      << "Command:" << getCommandTypeEq(ap.getCommandType()) << std::endl;
-  for (auto &item : ap.getCommandArgs()) {
-    os << " + " << getCommandArgEq(item.first) << ":" << item.second
-       << std::endl;
+  auto &descriptor = describeCommand(ap.getCommandType());
+  for (size_t i = 0; i < descriptor.arity; i++) {
+    os << " + " << getCommandArgEq(descriptor.args[i]) << ":"
+       << ap.getCommandArgs()[descriptor.args[i]] << std::endl;
   }
   return os;
 }
@@ -122,23 +164,7 @@ std::ostream &operator<<(std::ostream &os, const ArgsParser &ap) {
  * @retval string value according to command type
  */
 std::string getCommandTypeEq(const CommandType command_type) {
-  switch (command_type) {
-  case (CommandType::REGISTER):
-    return "register";
-  case (CommandType::LOGIN):
-    return "login";
-  case (CommandType::LIST):
-    return "list";
-  case (CommandType::SEND):
-    return "send";
-  case (CommandType::FETCH):
-    return "fetch";
-  case (CommandType::LOGOUT):
-    return "logout";
-  default:
-    std::cerr << "Internal error occured :(" << std::endl;
-    exit(1);
-  }
+  return describeCommand(command_type).name;
 }
 
 /**
@@ -147,23 +173,7 @@ std::string getCommandTypeEq(const CommandType command_type) {
  * @retval string value according to command argument type
  */
 std::string getCommandArgEq(const CommandArg command_arg) {
-  switch (command_arg) {
-  case (CommandArg::USERNAME):
-    return "USERNAME";
-  case (CommandArg::PASSWORD):
-    return "PASSWORD";
-  case (CommandArg::RECIPIENT):
-    return "RECIPIENT";
-  case (CommandArg::SUBJECT):
-    return "SUBJECT";
-  case (CommandArg::BODY):
-    return "BODY";
-  case (CommandArg::ID):
-    return "ID";
-  default:
-    std::cerr << "Internal error occured :(" << std::endl;
-    exit(1);
-  }
+  return describeArg(command_arg).name;
 }
 
 /**
@@ -181,6 +191,37 @@ void ArgsParser::printHelp() {
             << std::endl
             << "[-p | --port]    <port>" << std::endl
             << "  Server port to connect to (default 32323)" << std::endl
+            << "[-e | --endpoints] <host[:port]>[,<host[:port]>...]"
+            << std::endl
+            << "  Servers holding parts of the mailbox, list is merged from "
+               "all of them"
+            << std::endl
+            << "  and fetch takes <endpoint>:<id> from the merged list, IPv6 "
+               "as [address]:port"
+            << std::endl
+            << "[--stats[=line|json]]" << std::endl
+            << "  Report per-phase timings, bytes and syscalls to stderr"
+            << std::endl
+            << "--outbox" << std::endl
+            << "  Journal the sent message until the server accepts it"
+            << std::endl
+            << "--resume" << std::endl
+            << "  Send journaled messages the server has not accepted, "
+               "given instead of a command"
+            << std::endl
+            << "--user <username>" << std::endl
+            << "  Use the login token of the user, needed when several users "
+               "are logged in"
+            << std::endl
+            << "--ring <name>" << std::endl
+            << "  Publish list entries and the fetched message into the "
+               "shared-memory ring"
+            << std::endl
+            << "  instead of writing them out, for readers on the same host"
+            << std::endl
+            << "--index" << std::endl
+            << "  Add the fetched message to the local index read by search"
+            << std::endl
             << "--" << std::endl
             << "Do not treat any remaining argument as a switch (at this level)"
             << std::endl
@@ -190,7 +231,12 @@ void ArgsParser::printHelp() {
             << " list" << std::endl
             << " send <recipient> <subject> <body>" << std::endl
             << " fetch <id>" << std::endl
-            << " logout" << std::endl;
+            << " logout" << std::endl
+            << " search <query>" << std::endl
+            << "  Search messages fetched with --index, words have to match "
+               "all, \"a phrase\""
+            << std::endl
+            << "  in order" << std::endl;
 }
 
 /**
@@ -254,6 +300,74 @@ bool ArgsParser::IPv6Check(const std::string address) {
   return true;
 }
 
+/**
+ * @brief  Resolves server hostname or address to the address to connect to
+ * @param  address: server hostname or address
+ * @param  &resolved: resolved address
+ * @param  &is_v6: IPv6 flag of the resolved address
+ * @retval True: address resolved | False: address could not be resolved
+ */
+bool ArgsParser::resolveAddress(const std::string address,
+                                std::string &resolved, bool &is_v6) {
+  if (address == "localhost") {
+    /* Default IPv6 localhost settings */
+    resolved = "::1";
+    is_v6 = true;
+    return true;
+  }
+  resolved = address;
+  if (!IPv4Check(resolved) && !IPv6Check(resolved)) {
+    struct hostent *host = gethostbyname(resolved.c_str());
+    if (host == NULL) {
+      return false;
+    }
+    resolved = inet_ntoa(*((struct in_addr *)(host->h_addr_list[0])));
+  }
+  is_v6 = !IPv4Check(resolved);
+  return true;
+}
+
+/**
+ * @brief  Parses and resolves the server given as host, host:port or
+ * [IPv6 address]:port
+ * @param  text: server given by the user
+ * @param  default_port: port used when the server has none
+ * @param  &endpoint: resolved server
+ * @retval True: server is valid | False: server is not valid
+ */
+bool ArgsParser::parseEndpoint(const std::string text, int default_port,
+                               Endpoint &endpoint) {
+  if (text.empty()) {
+    return false;
+  }
+  std::string host = text;
+  std::string port;
+  if (text[0] == '[') {
+    auto close = text.find(']');
+    if (close == std::string::npos ||
+        (close + 1 < text.size() && text[close + 1] != ':')) {
+      return false;
+    }
+    host = text.substr(1, close - 1);
+    port = close + 1 < text.size() ? text.substr(close + 2) : "";
+  } else if (std::count(text.begin(), text.end(), ':') == 1) {
+    /* More colons mean IPv6 address without port */
+    host = text.substr(0, text.find(':'));
+    port = text.substr(text.find(':') + 1);
+  }
+
+  endpoint.port = default_port;
+  if (!port.empty() || text.back() == ':') {
+    if (port.empty() || port.size() > 5 ||
+        port.find_first_not_of("0123456789") != std::string::npos) {
+      return false;
+    }
+    endpoint.port = std::stoi(port);
+  }
+  return !host.empty() && endpoint.port > 0 && endpoint.port <= 65535 &&
+         resolveAddress(host, endpoint.address, endpoint.is_v6);
+}
+
 /**
  * @brief  Checks if string is a number
  * @param  str: string to be checked
@@ -275,19 +389,29 @@ bool ArgsParser::isNumber(const std::string str) {
  * @retval constructed ArgsParser
  */
 ArgsParser::ArgsParser(int argc, char **argv) {
+  Stats &stats = Stats::instance();
+  uint64_t start = Stats::now();
   int c;
   char *arg_long{};
+  std::vector<std::string> endpoints;
 
   /* Process options */
   static struct option _long_options[] = {
       {"address", required_argument, 0, 'a'},
       {"port", required_argument, 0, 'p'},
       {"help", no_argument, 0, 'h'},
+      {"endpoints", required_argument, 0, 'e'},
+      {"stats", optional_argument, 0, 'S'},
+      {"outbox", no_argument, 0, 'O'},
+      {"resume", no_argument, 0, 'R'},
+      {"user", required_argument, 0, 'U'},
+      {"ring", required_argument, 0, 'G'},
+      {"index", no_argument, 0, 'I'},
       {0, 0, 0, 0}};
 
   int option_index;
-  while ((c = getopt_long(argc, argv, "a:p:h", _long_options, &option_index)) !=
-         -1) {
+  while ((c = getopt_long(argc, argv, "a:p:e:h", _long_options,
+                          &option_index)) != -1) {
     switch (c) {
 
     case 0: {
@@ -296,23 +420,10 @@ ArgsParser::ArgsParser(int argc, char **argv) {
     }
 
     case 'a': {
-      if (std::string(optarg) == "localhost") {
-        /* Default IPv6 localhost settings */
-        _address = "::1";
-        break;
-      }
-      _address = std::string(optarg);
-      if (!IPv4Check(_address) && !IPv6Check(_address)) {
-        if (gethostbyname(_address.c_str()) == NULL) {
-          printProblem("address", "");
-          exit(1);
-        }
-        _address =
-            inet_ntoa(*((struct in_addr *)(gethostbyname(_address.c_str())
-                                               ->h_addr_list[0])));
+      if (!resolveAddress(std::string(optarg), _address, _is_v6)) {
+        printProblem("address", "");
+        exit(1);
       }
-      if (IPv4Check(_address))
-        _is_v6 = false;
       break;
     }
     case 'p': {
@@ -331,6 +442,52 @@ ArgsParser::ArgsParser(int argc, char **argv) {
       printHelp();
       exit(0);
     }
+    case 'e': {
+      std::stringstream s_endpoints(optarg);
+      std::string endpoint;
+      while (std::getline(s_endpoints, endpoint, ',')) {
+        endpoints.push_back(endpoint);
+      }
+      break;
+    }
+    case 'S': {
+      if (optarg && std::string(optarg) != "json" &&
+          std::string(optarg) != "line") {
+        printProblem("stats format", std::string(optarg));
+        exit(1);
+      }
+      stats.enable(optarg && std::string(optarg) == "json");
+      break;
+    }
+    case 'O': {
+      _outbox = true;
+      break;
+    }
+    case 'R': {
+      _resume = true;
+      break;
+    }
+    case 'U': {
+      if (!*optarg) {
+        printProblem("user", "");
+        exit(1);
+      }
+      _user = optarg;
+      break;
+    }
+    case 'G': {
+      /* Ring is a shared memory object, its name has no slashes */
+      _ring = optarg;
+      if (_ring.empty() || _ring.find('/') != std::string::npos) {
+        printProblem("ring", _ring);
+        exit(1);
+      }
+      break;
+    }
+    case 'I': {
+      _index = true;
+      break;
+    }
     case '?': {
       printProblem("option", "");
       exit(1);
@@ -342,9 +499,45 @@ ArgsParser::ArgsParser(int argc, char **argv) {
     }
   }
 
+  /* Endpoints are resolved once the default port is known */
+  for (auto &text : endpoints) {
+    Endpoint endpoint;
+    if (!parseEndpoint(text, _port, endpoint)) {
+      printProblem("endpoint", text);
+      exit(1);
+    }
+    _endpoints.push_back(endpoint);
+  }
+  if (_endpoints.size() == 1) {
+    _address = _endpoints[0].address;
+    _is_v6 = _endpoints[0].is_v6;
+    _port = _endpoints[0].port;
+  } else if (_endpoints.empty()) {
+    _endpoints.push_back({_address, _is_v6, _port});
+  }
+
+  /* The outbox journals messages for one server */
+  if ((_outbox || _resume) && _endpoints.size() > 1) {
+    printProblem("option", "--outbox and --resume take one server");
+    exit(1);
+  }
+  if (!_ring.empty() && (_endpoints.size() > 1 || _resume)) {
+    printProblem("option", "--ring takes one server and a command");
+    exit(1);
+  }
+
   /* Process commands */
 
   int i = optind;
+  if (_resume) {
+    if (i < argc || _outbox) {
+      printProblem("arguments", "--resume is given instead of a command");
+      exit(1);
+    }
+    _command_type = CommandType::SEND;
+    stats.add(Phase::ARGS, start);
+    return;
+  }
   if (i >= argc) {
     printProblem("command", "");
     std::cerr << "client: expects <command> [<args>] ... on the command line, "
@@ -352,77 +545,37 @@ ArgsParser::ArgsParser(int argc, char **argv) {
               << std::endl;
     exit(1);
   }
-  while (i < argc) {
-    if (strcmp(argv[i], getCommandTypeEq(CommandType::REGISTER).c_str()) == 0) {
-      _command_type = CommandType::REGISTER;
-      if (i + 2 == argc - 1) {
-        ++i;
-        _command_args[CommandArg::USERNAME] = std::string(argv[i]);
-        ++i;
-        _command_args[CommandArg::PASSWORD] =
-            base64Encode(std::string(argv[i]));
-        ++i;
-        break;
-      } else {
-        printProblem("arguments", "");
-        exit(1);
-      }
-    }
-    if (strcmp(argv[i], getCommandTypeEq(CommandType::LOGIN).c_str()) == 0) {
-      _command_type = CommandType::LOGIN;
-      if (i + 2 == argc - 1) {
-        ++i;
-        _command_args[CommandArg::USERNAME] = std::string(argv[i]);
-        ++i;
-        _command_args[CommandArg::PASSWORD] =
-            base64Encode(std::string(argv[i]));
-        ++i;
-        break;
-      } else {
-        printProblem("arguments", "");
-        exit(1);
-      }
-    }
-    if (strcmp(argv[i], getCommandTypeEq(CommandType::LIST).c_str()) == 0) {
-      _command_type = CommandType::LIST;
-      ++i;
-      break;
-    }
-    if (strcmp(argv[i], getCommandTypeEq(CommandType::SEND).c_str()) == 0) {
-      _command_type = CommandType::SEND;
-      if (i + 3 == argc - 1) {
-        ++i;
-        _command_args[CommandArg::RECIPIENT] = std::string(argv[i]);
-        ++i;
-        _command_args[CommandArg::SUBJECT] = std::string(argv[i]);
-        ++i;
-        _command_args[CommandArg::BODY] = std::string(argv[i]);
-        ++i;
-        break;
-      } else {
-        printProblem("arguments", "");
-        exit(1);
-      }
-    }
-    if (strcmp(argv[i], getCommandTypeEq(CommandType::FETCH).c_str()) == 0) {
-      _command_type = CommandType::FETCH;
-      if (i + 1 == argc - 1) {
-        ++i;
-        _command_args[CommandArg::ID] = std::string(argv[i]);
-        ++i;
-        break;
-      } else {
-        printProblem("arguments", "");
-        exit(1);
-      }
-    }
-    if (strcmp(argv[i], getCommandTypeEq(CommandType::LOGOUT).c_str()) == 0) {
-      _command_type = CommandType::LOGOUT;
-      ++i;
-      break;
-    } else {
-      printProblem("command", std::string(argv[i]));
-      exit(1);
-    }
+  auto descriptor =
+      std::find_if(COMMANDS.begin(), COMMANDS.end(),
+                   [&](auto &item) { return strcmp(argv[i], item.name) == 0; });
+  if (descriptor == COMMANDS.end()) {
+    printProblem("command", std::string(argv[i]));
+    exit(1);
+  }
+  if (static_cast<size_t>(argc - i - 1) != descriptor->arity) {
+    printProblem("arguments", "");
+    exit(1);
   }
+  if (_outbox && descriptor->type != CommandType::SEND) {
+    printProblem("option", "--outbox is given with send");
+    exit(1);
+  }
+  if (_index && descriptor->type != CommandType::FETCH) {
+    printProblem("option", "--index is given with fetch");
+    exit(1);
+  }
+  if (!_ring.empty() && descriptor->response != ResponseShape::LIST &&
+      descriptor->response != ResponseShape::FETCH) {
+    printProblem("option", "--ring is given with list or fetch");
+    exit(1);
+  }
+  _command_type = descriptor->type;
+  for (size_t arg = 0; arg < descriptor->arity; arg++) {
+    CommandArg type = descriptor->args[arg];
+    std::string value(argv[i + 1 + arg]);
+    _command_args[type] =
+        describeArg(type).base64 ? base64Encode(value) : value;
+  }
+
+  stats.add(Phase::ARGS, start);
 }
\ No newline at end of file
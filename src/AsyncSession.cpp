@@ -0,0 +1,410 @@
+#include "../include/AsyncSession.hpp"
+#include "../include/CommunicationBase.hpp"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+/**
+ * @brief  AsyncSession constructor
+ * @param  &loop: event loop driving the session
+ * @param  address: server address
+ * @param  isV6: IPv6 flag
+ * @param  port: destination port
+ * @retval Constructed object
+ */
+AsyncSession::AsyncSession(EventLoop &loop, std::string address, bool isV6,
+                           int port)
+    : _loop(loop), _endpoint{address, isV6, port},
+      _secondary{address, isV6, port} {}
+
+/**
+ * @brief  Enum class to string 'converter' for statuses
+ * @param  status: status to be 'converted'
+ * @retval string value according to status
+ */
+const char *AsyncSession::getStatusName(AsyncStatus status) {
+  switch (status) {
+  case AsyncStatus::OK:
+    return "ok";
+  case AsyncStatus::SERVER_ERROR:
+    return "server error";
+  case AsyncStatus::FAILED:
+    return "failed";
+  case AsyncStatus::TIMEOUT:
+    return "timeout";
+  case AsyncStatus::CANCELLED:
+    return "cancelled";
+  default:
+    return "unknown";
+  }
+}
+
+/**
+ * @brief  Converts result of waiting on the socket to the command status
+ * @param  result: result of waiting
+ * @retval command status
+ */
+AsyncStatus AsyncSession::getWaitStatus(WaitResult result) {
+  switch (result) {
+  case WaitResult::READY:
+    return AsyncStatus::OK;
+  case WaitResult::TIMEOUT:
+    return AsyncStatus::TIMEOUT;
+  case WaitResult::CANCELLED:
+    return AsyncStatus::CANCELLED;
+  default:
+    return AsyncStatus::FAILED;
+  }
+}
+
+/**
+ * @brief  Sets time limit of every following command
+ * @param  timeout: time limit in milliseconds, 0 waits forever
+ * @retval None
+ */
+void AsyncSession::setTimeout(uint64_t timeout) { _timeout = timeout; }
+
+/**
+ * @brief  Enables hedging of list and fetch, a request still running after
+ * the delay of the policy is duplicated to the secondary endpoint
+ * @param  *hedge: hedge policy shared by sessions of the loop, nullptr
+ * disables hedging
+ * @param  secondary: endpoint of the duplicate request
+ * @retval None
+ */
+void AsyncSession::setHedge(HedgePolicy *hedge, const Endpoint secondary) {
+  _hedge = hedge;
+  _secondary = secondary;
+}
+
+/**
+ * @brief  Sets login token used by commands requiring it
+ * @param  token: login token in the form it is sent to the server
+ * @retval None
+ */
+void AsyncSession::setToken(const std::string token) { _token = token; }
+
+/**
+ * @brief  Returns login token of the session
+ * @retval login token, empty when logged out
+ */
+const std::string &AsyncSession::getToken() const { return _token; }
+
+/**
+ * @brief  Returns timestamps and counters of the last command
+ * @retval request timing
+ */
+const RequestTiming &AsyncSession::getTiming() const { return _timing; }
+
+/**
+ * @brief  Cancels the running command and all following ones, they finish
+ * with CANCELLED
+ * @retval None
+ */
+void AsyncSession::cancel() {
+  _cancelled = true;
+  if (_fd != -1) {
+    _loop.cancel(_fd);
+  }
+  if (_race) {
+    for (int socket : _race->sockets) {
+      if (socket != -1) {
+        _loop.cancel(socket);
+      }
+    }
+  }
+}
+
+/**
+ * @brief  Returns deadline of the command started now
+ * @retval monotonic deadline in nanoseconds, 0 when there is no time limit
+ */
+uint64_t AsyncSession::getDeadline() const {
+  return _timeout ? Stats::now() + _timeout * 1000000 : 0;
+}
+
+/**
+ * @brief  Sends the request within its own connection and receives the
+ * response, the coroutine is suspended whenever the socket is not ready
+ * @param  data: formatted request
+ * @param  endpoint: server to connect to
+ * @param  deadline: monotonic deadline in nanoseconds, 0 waits forever
+ * @param  &fd: socket of the connection while it is open, used to cancel it
+ * @param  &timing: timestamps and counters of the request
+ * @retval status and raw response of the server
+ */
+Task<AsyncResult<std::string>>
+AsyncSession::exchange(const std::string data, const Endpoint endpoint,
+                       uint64_t deadline, int &fd, RequestTiming &timing) {
+  AsyncResult<std::string> result;
+  if (_cancelled) {
+    result.status = AsyncStatus::CANCELLED;
+    co_return result;
+  }
+
+  CommunicationBase c(endpoint.address, endpoint.is_v6, endpoint.port);
+  bool connecting = c.startConnection();
+  fd = c.getSocket();
+
+  if (connecting) {
+    result.status = getWaitStatus(co_await _loop.wait(fd, EPOLLOUT, deadline));
+    if (result.ok() && !c.finishConnection()) {
+      result.status = AsyncStatus::FAILED;
+    }
+  }
+
+  size_t sent{};
+  while (result.ok() && !_cancelled) {
+    IoStatus io = c.sendSome(data, sent);
+    if (io != IoStatus::AGAIN) {
+      result.status = io == IoStatus::DONE ? AsyncStatus::OK
+                                           : AsyncStatus::FAILED;
+      break;
+    }
+    result.status =
+        getWaitStatus(co_await _loop.wait(fd, EPOLLOUT, deadline));
+  }
+
+  while (result.ok() && !_cancelled) {
+    IoStatus io = c.receiveSome(result.value);
+    if (io != IoStatus::AGAIN) {
+      result.status = io == IoStatus::DONE ? AsyncStatus::OK
+                                           : AsyncStatus::FAILED;
+      break;
+    }
+    result.status = getWaitStatus(co_await _loop.wait(fd, EPOLLIN, deadline));
+  }
+
+  /* Cancelled between two waits */
+  if (_cancelled && result.ok()) {
+    result.status = AsyncStatus::CANCELLED;
+  }
+  if (fd != -1) {
+    c.endConnection();
+  }
+  fd = -1;
+  timing = c.getTiming();
+  co_return result;
+}
+
+/**
+ * @brief  Runs one connection of the hedged request, the first successful
+ * one, or the last one when all fail, decides the request and cancels the
+ * other one
+ * @param  race: state of the hedged request
+ * @param  data: formatted request
+ * @param  deadline: monotonic deadline in nanoseconds, 0 waits forever
+ * @param  leg: 0 for the original request, 1 for the duplicate
+ * @retval None
+ */
+Task<> AsyncSession::runHedgeLeg(std::shared_ptr<HedgeRace> race,
+                                 const std::string data, uint64_t deadline,
+                                 int leg) {
+  RequestTiming timing{};
+  uint64_t start = Stats::now();
+  auto result = co_await exchange(data, leg ? _secondary : _endpoint, deadline,
+                                  race->sockets[leg], timing);
+  race->running--;
+  if (result.ok()) {
+    _hedge->recordLatency(Stats::now() - start);
+  }
+  if (race->winner != -1 || (!result.ok() && race->running > 0)) {
+    co_return;
+  }
+
+  race->winner = leg;
+  race->result = result;
+  race->timing = timing;
+  uint64_t one{1};
+  if (write(race->event, &one, sizeof(one)) == -1) {
+    race->result.status = AsyncStatus::FAILED;
+  }
+  int other = race->sockets[1 - leg];
+  if (other != -1) {
+    _loop.cancel(other);
+  }
+}
+
+/**
+ * @brief  Sends the read-only request and duplicates it when it is not
+ * answered within the delay of the hedge policy
+ * @param  data: formatted request
+ * @retval status and raw response of the server answering first
+ */
+Task<AsyncResult<std::string>>
+AsyncSession::hedgedExchange(const std::string data) {
+  uint64_t deadline = getDeadline();
+  auto race = std::make_shared<HedgeRace>();
+  race->event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (race->event == -1) {
+    co_return co_await exchange(data, _endpoint, deadline, _fd, _timing);
+  }
+  _race = race;
+
+  race->running = 1;
+  _loop.spawn(runHedgeLeg(race, data, deadline, 0));
+  co_await _loop.wait(race->event, EPOLLIN,
+                      Stats::now() + _hedge->getDelay());
+
+  bool hedged{false};
+  if (race->winner == -1 && !_cancelled &&
+      (!deadline || Stats::now() < deadline)) {
+    hedged = true;
+    race->running++;
+    _loop.spawn(runHedgeLeg(race, data, deadline, 1));
+  }
+  /* Both connections give up at the deadline, so the race always ends */
+  while (race->winner == -1) {
+    if (co_await _loop.wait(race->event, EPOLLIN) == WaitResult::FAILED) {
+      break;
+    }
+  }
+
+  close(race->event);
+  race->event = -1;
+  _race.reset();
+  _hedge->recordRequest(hedged, race->winner == 1);
+  if (race->winner == -1) {
+    AsyncResult<std::string> result;
+    co_return result;
+  }
+  _timing = race->timing;
+  co_return race->result;
+}
+
+/**
+ * @brief  Issues the command, the login token of the session is used and
+ * updated by login and logout, list and fetch are hedged when enabled
+ * @param  command: command type
+ * @param  command_args: command arguments, password has to be base64 encoded
+ * @retval status of the command with the raw server response
+ */
+Task<AsyncResult<std::string>>
+AsyncSession::request(CommandType command,
+                      CommandArgs command_args) {
+  std::string data = Client::getFormattedData(command, command_args, _token);
+  AsyncResult<std::string> result;
+  if (_hedge && describeCommand(command).read_only) {
+    result = co_await hedgedExchange(data);
+  } else {
+    result = co_await exchange(data, _endpoint, getDeadline(), _fd, _timing);
+  }
+  result.message = result.value;
+  if (!result.ok()) {
+    co_return result;
+  }
+
+  if (!Client::isMessageOk(result.message)) {
+    result.status = AsyncStatus::SERVER_ERROR;
+    result.message = Client::parseMessageContent(result.message);
+  } else if (describeCommand(command).session == SessionEffect::START) {
+    _token = decodeResponse<CommandType::LOGIN>(result.message);
+  } else if (describeCommand(command).session == SessionEffect::END) {
+    _token.clear();
+  }
+  co_return result;
+}
+
+/**
+ * @brief  Registers the user
+ * @param  username: name of the user
+ * @param  password: plain password of the user
+ * @retval status of the command with the text of the server response
+ */
+Task<AsyncResult<std::string>>
+AsyncSession::registerUser(const std::string username,
+                           const std::string password) {
+  CommandArgs command_args;
+  command_args[CommandArg::USERNAME] = username;
+  command_args[CommandArg::PASSWORD] = ArgsParser::base64Encode(password);
+  auto result = co_await request(CommandType::REGISTER, command_args);
+  if (result.ok()) {
+    result.value = decodeResponse<CommandType::REGISTER>(result.message);
+  }
+  co_return result;
+}
+
+/**
+ * @brief  Logs the user in, the session keeps the login token
+ * @param  username: name of the user
+ * @param  password: plain password of the user
+ * @retval status of the command with the login token
+ */
+Task<AsyncResult<std::string>>
+AsyncSession::login(const std::string username, const std::string password) {
+  CommandArgs command_args;
+  command_args[CommandArg::USERNAME] = username;
+  command_args[CommandArg::PASSWORD] = ArgsParser::base64Encode(password);
+  auto result = co_await request(CommandType::LOGIN, command_args);
+  if (result.ok()) {
+    result.value = _token;
+  }
+  co_return result;
+}
+
+/**
+ * @brief  Lists messages of the logged in user
+ * @retval status of the command with the list of messages
+ */
+Task<AsyncResult<std::vector<ListEntry>>> AsyncSession::list() {
+  auto response = co_await request(CommandType::LIST, CommandArgs());
+  AsyncResult<std::vector<ListEntry>> result;
+  result.status = response.status;
+  result.message = response.message;
+  if (result.ok()) {
+    result.value = decodeResponse<CommandType::LIST>(result.message);
+  }
+  co_return result;
+}
+
+/**
+ * @brief  Sends the message to the recipient
+ * @param  recipient: name of the recipient
+ * @param  subject: subject of the message
+ * @param  body: body of the message
+ * @retval status of the command with the text of the server response
+ */
+Task<AsyncResult<std::string>>
+AsyncSession::send(const std::string recipient, const std::string subject,
+                   const std::string body) {
+  CommandArgs command_args;
+  command_args[CommandArg::RECIPIENT] = recipient;
+  command_args[CommandArg::SUBJECT] = subject;
+  command_args[CommandArg::BODY] = body;
+  auto result = co_await request(CommandType::SEND, command_args);
+  if (result.ok()) {
+    result.value = decodeResponse<CommandType::SEND>(result.message);
+  }
+  co_return result;
+}
+
+/**
+ * @brief  Fetches the message of the logged in user
+ * @param  id: id of the message
+ * @retval status of the command with the fetched message
+ */
+Task<AsyncResult<FetchedMessage>> AsyncSession::fetch(const std::string id) {
+  CommandArgs command_args;
+  command_args[CommandArg::ID] = id;
+  auto response = co_await request(CommandType::FETCH, command_args);
+  AsyncResult<FetchedMessage> result;
+  result.status = response.status;
+  result.message = response.message;
+  if (result.ok()) {
+    result.value = decodeResponse<CommandType::FETCH>(result.message);
+  }
+  co_return result;
+}
+
+/**
+ * @brief  Logs the user out, the session forgets the login token
+ * @retval status of the command with the text of the server response
+ */
+Task<AsyncResult<std::string>> AsyncSession::logout() {
+  auto result = co_await request(CommandType::LOGOUT, CommandArgs());
+  if (result.ok()) {
+    result.value = decodeResponse<CommandType::LOGOUT>(result.message);
+  }
+  co_return result;
+}
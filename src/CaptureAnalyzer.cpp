@@ -0,0 +1,293 @@
+#include "../include/CaptureAnalyzer.hpp"
+#include "../include/ArgsParser.hpp"
+#include "../include/Client.hpp"
+#include "../include/PcapReader.hpp"
+
+#include <iomanip>
+#include <thread>
+
+const size_t FLOW_BATCH_SIZE = 64;
+const size_t BATCHES_PER_THREAD = 4;
+
+/**
+ * @brief  Escapes the string for use in JSON output
+ * @param  &value: string value
+ * @retval Escaped string without surrounding quotes
+ */
+static std::string jsonEscape(const std::string &value) {
+  std::string escaped;
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      escaped += ' ';
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+/**
+ * @brief  Adds statistics collected by another worker
+ * @param  &other: statistics to be merged in
+ * @retval None
+ */
+void CommandStats::merge(const CommandStats &other) {
+  requests += other.requests;
+  errors += other.errors;
+  unanswered += other.unanswered;
+  request_size.merge(other.request_size);
+  response_size.merge(other.response_size);
+  latency.merge(other.latency);
+  for (auto &item : other.error_messages) {
+    error_messages[item.first] += item.second;
+  }
+}
+
+/**
+ * @brief  CaptureAnalyzer constructor
+ * @param  port: server port in the capture
+ * @param  threads: number of worker threads
+ * @retval Constructed object
+ */
+CaptureAnalyzer::CaptureAnalyzer(uint16_t port, int threads)
+    : _port(port), _threads(threads > 0 ? threads : 1) {}
+
+/**
+ * @brief  Hands the batch of connections over to workers, waits while the
+ * workers are behind
+ * @param  &batch: finished connections, emptied
+ * @retval None
+ */
+void CaptureAnalyzer::enqueue(std::vector<TcpFlow> &batch) {
+  if (batch.empty()) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(_mutex);
+  _space.wait(lock, [this] {
+    return _batches.size() < BATCHES_PER_THREAD * _threads;
+  });
+  _batches.push_back(std::move(batch));
+  lock.unlock();
+  _ready.notify_one();
+  batch.clear();
+  batch.reserve(FLOW_BATCH_SIZE);
+}
+
+/**
+ * @brief  Analyzes batches of connections until the capture is read
+ * @param  &commands: statistics of this worker
+ * @retval None
+ */
+void CaptureAnalyzer::worker(std::map<std::string, CommandStats> &commands) {
+  while (true) {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _ready.wait(lock, [this] { return _done || !_batches.empty(); });
+    if (_batches.empty()) {
+      return;
+    }
+    std::vector<TcpFlow> batch = std::move(_batches.front());
+    _batches.pop_front();
+    lock.unlock();
+    _space.notify_one();
+
+    for (auto &flow : batch) {
+      analyzeFlow(flow, commands);
+    }
+  }
+}
+
+/**
+ * @brief  Returns command name of the request
+ * @param  &request: request data
+ * @retval command name, "unknown" for unsupported commands
+ */
+std::string CaptureAnalyzer::getCommand(const std::string &request) {
+  size_t end = request.find_first_of(" )", 1);
+  std::string name = request.substr(1, end == std::string::npos ? end : end - 1);
+  for (auto &command : COMMANDS) {
+    if (command.response != ResponseShape::LOCAL && command.name == name) {
+      return name;
+    }
+  }
+  return "unknown";
+}
+
+/**
+ * @brief  Pairs requests of the connection with responses and records them
+ * @param  &flow: finished connection
+ * @param  &commands: statistics of the worker
+ * @retval None
+ */
+void CaptureAnalyzer::analyzeFlow(
+    const TcpFlow &flow, std::map<std::string, CommandStats> &commands) {
+  std::vector<StreamMessage> requests = flow.request.messages();
+  std::vector<StreamMessage> responses = flow.response.messages();
+
+  for (size_t i = 0; i < requests.size(); i++) {
+    CommandStats &stats = commands[getCommand(requests[i].data)];
+    stats.requests++;
+    stats.request_size.record(requests[i].data.size());
+
+    if (i >= responses.size()) {
+      stats.unanswered++;
+      continue;
+    }
+    const StreamMessage &response = responses[i];
+    stats.response_size.record(response.data.size());
+    if (response.first_timestamp >= requests[i].last_timestamp) {
+      stats.latency.record(response.first_timestamp -
+                           requests[i].last_timestamp);
+    }
+    if (!Client::isMessageOk(response.data)) {
+      stats.errors++;
+      stats.error_messages[Client::parseMessageContent(response.data)]++;
+    }
+  }
+}
+
+/**
+ * @brief  Reads the capture and analyzes all connections to the server port
+ * @param  filename: pcap or pcapng file
+ * @retval True: capture was analyzed | False: capture could not be read
+ */
+bool CaptureAnalyzer::analyze(const std::string filename) {
+  PcapReader reader;
+  if (!reader.open(filename)) {
+    return false;
+  }
+
+  std::vector<std::map<std::string, CommandStats>> results(_threads);
+  std::vector<std::thread> workers;
+  for (int i = 0; i < _threads; i++) {
+    workers.emplace_back(&CaptureAnalyzer::worker, this, std::ref(results[i]));
+  }
+
+  /* Reassembly follows the capture order, decoding runs in the workers */
+  std::vector<TcpFlow> batch;
+  batch.reserve(FLOW_BATCH_SIZE);
+  TcpReassembler reassembler(_port, [this, &batch](TcpFlow &flow) {
+    _flows++;
+    batch.push_back(std::move(flow));
+    if (batch.size() >= FLOW_BATCH_SIZE) {
+      enqueue(batch);
+    }
+  });
+
+  CapturedPacket packet;
+  TcpSegment segment;
+  while (reader.next(packet)) {
+    _packets++;
+    if (PcapReader::decodeTcp(packet, segment)) {
+      _segments++;
+      reassembler.add(segment);
+    }
+  }
+  reassembler.flush();
+  enqueue(batch);
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _done = true;
+  }
+  _ready.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+
+  for (auto &result : results) {
+    for (auto &item : result) {
+      _commands[item.first].merge(item.second);
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief  Prints human readable report of the capture
+ * @param  &os: output stream
+ * @retval None
+ */
+void CaptureAnalyzer::printReport(std::ostream &os) const {
+  os << "packets: " << _packets << ", tcp segments: " << _segments
+     << ", connections: " << _flows << std::endl
+     << std::endl;
+
+  os << std::left << std::setw(10) << "command" << std::right
+     << std::setw(10) << "requests" << std::setw(8) << "errors"
+     << std::setw(8) << "err[%]" << std::setw(11) << "unanswered"
+     << std::setw(11) << "req p50[B]" << std::setw(12) << "resp p50[B]"
+     << std::setw(12) << "resp p99[B]" << std::setw(12) << "resp max[B]"
+     << std::setw(11) << "p50[ms]" << std::setw(11) << "p90[ms]"
+     << std::setw(11) << "p99[ms]" << std::setw(11) << "p99.9[ms]"
+     << std::endl;
+
+  for (auto &item : _commands) {
+    const CommandStats &stats = item.second;
+    os << std::left << std::setw(10) << item.first << std::right
+       << std::setw(10) << stats.requests << std::setw(8) << stats.errors
+       << std::fixed << std::setprecision(2) << std::setw(8)
+       << (stats.requests ? 100.0 * stats.errors / stats.requests : 0.0)
+       << std::setw(11) << stats.unanswered << std::setw(11)
+       << stats.request_size.percentile(50) << std::setw(12)
+       << stats.response_size.percentile(50) << std::setw(12)
+       << stats.response_size.percentile(99) << std::setw(12)
+       << stats.response_size.max() << std::setprecision(3) << std::setw(11)
+       << stats.latency.percentile(50) / 1e6 << std::setw(11)
+       << stats.latency.percentile(90) / 1e6 << std::setw(11)
+       << stats.latency.percentile(99) / 1e6 << std::setw(11)
+       << stats.latency.percentile(99.9) / 1e6 << std::endl;
+  }
+
+  os << std::endl << "errors:" << std::endl;
+  for (auto &item : _commands) {
+    for (auto &error : item.second.error_messages) {
+      os << "  " << item.first << ": " << error.first << " (" << error.second
+         << ")" << std::endl;
+    }
+  }
+}
+
+/**
+ * @brief  Writes the report in JSON format, latencies in microseconds
+ * @param  &os: output stream
+ * @retval None
+ */
+void CaptureAnalyzer::writeJson(std::ostream &os) const {
+  os << std::fixed << std::setprecision(3);
+  os << "{\"packets\":" << _packets << ",\"segments\":" << _segments
+     << ",\"connections\":" << _flows << ",\"commands\":{";
+  bool first{true};
+  for (auto &item : _commands) {
+    const CommandStats &stats = item.second;
+    if (!first) {
+      os << ",";
+    }
+    first = false;
+    os << "\"" << item.first << "\":{"
+       << "\"requests\":" << stats.requests << ",\"errors\":" << stats.errors
+       << ",\"unanswered\":" << stats.unanswered
+       << ",\"request_size_p50\":" << stats.request_size.percentile(50)
+       << ",\"request_size_max\":" << stats.request_size.max()
+       << ",\"response_size_p50\":" << stats.response_size.percentile(50)
+       << ",\"response_size_p99\":" << stats.response_size.percentile(99)
+       << ",\"response_size_max\":" << stats.response_size.max()
+       << ",\"latency_p50_us\":" << stats.latency.percentile(50) / 1e3
+       << ",\"latency_p90_us\":" << stats.latency.percentile(90) / 1e3
+       << ",\"latency_p99_us\":" << stats.latency.percentile(99) / 1e3
+       << ",\"latency_p999_us\":" << stats.latency.percentile(99.9) / 1e3
+       << ",\"error_messages\":{";
+    bool first_error{true};
+    for (auto &error : stats.error_messages) {
+      if (!first_error) {
+        os << ",";
+      }
+      first_error = false;
+      os << "\"" << jsonEscape(error.first) << "\":" << error.second;
+    }
+    os << "}}";
+  }
+  os << "}}" << std::endl;
+}
@@ -1,6 +1,8 @@
 #include "../include/Client.hpp"
 #include "../include/ArgsParser.hpp"
 #include "../include/CommunicationBase.hpp"
+#include "../include/MessageIndex.hpp"
+#include "../include/Stats.hpp"
 
 #include <cmath>
 #include <fstream>
@@ -10,124 +12,147 @@
 #include <string>
 #include <vector>
 
-const char *FILENAME = "login-token";
 const int OK_HEADER_LENGTH = 3;
 const int ERR_HEADER_LENGTH = 4;
 
 /**
- * @brief  Extracts login token from the server message and saves it to a file
- * @param  message: message from the server
+ * @brief  Opens the token store shared by all users of the directory
+ * @param  &store: token store
  * @retval None
  */
-void Client::saveTokenToFile(std::string message) {
-  std::string login_token = message.substr(0, message.find(")"));
+void Client::openTokenStore(TokenStore &store) {
+  if (!store.open()) {
+    std::cerr << "ERR: Login tokens could not be opened :(" << std::endl;
+    exit(1);
+  }
+}
 
-  std::ofstream file(FILENAME);
-  if (!file.is_open()) {
-    std::cerr << "ERR: Login token could not be saved :(" << std::endl;
+/**
+ * @brief  Finds the user the command is issued as, the one logging in, the
+ * one given by --user or the only one logged in to the server
+ * @param  &store: token store
+ * @param  &server: name of the server
+ * @param  &args: parsed program arguments
+ * @param  &user: username
+ * @retval True: user is known | False: nobody is logged in to the server
+ */
+bool Client::findUser(TokenStore &store, const std::string &server,
+                      const ArgsParser &args, std::string &user) {
+  if (args.getCommandType() == CommandType::LOGIN) {
+    user = args.getCommandArgs()[CommandArg::USERNAME];
+    return true;
+  }
+  if (!args.getUser().empty()) {
+    user = args.getUser();
+    return true;
+  }
+  auto users = store.getUsers(server);
+  if (users.size() > 1) {
+    std::cerr << "ERR: Several users are logged in to " << server
+              << ", choose one with --user :(" << std::endl;
     exit(1);
   }
-  file << login_token;
-  file.close();
+  if (users.empty()) {
+    return false;
+  }
+  user = users[0];
+  return true;
 }
 
 /**
- * @brief  Loads login token from file
+ * @brief  Loads login token of the user from the token store
+ * @param  &store: token store
+ * @param  &server: name of the server
+ * @param  &args: parsed program arguments
  * @retval Login token
  */
-std::string Client::getToken() {
+std::string Client::getToken(TokenStore &store, const std::string &server,
+                             const ArgsParser &args) {
+  std::string user;
   std::string login_token;
-  std::ifstream file(FILENAME);
-  if (file.is_open()) {
-    while (getline(file, login_token)) {
-      ;
-    }
-    file.close();
-    return login_token;
-  } else {
+  if (!findUser(store, server, args, user) ||
+      !store.get(server, user, login_token)) {
     std::cerr << "ERR: Login token could not be obtained :(" << std::endl;
     exit(1);
   }
+  return login_token;
 }
 
 /**
- * @brief  Finds a substring in the string and replaces it with another
- * @param  data: string data to be modified
- * @param  to_replace: substring that is searched for and replaced
- * @param  replace_by: substring with which we replace
- * @retval String data with replaced substrings
+ * @brief  Updates the token store after the server accepted the command,
+ * login stores the token of the user and logout removes it
+ * @param  &store: token store
+ * @param  &server: name of the server
+ * @param  &args: parsed program arguments
+ * @param  message: message data from the server
+ * @retval None
  */
-std::string Client::findReplace(std::string data, std::string to_replace,
-                                std::string replace_by) {
-  size_t position = data.find(to_replace);
-  while (position != std::string::npos) {
-    data.replace(position, to_replace.size(), replace_by);
-    position = data.find(to_replace, position + replace_by.size());
+void Client::updateSession(TokenStore &store, const std::string &server,
+                           const ArgsParser &args, std::string_view message) {
+  if (!isMessageOk(message)) {
+    return;
   }
-  return data;
+  visitCommand(args.getCommandType(), [&](auto type) {
+    constexpr CommandDescriptor descriptor =
+        describeCommand(decltype(type)::value);
+    if constexpr (descriptor.session != SessionEffect::NONE) {
+      std::string user;
+      if (!findUser(store, server, args, user)) {
+        return;
+      }
+      if constexpr (descriptor.session == SessionEffect::START) {
+        /* Session is issued already, the output is printed anyway */
+        if (!store.put(server, user, parseLoginToken(message))) {
+          std::cerr << "ERR: Login token could not be saved :(" << std::endl;
+        }
+      } else {
+        store.remove(server, user);
+      }
+    }
+  });
 }
 
 /**
- * @brief  Escapes special characters in the string given
- * @param  data: string in which the characters will be escaped
- * @retval String data with escaped characters
+ * @brief  Identifies whether the command requires the login token
+ * @param  command: command type
+ * @retval True: token is sent with the command | False: command is tokenless
  */
-std::string Client::escapeData(std::string data) {
-  data = findReplace(data, "\\", "\\\\");
-  data = findReplace(data, "\"", "\\\"");
-  data = findReplace(data, "\\\\n", "\\n");
-  return data;
+bool Client::needsToken(const CommandType command) {
+  return describeCommand(command).token;
 }
 
 /**
- * @brief  Reverts escaping of special characters in the string given
- * @param  data: string in which the characters will be un-escaped
- * @retval String data with un-escaped characters
+ * @brief  Formats data to be sent to the server according to the command
+ * descriptor
+ * @param  command: command type
+ * @param  &command_args: command arguments
+ * @param  token: login token used by the commands that require it
+ * @retval Formatted data
  */
-std::string Client::unEscapeData(std::string data) {
-  data = findReplace(data, "\\\\", "\\");
-  data = findReplace(data, "\\\"", "\"");
+std::string Client::getFormattedData(CommandType command,
+                                     const CommandArgs &command_args,
+                                     const std::string &token) {
+  std::string data;
+  getFormattedData(command, command_args, token, data);
   return data;
 }
 
 /**
- * @brief  Formats data to be sent to the server according to the command type
+ * @brief  Formats data to be sent to the server into the buffer, its memory
+ * is reused by the next command
  * @param  command: command type
- * @param  command_args: command arguments
- * @retval Formatted data
+ * @param  &command_args: command arguments
+ * @param  &token: login token used by the commands that require it
+ * @param  &data: formatted data
+ * @retval None
  */
-std::string
-Client::getFormattedData(CommandType command,
-                         std::map<CommandArg, std::string> command_args) {
-
-  std::string data = "(" + getCommandTypeEq(command);
-
-  /* Sorting and processing by type of teh command */
-  switch (command) {
-  case CommandType::LIST:
-  case CommandType::SEND:
-  case CommandType::FETCH:
-  case CommandType::LOGOUT:
-    data = data + " " + getToken();
-    break;
-
-  default:
-    break;
-  }
-
-  /* Assembling the data */
-  for (auto m : command_args) {
-    if (command == CommandType::FETCH) {
-      data = data + " " + m.second;
-      data = data + ")";
-      return data;
-    }
-    m.second = escapeData(m.second);
-    data = data + " \"" + m.second + "\"";
-  }
-  data = data + ")";
-
-  return data;
+void Client::getFormattedData(CommandType command,
+                              const CommandArgs &command_args,
+                              const std::string &token, std::string &data) {
+  visitCommand(command, [&](auto type) {
+    constexpr CommandType C = decltype(type)::value;
+    encodeCommand<C>(getRequest<C>(command_args), token, data);
+  });
 }
 
 /**
@@ -135,240 +160,272 @@ Client::getFormattedData(CommandType command,
  * @param  message: message data from the server
  * @retval True: message status is ok | False: message status is not ok
  */
-bool Client::isMessageOk(const std::string message) {
-  int position = message.find("(ok ");
-  return position == 0;
+bool Client::isMessageOk(std::string_view message) {
+  return message.substr(0, 4) == "(ok ";
 }
 
 /**
- * @brief  Cuts off the header containing the message status from the server
- * @param  message: message data to be modified
- * @retval Message data without the header
+ * @brief  Identifies whether the server rejected the command
+ * @param  message: message data from the server
+ * @retval True: message status is err | False: message status is not err
  */
-std::string Client::cutOffHeader(std::string message) {
-  if (isMessageOk(message)) {
-    return message.substr(OK_HEADER_LENGTH, message.size() - 1);
-  } else {
-    return message.substr(ERR_HEADER_LENGTH, message.size() - 1);
-  }
+bool Client::isMessageErr(std::string_view message) {
+  return message.substr(0, 5) == "(err ";
 }
 
 /**
- * @brief  Extracts the text of the message from the server data
+ * @brief  Moves behind the next quoted string of the message
  * @param  message: message data from the server
- * @retval Server message content without header and brackets
+ * @param  &position: position in the data, moved behind the string
+ * @retval True: string was skipped | False: there is no complete string
  */
-std::string Client::cutOutServerMessageContent(std::string message) {
-
-  message = cutOffHeader(message);
-  message = cutOffQuotesWrapping(message);
-
-  return message;
+bool Client::skipString(std::string_view message, size_t &position) {
+  position = message.find('"', position);
+  if (position == std::string_view::npos) {
+    return false;
+  }
+  for (position++; position < message.size(); position++) {
+    if (message[position] == '\\') {
+      position++;
+    } else if (message[position] == '"') {
+      position++;
+      return true;
+    }
+  }
+  return false;
 }
 
 /**
- * @brief  Splits the message data by the char given
- * @param  message: message data to be sliced
- * @param  cut_by: char according to which the message data will be sliced
- * @retval Vector of splitted substrings
+ * @brief  Reads the next quoted string of the message and reverts escaping of
+ * special characters, memory of the value is reused
+ * @param  message: message data from the server
+ * @param  &position: position in the data, moved behind the string
+ * @param  &value: un-escaped string
+ * @param  newlines: True: \n becomes a newline | False: \n stays written out
+ * @retval True: string was read | False: there is no complete string
  */
-std::vector<std::string> Client::splitByChar(std::string message, char cut_by) {
-  std::vector<std::string> container;
-  /* Construct stream from the message */
-  std::stringstream s_msg(message);
-  std::string piece;
-
-  /* Sequential division and addition to the container */
-  while (std::getline(s_msg, piece, cut_by)) {
-    container.push_back(piece);
+bool Client::readString(std::string_view message, size_t &position,
+                        std::string &value, bool newlines) {
+  value.clear();
+  position = message.find('"', position);
+  if (position == std::string_view::npos) {
+    return false;
   }
+  for (position++; position < message.size(); position++) {
+    char c = message[position];
+    if (c == '"') {
+      position++;
+      return true;
+    }
+    if (c == '\\' && position + 1 < message.size()) {
+      c = message[++position];
+      if (c == 'n' && newlines) {
+        value += '\n';
+      } else if (c == '\\' || c == '"') {
+        value += c;
+      } else {
+        value += '\\';
+        value += c;
+      }
+    } else {
+      value += c;
+    }
+  }
+  return false;
+}
 
-  return container;
+/**
+ * @brief  Extracts the text of the message from the server message
+ * @param  message: message data from the server
+ * @param  &content: un-escaped server message content
+ * @retval None
+ */
+void Client::parseMessageContent(std::string_view message,
+                                 std::string &content) {
+  size_t position{};
+  readString(message, position, content, false);
 }
 
 /**
- * @brief  Splits the message data by the substring given
- * @param  message: message data to be sliced
- * @param  cut_by: substring according to which the message data will be sliced
- * @retval Vector of splitted substrings
+ * @brief  Extracts the text of the message from the server message
+ * @param  message: message data from the server
+ * @retval Un-escaped server message content
  */
-std::vector<std::string> Client::splitByString(std::string message,
-                                               std::string cut_by) {
-  std::string piece;
-  std::vector<std::string> container;
-  while (message.find(cut_by) != std::string::npos) {
-    int k = 1;
-
-    /* Detection of splitting by new rows and k constant modification */
-    if (cut_by == "\\n") {
-      k = 0;
-    }
+std::string Client::parseMessageContent(std::string_view message) {
+  std::string content;
+  parseMessageContent(message, content);
+  return content;
+}
 
-    /* Sequential division and addition to the container */
-    piece = message.substr(0, message.find(cut_by) + k);
-    container.push_back(piece);
-    message =
-        message.substr(message.find(cut_by) +
-                           floor(static_cast<double>(cut_by.size()) / 2) + 1,
-                       message.size());
+/**
+ * @brief  Extracts login token from the server message of the login type
+ * @param  message: message data from the server
+ * @param  &token: login token in the form it is sent back to the server
+ * @retval None
+ */
+void Client::parseLoginToken(std::string_view message, std::string &token) {
+  size_t position{};
+  token.clear();
+  if (!skipString(message, position)) {
+    return;
+  }
+  size_t start = message.find('"', position);
+  position = start;
+  if (skipString(message, position)) {
+    token.assign(message.substr(start, position - start));
   }
-  /* Last piece */
-  piece = message.substr(0, message.size());
-  container.push_back(piece);
-
-  return container;
 }
 
 /**
- * @brief  Removes first left round bracket
- * @param  message: message data to be modified
- * @retval Message data without first left round bracket
+ * @brief  Extracts login token from the server message of the login type
+ * @param  message: message data from the server
+ * @retval Login token in the form it is sent back to the server
  */
-std::string Client::cutOffFirstLeftBracket(std::string message) {
-  if (message.find_first_of("(") != std::string::npos)
-    return message.substr(message.find_first_of("(") + 1, message.size());
-
-  return message;
+std::string Client::parseLoginToken(std::string_view message) {
+  std::string token;
+  parseLoginToken(message, token);
+  return token;
 }
 
 /**
- * @brief  Removes last right round bracket
- * @param  message: message data to be modified
- * @retval Message data without last right round bracket
+ * @brief  Breaks down the server message of the list type into items, items
+ * already in the vector are overwritten so their memory is reused
+ * @param  message: message data from the server
+ * @param  &entries: listed items
+ * @retval None
  */
-std::string Client::cutOffLastRightBracket(std::string message) {
-  if (message.find_first_of(")") != std::string::npos)
-    return message.substr(0, message.find_last_of(")"));
-
-  return message;
+void Client::parseList(std::string_view message,
+                       std::vector<ListEntry> &entries) {
+  size_t count{};
+  /* Items are lists within the list following the header */
+  size_t position = message.find('(', 1);
+  while (position != std::string_view::npos) {
+    position = message.find_first_of("()", position + 1);
+    if (position == std::string_view::npos || message[position] == ')') {
+      break;
+    }
+    size_t id_start = message.find_first_not_of(' ', position + 1);
+    size_t id_end = message.find_first_of(" )", id_start);
+    if (id_end == std::string_view::npos) {
+      break;
+    }
+    if (count == entries.size()) {
+      entries.emplace_back();
+    }
+    ListEntry &entry = entries[count];
+    entry.id.assign(message.substr(id_start, id_end - id_start));
+    if (!readString(message, id_end, entry.sender, false) ||
+        !readString(message, id_end, entry.subject, false)) {
+      break;
+    }
+    count++;
+    position = message.find(')', id_end);
+  }
+  entries.resize(count);
 }
 
 /**
- * @brief  Removes status of server message and first layer of brackets
- * @param  message: message data to be modified
- * @retval Message data without first layer of brackets and header
+ * @brief  Breaks down the server message of the list type into items
+ * @param  message: message data from the server
+ * @retval Vector of listed items
  */
-std::string Client::cutOffPrimaryWrapping(std::string message) {
-  message = cutOffHeader(message);
-  message = cutOffLastRightBracket(message);
-
-  return message;
+std::vector<ListEntry> Client::parseList(std::string_view message) {
+  std::vector<ListEntry> entries;
+  parseList(message, entries);
+  return entries;
 }
 
 /**
- * @brief  Removes one layer of external brackets
- * @param  message: message data to be modified
- * @retval Message data without one layer of external brackets
+ * @brief  Writes to the output message of the list type
+ * @param  message: message data to be printed
+ * @param  &os: output stream
+ * @retval None
  */
-std::string Client::cutOffBracketWrapping(std::string message) {
-  message = cutOffFirstLeftBracket(message);
-  message = cutOffLastRightBracket(message);
-
-  return message;
+void Client::printList(std::string_view message, std::ostream &os) {
+  os << std::endl;
+  for (auto &entry : parseList(message)) {
+    os << entry.id << ": " << std::endl;
+    os << "  From: " << entry.sender << std::endl;
+    os << "  Subject: " << entry.subject << std::endl;
+  }
 }
 
 /**
- * @brief  Removes external quotes
- * @param  message: message data to be modified
- * @retval Message data without qoutes wrapping
+ * @brief  Breaks down the server message of the fetch type, memory of the
+ * fields is reused
+ * @param  message: message data from the server
+ * @param  &fetched: sender, subject and body of the fetched message
+ * @retval None
  */
-std::string Client::cutOffQuotesWrapping(std::string message) {
-  if (message.find("\"") != std::string::npos) {
-    message = message.substr(message.find_first_of("\"") + 1, message.size());
-    message = message.substr(0, message.find_last_of("\""));
-  }
+void Client::parseFetch(std::string_view message, FetchedMessage &fetched) {
+  /* A missing field leaves the following ones empty */
+  size_t position{};
+  readString(message, position, fetched.sender, false);
+  readString(message, position, fetched.subject, false);
+  readString(message, position, fetched.body, true);
+}
 
-  return message;
+/**
+ * @brief  Breaks down the server message of the fetch type
+ * @param  message: message data from the server
+ * @retval Sender, subject and body of the fetched message
+ */
+FetchedMessage Client::parseFetch(std::string_view message) {
+  FetchedMessage fetched;
+  parseFetch(message, fetched);
+  return fetched;
 }
 
 /**
- * @brief  Processes and write out login message & calls for token processing
- * @param  message: message data
+ * @brief  Writes to the output message of the fetch type
+ * @param  message: message data to be printed
+ * @param  &os: output stream
  * @retval None
  */
-void Client::processLogin(std::string message) {
-  message = cutOffHeader(message);
-  std::vector<std::string> container = splitByString(message, "\" \"");
-  std::cout << cutOffQuotesWrapping(unEscapeData(container[0])) << std::endl;
-  saveTokenToFile(container[1]);
+void Client::printFetch(std::string_view message, std::ostream &os) {
+  FetchedMessage fetched = parseFetch(message);
+
+  os << std::endl << std::endl;
+  os << "From: " << fetched.sender << std::endl;
+  os << "Subject: " << fetched.subject << std::endl;
+  os << std::endl << fetched.body;
 }
 
 /**
- * @brief  Processes and writes to the output message of the list type
- * @param  message: message data to be printed
+ * @brief  Adds the fetched message to the local search index, the fields are
+ * the ones printFetch writes out
+ * @param  server: name of the server the message was fetched from
+ * @param  id: id of the message on the server
+ * @param  message: message data from the server
  * @retval None
  */
-void Client::printList(std::string message) {
-  std::cout << std::endl;
-  /* Breakdown into individual items */
-  std::vector<std::string> container = splitByString(message, ") (");
-
-  /* Processing of individual items */
-  for (auto item : container) {
-    item = cutOffBracketWrapping(item);
-    /* Extraction of item number */
-    std::string number = item.substr(0, item.find_first_of(" "));
-    item = item.substr(item.find_first_of(" ") + 1, item.size() - 1);
-    if (item.empty()) {
-      return;
-    }
-    std::cout << number << ": " << std::endl;
-    /* Distribution and listing of sender and subject */
-    std::vector<std::string> i_container = splitByString(item, "\" \"");
-    int cnt{};
-    for (auto p : i_container) {
-      if (p != " " && !p.empty()) {
-        cnt++;
-        if (cnt == 1) {
-          std::cout << "  From: ";
-        } else if (cnt == 2) {
-          std::cout << "  Subject: ";
-        } else {
-          break;
-        }
-        std::cout << unEscapeData(cutOffQuotesWrapping(p)) << std::endl;
-      }
-    }
+void Client::indexFetch(const std::string &server, const std::string &id,
+                        std::string_view message) {
+  MessageIndex index(INDEX_FILENAME);
+  if (!index.add(server, id, parseFetch(message))) {
+    std::cerr << "Message " << id << " not indexed, search will miss it"
+              << std::endl;
   }
 }
 
 /**
- * @brief  Processes and writes to the output message of the fetch type
- * @param  message: message data to be printed
+ * @brief  Writes to the output fetched messages matching the query, answered
+ * from the local index without contacting the server
+ * @param  query: words and "phrases" which all have to match
+ * @param  &os: output stream
  * @retval None
  */
-void Client::printFetch(std::string message) {
-
-  std::cout << std::endl << std::endl;
-
-  /* Distribution and listing of sender and subject */
-  std::vector<std::string> container = splitByString(message, "\" \"");
-  int cnt{};
-  for (auto item : container) {
-    cnt++;
-    if (cnt == 1) {
-      std::cout << "From: ";
-    } else if (cnt == 2) {
-      std::cout << "Subject: ";
-    } else if (cnt == 3) {
-      std::cout << std::endl;
-      item = (cutOffQuotesWrapping(item));
-      std::vector<std::string> i_container = splitByString(item, "\\n");
-
-      for (auto p : i_container) {
-        std::cout << unEscapeData(p);
-        if (p != i_container.back()) {
-          std::cout << std::endl;
-        }
-      }
-    } else {
-      break;
-    }
-
-    if (cnt != 3) {
-      std::cout << unEscapeData(cutOffQuotesWrapping(item));
-      std::cout << std::endl;
-    }
+void Client::printSearch(const std::string &query, std::ostream &os) {
+  if (MessageIndex::parseQuery(query).empty()) {
+    std::cerr << "ERR: Search query has no words :(" << std::endl;
+    exit(1);
+  }
+  MessageIndex index(INDEX_FILENAME);
+  os << "SUCCESS: " << std::endl;
+  for (auto &message : index.search(query)) {
+    os << message.server << " " << message.id << ": " << std::endl;
+    os << "  From: " << message.sender << std::endl;
+    os << "  Subject: " << message.subject << std::endl;
   }
 }
 
@@ -377,39 +434,170 @@ void Client::printFetch(std::string message) {
  * content
  * @param  command: type of the message
  * @param  message: message data to be processed
+ * @param  &os: output stream
+ * @param  *outbox: journal of the sent message, nullptr when not journaled
+ * @param  entry: position of the sent message in the journal
  * @retval None
  */
 void Client::processServerMessage(const CommandType command,
-                                  std::string message) {
-  if (isMessageOk(message)) {
-    std::cout << "SUCCESS: ";
-    switch (command) {
-    case CommandType::REGISTER:
-    case CommandType::SEND:
-      std::cout << unEscapeData(cutOutServerMessageContent(message))
-                << std::endl;
-      break;
-    case CommandType::LOGIN:
-      processLogin(message);
-      break;
-    case CommandType::LIST:
-      printList(cutOffBracketWrapping(cutOffPrimaryWrapping(message)));
-      break;
-    case CommandType::FETCH:
-      printFetch(cutOffBracketWrapping(cutOffPrimaryWrapping(message)));
-      break;
-    case CommandType::LOGOUT:
-      std::cout << unEscapeData(cutOutServerMessageContent(message))
-                << std::endl;
-      std::remove(FILENAME);
-      break;
+                                  const std::string &message,
+                                  std::ostream &os, Outbox *outbox,
+                                  OutboxRef entry) {
+  /* Answered message is not sent again by --resume, only a lost request or
+   * response keeps it pending */
+  if (outbox && (isMessageOk(message) || isMessageErr(message))) {
+    outbox->acknowledge(entry, isMessageOk(message));
+  }
+  if (!isMessageOk(message)) {
+    os << "ERROR: " << parseMessageContent(message) << std::endl;
+    return;
+  }
+  os << "SUCCESS: ";
+  visitCommand(command, [&](auto type) {
+    constexpr CommandDescriptor descriptor =
+        describeCommand(decltype(type)::value);
+    /* Token of the login response is kept by updateSession */
+    if constexpr (descriptor.response == ResponseShape::LOGIN) {
+      os << parseMessageContent(message) << std::endl;
+    } else if constexpr (descriptor.response == ResponseShape::LIST) {
+      printList(message, os);
+    } else if constexpr (descriptor.response == ResponseShape::FETCH) {
+      printFetch(message, os);
+    } else if constexpr (descriptor.response == ResponseShape::TEXT) {
+      os << decodeResponse<descriptor.type>(message) << std::endl;
+    }
+  });
+}
 
-    default:
-      break;
+/**
+ * @brief  Publishes one record into the ring, exits when the reader does not
+ * take it
+ * @param  &ring: output ring
+ * @param  type: type of the record
+ * @param  ok: the command succeeded
+ * @param  (&fields): id, sender, subject and body
+ * @retval None
+ */
+void Client::publishRecord(RingWriter &ring, RingRecordType type, bool ok,
+                           const std::string_view (&fields)[RING_FIELDS]) {
+  if (!ring.write(type, ok, fields)) {
+    std::cerr << "ERR: Output ring is full and nobody reads it :("
+              << std::endl;
+    exit(1);
+  }
+}
+
+/**
+ * @brief  Publishes parsed list entries or the fetched message into the
+ * shared-memory ring instead of formatting them, the output ends with an END
+ * record carrying the error of a failed command
+ * @param  &ring: output ring opened before the request
+ * @param  &args: parsed program arguments
+ * @param  &message: message data from the server
+ * @param  &os: output stream for errors
+ * @retval None
+ */
+void Client::publishServerMessage(RingWriter &ring, const ArgsParser &args,
+                                  const std::string &message,
+                                  std::ostream &os) {
+  if (!ring.lock()) {
+    std::cerr << "ERR: Output ring could not be locked :(" << std::endl;
+    exit(1);
+  }
+
+  bool ok = isMessageOk(message);
+  std::string error;
+  if (!ok) {
+    error = parseMessageContent(message);
+    os << "ERROR: " << error << std::endl;
+  } else if (describeCommand(args.getCommandType()).response ==
+             ResponseShape::LIST) {
+    for (auto &entry : parseList(message)) {
+      publishRecord(ring, RingRecordType::LIST_ENTRY, true,
+                    {entry.id, entry.sender, entry.subject, {}});
     }
   } else {
-    std::cout << "ERROR: " << unEscapeData(cutOutServerMessageContent(message))
+    FetchedMessage fetched = parseFetch(message);
+    publishRecord(ring, RingRecordType::FETCH, true,
+                  {args.getCommandArgs()[CommandArg::ID], fetched.sender,
+                   fetched.subject, fetched.body});
+  }
+  publishRecord(ring, RingRecordType::END, ok, {{}, {}, {}, error});
+  ring.flush();
+}
+
+/**
+ * @brief  Sends messages of the outbox the server has not accepted yet, one
+ * resume runs at a time, the journal is locked only while it is read and
+ * compacted so that other sends append meanwhile
+ * @param  &args: parsed program arguments
+ * @retval None
+ */
+void Client::resumeOutbox(const ArgsParser &args) {
+  Stats &stats = Stats::instance();
+  Outbox outbox(OUTBOX_FILENAME);
+  if (!outbox.open()) {
+    std::cerr << "ERR: Outbox could not be opened :(" << std::endl;
+    exit(1);
+  }
+  if (!outbox.lockResume()) {
+    std::cerr << "ERR: Outbox is being resumed by another process :("
               << std::endl;
+    exit(1);
+  }
+
+  /* Messages are sent again as the user who sent them first */
+  uint64_t start = Stats::now();
+  std::string server =
+      getEndpointName({args.getAddress(), args.isV6(), args.getPort()});
+  TokenStore store(TOKEN_STORE_FILENAME);
+  openTokenStore(store);
+  std::string user;
+  std::string token;
+  if (!findUser(store, server, args, user) ||
+      !store.get(server, user, token)) {
+    std::cerr << "ERR: Login token could not be obtained :(" << std::endl;
+    exit(1);
+  }
+  stats.add(Phase::TOKEN, start);
+  if (!outbox.lock(true)) {
+    std::cerr << "ERR: Outbox could not be locked :(" << std::endl;
+    exit(1);
+  }
+  auto entries = outbox.getPending(server, user);
+  outbox.unlock();
+
+  CommunicationBase c(args.getAddress(), args.isV6(), args.getPort());
+  CommandArgs command_args;
+  std::string data;
+  std::string message;
+  for (auto &entry : entries) {
+    start = Stats::now();
+    command_args[CommandArg::RECIPIENT] = entry.recipient;
+    command_args[CommandArg::SUBJECT] = entry.subject;
+    command_args[CommandArg::BODY] = entry.body;
+    getFormattedData(CommandType::SEND, command_args, token, data);
+    stats.add(Phase::ENCODE, start);
+
+    c.setConnection();
+    c.communicate(data, message);
+    c.endConnection();
+    stats.addRequest(c.getTiming());
+
+    start = Stats::now();
+    processServerMessage(CommandType::SEND, message, std::cout, &outbox,
+                         entry.ref);
+    stats.add(Phase::OUTPUT, start);
+  }
+
+  bool compacted = outbox.lock(true) && outbox.compact();
+  outbox.unlock();
+  if (!compacted) {
+    std::cerr << "ERR: Outbox could not be written :(" << std::endl;
+    exit(1);
+  }
+  if (stats.isEnabled()) {
+    stats.print(std::cerr);
   }
 }
 
@@ -418,11 +606,104 @@ void Client::processServerMessage(const CommandType command,
  * @param  args: parsed program arguments
  * @retval Client
  */
-Client::Client(ArgsParser args) {
+Client::Client(const ArgsParser &args) {
+  Stats &stats = Stats::instance();
+  uint64_t start = Stats::now();
+
+  if (args.getCommandType() == CommandType::SEARCH) {
+    std::ostringstream output;
+    printSearch(args.getCommandArgs()[CommandArg::QUERY], output);
+    stats.add(Phase::PARSE, start);
+
+    start = Stats::now();
+    std::cout << output.str() << std::flush;
+    stats.add(Phase::OUTPUT, start);
+
+    if (stats.isEnabled()) {
+      stats.print(std::cerr);
+    }
+    return;
+  }
+
+  if (args.isResume()) {
+    resumeOutbox(args);
+    return;
+  }
+
+  std::string server =
+      getEndpointName({args.getAddress(), args.isV6(), args.getPort()});
+  TokenStore store(TOKEN_STORE_FILENAME);
+  std::string token;
+  if (needsToken(args.getCommandType()) ||
+      describeCommand(args.getCommandType()).session != SessionEffect::NONE) {
+    openTokenStore(store);
+  }
+  if (needsToken(args.getCommandType())) {
+    token = getToken(store, server, args);
+    stats.add(Phase::TOKEN, start);
+  }
+
+  /* Message is on the disk before it leaves */
+  Outbox outbox(OUTBOX_FILENAME);
+  OutboxRef entry{};
+  if (args.useOutbox()) {
+    start = Stats::now();
+    std::string user;
+    findUser(store, server, args, user);
+    if (!outbox.open() ||
+        !outbox.append(server, user, args.getCommandArgs(), entry)) {
+      std::cerr << "ERR: Message could not be journaled :(" << std::endl;
+      exit(1);
+    }
+    stats.add(Phase::ENCODE, start);
+  }
+
+  /* Ring is checked before the server is asked */
+  RingWriter ring;
+  if (!args.getRing().empty() && !ring.open(args.getRing())) {
+    std::cerr << "ERR: Output ring could not be opened :(" << std::endl;
+    exit(1);
+  }
+
+  start = Stats::now();
+  auto data =
+      getFormattedData(args.getCommandType(), args.getCommandArgs(), token);
+  stats.add(Phase::ENCODE, start);
+
   CommunicationBase c(args.getAddress(), args.isV6(), args.getPort());
   c.setConnection();
-  auto message = c.communicate(
-      getFormattedData(args.getCommandType(), args.getCommandArgs()));
-  processServerMessage(args.getCommandType(), message);
+  auto message = c.communicate(data);
   c.endConnection();
-}
\ No newline at end of file
+  stats.addRequest(c.getTiming());
+
+  /* Output is assembled first so that parsing and writing are told apart */
+  start = Stats::now();
+  std::ostringstream output;
+  if (!args.getRing().empty()) {
+    publishServerMessage(ring, args, message, output);
+  } else {
+    processServerMessage(args.getCommandType(), message, output,
+                         args.useOutbox() ? &outbox : nullptr, entry);
+  }
+  /* Journal is emptied once nothing in it waits for an answer */
+  if (args.useOutbox()) {
+    bool compacted = outbox.lock(true) && outbox.compact();
+    outbox.unlock();
+    if (!compacted) {
+      std::cerr << "ERR: Outbox could not be written :(" << std::endl;
+    }
+  }
+  updateSession(store, server, args, message);
+  if (args.useIndex() && isMessageOk(message)) {
+    indexFetch(server, args.getCommandArgs()[CommandArg::ID], message);
+  }
+  stats.add(Phase::PARSE, start);
+
+  start = Stats::now();
+  std::cout << output.str() << std::flush;
+  stats.add(Phase::OUTPUT, start);
+
+  if (stats.isEnabled()) {
+    stats.print(std::cerr);
+  }
+}
@@ -1,5 +1,6 @@
 #include "../include/CommunicationBase.hpp"
 #include <arpa/inet.h>
+#include <cerrno>
 #include <iostream>
 #include <netdb.h>
 #include <netinet/in.h>
@@ -7,6 +8,19 @@
 #include <strings.h>
 #include <sys/socket.h>
 #include <unistd.h>
+#include <utility>
+
+/**
+ * @brief  Returns name of the server used in the output and the local files
+ * @param  &endpoint: server
+ * @retval address:port, IPv6 address in brackets
+ */
+std::string getEndpointName(const Endpoint &endpoint) {
+  if (endpoint.is_v6) {
+    return "[" + endpoint.address + "]:" + std::to_string(endpoint.port);
+  }
+  return endpoint.address + ":" + std::to_string(endpoint.port);
+}
 
 /**
  * @brief  CommunicationBase class constructor
@@ -19,20 +33,27 @@ CommunicationBase::CommunicationBase(std::string address, bool isV6, int port)
     : _address(address), _is_v6(isV6), _port(port) {}
 
 /**
- * @brief  Create socket for communication with the server
- * @retval None
+ * @brief  CommunicationBase move constructor, the socket goes to the new
+ * object
+ * @param  &&other: moved object
+ * @retval Constructed object
  */
-void CommunicationBase::createSocket() {
-
-  if (_is_v6) {
-    _sockfd = socket(AF_INET6, SOCK_STREAM, IPPROTO_TCP);
-  } else {
-    _sockfd = socket(AF_INET, SOCK_STREAM, 0);
-  }
+CommunicationBase::CommunicationBase(CommunicationBase &&other) noexcept
+    : _address(std::move(other._address)), _is_v6(other._is_v6),
+      _port(other._port), _sockfd(other._sockfd),
+      _server_address(other._server_address),
+      _server6_address(other._server6_address), _timing(other._timing) {
+  other._sockfd = -1;
+}
 
-  if (_sockfd == -1) {
-    std::cerr << "ERR: Unable to create socket :(" << std::endl;
-    exit(1);
+/**
+ * @brief  CommunicationBase destructor, closes the socket left open when
+ * the request did not get to endConnection
+ * @retval None
+ */
+CommunicationBase::~CommunicationBase() {
+  if (_sockfd != -1) {
+    close(_sockfd);
   }
 }
 
@@ -54,23 +75,39 @@ void CommunicationBase::sinAssign() {
 }
 
 /**
- * @brief  Creates connection to the server
- * @retval None
+ * @brief  Completely arranges the connection to the server, errors are
+ * reported instead of exiting
+ * @retval True: connected | False: socket could not be created or connecting
+ * failed, the socket is -1 when it could not be created
  */
-void CommunicationBase::connectToServer() {
+bool CommunicationBase::tryConnection() {
+  _timing = RequestTiming();
+  _timing.connect_start = Stats::now();
+
+  if (_sockfd != -1) {
+    close(_sockfd);
+  }
   if (_is_v6) {
-    if (connect(_sockfd, (struct sockaddr *)&_server6_address,
-                sizeof(_server6_address)) < 0) {
-      std::cerr << "ERR: Unable to connect to server :(" << std::endl;
-      exit(1);
-    }
+    _sockfd = socket(AF_INET6, SOCK_STREAM, IPPROTO_TCP);
   } else {
-    if (connect(_sockfd, (struct sockaddr *)&_server_address,
-                sizeof(_server_address)) < 0) {
-      std::cerr << "ERR: Unable to connect to server :(" << std::endl;
-      exit(1);
-    }
+    _sockfd = socket(AF_INET, SOCK_STREAM, 0);
   }
+  if (_sockfd == -1) {
+    return false;
+  }
+  sinAssign();
+
+  int result;
+  if (_is_v6) {
+    result = connect(_sockfd, (struct sockaddr *)&_server6_address,
+                     sizeof(_server6_address));
+  } else {
+    result = connect(_sockfd, (struct sockaddr *)&_server_address,
+                     sizeof(_server_address));
+  }
+  _timing.connect_end = Stats::now();
+  _timing.syscalls += 2;
+  return result == 0;
 }
 
 /**
@@ -78,44 +115,250 @@ void CommunicationBase::connectToServer() {
  * @retval None
  */
 void CommunicationBase::setConnection() {
-  createSocket();
-  sinAssign();
-  connectToServer();
+  if (!tryConnection()) {
+    if (_sockfd == -1) {
+      std::cerr << "ERR: Unable to create socket :(" << std::endl;
+    } else {
+      std::cerr << "ERR: Unable to connect to server :(" << std::endl;
+    }
+    exit(1);
+  }
 }
 
 /**
  * @brief  Provides communication with the server within the connection
- * @param  data: message to be send to the sevrer
- * @retval message from the server
+ * into the buffer, its memory is reused by the next request, errors are
+ * reported instead of exiting
+ * @param  &data: message to be send to the sevrer
+ * @param  &message: message from the server
+ * @retval True: response is received | False: sending or receiving failed,
+ * sending is finished when the send end time is set
  */
-std::string CommunicationBase::communicate(std::string data) {
+bool CommunicationBase::tryCommunicate(const std::string &data,
+                                       std::string &message) {
   char buffer[4096];
 
   /* Send message */
-  auto comm = write(_sockfd, data.c_str(), data.size());
-  if (comm == -1) {
-    std::cerr << "ERR: Unable to send data to server :(" << std::endl;
-    exit(1);
+  _timing.send_start = Stats::now();
+  ssize_t comm{};
+  size_t sent{};
+  message.clear();
+  while (sent < data.size()) {
+    comm = write(_sockfd, data.c_str() + sent, data.size() - sent);
+    _timing.syscalls++;
+    if (comm == -1 && errno == EINTR) {
+      continue;
+    }
+    if (comm == -1) {
+      return false;
+    }
+    sent += comm;
   }
+  _timing.send_end = Stats::now();
+  _timing.bytes_sent += sent;
 
-  /* Receive message */
-  long unsigned int tmp_size{};
-  std::string message;
+  /* Receive message until the server closes the connection */
   while (true) {
-    bzero(&buffer, sizeof(buffer));
     comm = read(_sockfd, buffer, sizeof(buffer));
-    message = message + std::string(buffer);
-    if (tmp_size == message.size()) {
+    _timing.syscalls++;
+    if (comm == -1 && errno == EINTR) {
+      continue;
+    }
+    if (comm <= 0) {
       break;
     }
-    tmp_size = message.size();
+    if (message.empty()) {
+      _timing.first_byte = Stats::now();
+    }
+    message.append(buffer, comm);
   }
+  _timing.last_byte = Stats::now();
+  _timing.bytes_received += message.size();
+  return comm != -1;
+}
 
-  if (comm == -1) {
-    std::cerr << "ERR: Unable to process data from server :(" << std::endl;
+/**
+ * @brief  Provides communication with the server within the connection
+ * into the buffer, its memory is reused by the next request
+ * @param  &data: message to be send to the sevrer
+ * @param  &message: message from the server
+ * @retval None
+ */
+void CommunicationBase::communicate(const std::string &data,
+                                    std::string &message) {
+  if (!tryCommunicate(data, message)) {
+    if (!_timing.send_end) {
+      std::cerr << "ERR: Unable to send data to server :(" << std::endl;
+    } else {
+      std::cerr << "ERR: Unable to process data from server :(" << std::endl;
+    }
     exit(1);
   }
+}
+
+/**
+ * @brief  Provides communication with the server within the connection
+ * @param  data: message to be send to the sevrer
+ * @retval message from the server
+ */
+std::string CommunicationBase::communicate(std::string data) {
+  std::string message;
+  communicate(data, message);
   return message;
 }
 
-void CommunicationBase::endConnection() { close(_sockfd); }
+/**
+ * @brief  Closes the connection to the server
+ * @retval None
+ */
+void CommunicationBase::endConnection() {
+  if (_sockfd == -1) {
+    return;
+  }
+  close(_sockfd);
+  _sockfd = -1;
+  _timing.syscalls++;
+}
+
+/**
+ * @brief  Returns timestamps and counters of the last request
+ * @retval request timing
+ */
+const RequestTiming &CommunicationBase::getTiming() const { return _timing; }
+
+/**
+ * @brief  Creates non-blocking socket and starts connecting to the server,
+ * errors are reported instead of exiting
+ * @retval True: connection is being established | False: connecting failed
+ */
+bool CommunicationBase::startConnection() {
+  _timing = RequestTiming();
+  _timing.connect_start = Stats::now();
+
+  if (_sockfd != -1) {
+    close(_sockfd);
+  }
+  _sockfd = socket(_is_v6 ? AF_INET6 : AF_INET, SOCK_STREAM | SOCK_NONBLOCK,
+                   IPPROTO_TCP);
+  _timing.syscalls++;
+  if (_sockfd == -1) {
+    return false;
+  }
+  sinAssign();
+
+  int result;
+  if (_is_v6) {
+    result = connect(_sockfd, (struct sockaddr *)&_server6_address,
+                     sizeof(_server6_address));
+  } else {
+    result = connect(_sockfd, (struct sockaddr *)&_server_address,
+                     sizeof(_server_address));
+  }
+  _timing.syscalls++;
+  return result == 0 || errno == EINPROGRESS;
+}
+
+/**
+ * @brief  Checks result of the connection started by startConnection, call
+ * when the socket is writable
+ * @retval True: connected | False: connecting failed
+ */
+bool CommunicationBase::finishConnection() {
+  int error{};
+  socklen_t length = sizeof(error);
+  int result = getsockopt(_sockfd, SOL_SOCKET, SO_ERROR, &error, &length);
+  _timing.syscalls++;
+  _timing.connect_end = Stats::now();
+  return result == 0 && error == 0;
+}
+
+/**
+ * @brief  Sends as much of the message as the non-blocking socket accepts
+ * @param  &data: message to be send to the server
+ * @param  &sent: number of bytes already sent, updated
+ * @retval DONE: whole message is sent | AGAIN: wait until the socket is
+ * writable | FAILED: sending failed
+ */
+IoStatus CommunicationBase::sendSome(const std::string &data, size_t &sent) {
+  if (!_timing.send_start) {
+    _timing.send_start = Stats::now();
+  }
+  while (sent < data.size()) {
+    ssize_t comm = write(_sockfd, data.c_str() + sent, data.size() - sent);
+    _timing.syscalls++;
+    if (comm == -1 && errno == EINTR) {
+      continue;
+    }
+    if (comm == -1) {
+      return errno == EAGAIN || errno == EWOULDBLOCK ? IoStatus::AGAIN
+                                                     : IoStatus::FAILED;
+    }
+    sent += comm;
+    _timing.bytes_sent += comm;
+  }
+  _timing.send_end = Stats::now();
+  return IoStatus::DONE;
+}
+
+/**
+ * @brief  Reads what is available on the non-blocking socket
+ * @param  &message: message from the server, received data are appended
+ * @retval DONE: server closed the connection | AGAIN: wait until the socket
+ * is readable | FAILED: receiving failed
+ */
+IoStatus CommunicationBase::receiveSome(std::string &message) {
+  char buffer[4096];
+  while (true) {
+    ssize_t comm = read(_sockfd, buffer, sizeof(buffer));
+    _timing.syscalls++;
+    if (comm == -1 && errno == EINTR) {
+      continue;
+    }
+    if (comm == -1) {
+      return errno == EAGAIN || errno == EWOULDBLOCK ? IoStatus::AGAIN
+                                                     : IoStatus::FAILED;
+    }
+    if (comm == 0) {
+      _timing.last_byte = Stats::now();
+      return IoStatus::DONE;
+    }
+    if (!_timing.first_byte) {
+      _timing.first_byte = Stats::now();
+    }
+    message.append(buffer, comm);
+    _timing.bytes_received += comm;
+  }
+}
+
+/**
+ * @brief  Returns socket of the connection
+ * @retval socket descriptor
+ */
+int CommunicationBase::getSocket() const { return _sockfd; }
+
+/**
+ * @brief  Takes over the socket connected elsewhere, the request starts
+ * without connecting
+ * @param  fd: connected blocking socket
+ * @param  connect_start: time the socket was asked for, connecting ends now
+ * @retval None
+ */
+void CommunicationBase::adoptSocket(int fd, uint64_t connect_start) {
+  if (_sockfd != -1) {
+    close(_sockfd);
+  }
+  _sockfd = fd;
+  _timing = RequestTiming();
+  _timing.connect_start = connect_start;
+  _timing.connect_end = Stats::now();
+}
+
+/**
+ * @brief  Gives up the socket without closing it
+ * @retval socket descriptor, -1 when there is none
+ */
+int CommunicationBase::releaseSocket() {
+  int fd = _sockfd;
+  _sockfd = -1;
+  return fd;
+}
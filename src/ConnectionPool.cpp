@@ -0,0 +1,352 @@
+#include "../include/ConnectionPool.hpp"
+#include "../include/Stats.hpp"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <functional>
+#include <netinet/in.h>
+#include <poll.h>
+#include <thread>
+#include <tuple>
+#include <unistd.h>
+
+/**
+ * @brief  Compares endpoints by address, family and port
+ * @param  &a: first endpoint
+ * @param  &b: second endpoint
+ * @retval True: a goes before b | False: otherwise
+ */
+bool EndpointLess::operator()(const Endpoint &a, const Endpoint &b) const {
+  return std::tie(a.address, a.is_v6, a.port) <
+         std::tie(b.address, b.is_v6, b.port);
+}
+
+/**
+ * @brief  ConnectionPool constructor
+ * @param  max_per_endpoint: sockets of one endpoint, idle and handed out
+ * @param  idle_timeout: time in nanoseconds an idle socket is kept
+ * @retval Constructed object
+ */
+ConnectionPool::ConnectionPool(size_t max_per_endpoint, uint64_t idle_timeout)
+    : _max_per_endpoint(max_per_endpoint), _idle_timeout(idle_timeout) {}
+
+/**
+ * @brief  ConnectionPool destructor, closes idle sockets, sockets handed out
+ * are closed by their connections
+ * @retval None
+ */
+ConnectionPool::~ConnectionPool() {
+  for (auto &item : _pools) {
+    for (auto &shard : item.second->shards) {
+      for (auto &socket : shard.idle) {
+        close(socket.fd);
+      }
+    }
+  }
+}
+
+/**
+ * @brief  Returns free list the calling thread starts at, threads spread
+ * over the free lists so that they rarely take the same lock
+ * @retval index of the free list
+ */
+size_t ConnectionPool::getHomeShard() {
+  static thread_local size_t shard =
+      std::hash<std::thread::id>()(std::this_thread::get_id()) % SHARDS;
+  return shard;
+}
+
+/**
+ * @brief  Creates non-blocking socket and starts connecting to the endpoint
+ * @param  &pool: sockets of the endpoint
+ * @retval socket descriptor | -1: connecting failed
+ */
+int ConnectionPool::startSocket(const EndpointPool &pool) {
+  int fd = socket(pool.address.ss_family, SOCK_STREAM | SOCK_NONBLOCK,
+                  IPPROTO_TCP);
+  if (fd == -1) {
+    return -1;
+  }
+  if (connect(fd, reinterpret_cast<const sockaddr *>(&pool.address),
+              pool.address_length) < 0 &&
+      errno != EINPROGRESS) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/**
+ * @brief  Checks that the socket is connected and the server has not closed
+ * it, waits for connecting in progress and makes the socket blocking
+ * @param  fd: socket
+ * @retval True: socket is ready for the request | False: socket is unusable
+ */
+bool ConnectionPool::checkSocket(int fd) {
+  struct pollfd poll_fd = {fd, POLLOUT | POLLIN | POLLRDHUP, 0};
+  if (poll(&poll_fd, 1, CONNECT_WAIT) <= 0) {
+    return false;
+  }
+  /* The server does not write before the request, readable means closed */
+  if (poll_fd.revents & (POLLIN | POLLRDHUP | POLLERR | POLLHUP)) {
+    return false;
+  }
+
+  int error{};
+  socklen_t length = sizeof(error);
+  if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == -1 || error) {
+    return false;
+  }
+  int flags = fcntl(fd, F_GETFL);
+  return flags != -1 && fcntl(fd, F_SETFL, flags & ~O_NONBLOCK) != -1;
+}
+
+/**
+ * @brief  Returns sockets of the endpoint, they are created on first use
+ * @param  &endpoint: server
+ * @retval sockets of the endpoint
+ */
+ConnectionPool::EndpointPool &
+ConnectionPool::getPool(const Endpoint &endpoint) {
+  {
+    std::shared_lock<std::shared_mutex> lock(_mutex);
+    auto pool = _pools.find(endpoint);
+    if (pool != _pools.end()) {
+      return *pool->second;
+    }
+  }
+
+  std::unique_lock<std::shared_mutex> lock(_mutex);
+  auto &pool = _pools[endpoint];
+  if (!pool) {
+    pool.reset(new EndpointPool());
+    if (endpoint.is_v6) {
+      auto *address = reinterpret_cast<sockaddr_in6 *>(&pool->address);
+      address->sin6_family = AF_INET6;
+      address->sin6_port = htons(endpoint.port);
+      inet_pton(AF_INET6, endpoint.address.c_str(), &address->sin6_addr);
+      pool->address_length = sizeof(sockaddr_in6);
+    } else {
+      auto *address = reinterpret_cast<sockaddr_in *>(&pool->address);
+      address->sin_family = AF_INET;
+      address->sin_port = htons(endpoint.port);
+      address->sin_addr.s_addr = inet_addr(endpoint.address.c_str());
+      pool->address_length = sizeof(sockaddr_in);
+    }
+  }
+  return *pool;
+}
+
+/**
+ * @brief  Takes idle socket, the free list of the thread is searched first
+ * and busy free lists of other threads are skipped
+ * @param  &pool: sockets of the endpoint
+ * @param  &socket: taken socket
+ * @retval True: socket is taken | False: no idle socket
+ */
+bool ConnectionPool::popIdle(EndpointPool &pool, PooledSocket &socket) {
+  if (!pool.idle.load()) {
+    return false;
+  }
+  size_t home = getHomeShard();
+  for (size_t i = 0; i < SHARDS; i++) {
+    Shard &shard = pool.shards[(home + i) % SHARDS];
+    std::unique_lock<std::mutex> lock(shard.mutex, std::defer_lock);
+    if (i == 0) {
+      lock.lock();
+    } else if (!lock.try_lock()) {
+      continue;
+    }
+    if (!shard.idle.empty()) {
+      socket = shard.idle.back();
+      shard.idle.pop_back();
+      pool.idle--;
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief  Puts socket to the free list of the thread, the idle count changes
+ * under the lock of the free list so that popIdle never takes it below zero
+ * @param  &pool: sockets of the endpoint
+ * @param  fd: socket, its place within the cap is kept
+ * @retval None
+ */
+void ConnectionPool::pushIdle(EndpointPool &pool, int fd) {
+  Shard &shard = pool.shards[getHomeShard()];
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.idle.push_back({fd, Stats::now()});
+    pool.idle++;
+  }
+  notify(pool);
+}
+
+/**
+ * @brief  Takes place for a new socket within the cap of the endpoint
+ * @param  &pool: sockets of the endpoint
+ * @retval True: place is taken | False: endpoint is at its cap
+ */
+bool ConnectionPool::reserve(EndpointPool &pool) {
+  size_t open = pool.open.load();
+  while (open < _max_per_endpoint) {
+    if (pool.open.compare_exchange_weak(open, open + 1)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief  Gives back place of the closed socket
+ * @param  &pool: sockets of the endpoint
+ * @retval None
+ */
+void ConnectionPool::free(EndpointPool &pool) {
+  pool.open--;
+  notify(pool);
+}
+
+/**
+ * @brief  Wakes threads waiting for a socket of the endpoint, the lock is
+ * only taken when some thread waits
+ * @param  &pool: sockets of the endpoint
+ * @retval None
+ */
+void ConnectionPool::notify(EndpointPool &pool) {
+  if (pool.waiting.load()) {
+    { std::lock_guard<std::mutex> lock(pool.wait_mutex); }
+    pool.released.notify_all();
+  }
+}
+
+/**
+ * @brief  Hands connected socket of the endpoint to the connection, idle
+ * socket is checked before it is used and a new one is connected when there
+ * is none, waits while the endpoint is at its cap
+ * @param  &endpoint: server
+ * @param  &connection: connection taking the socket
+ * @retval True: connection is ready | False: connecting failed
+ */
+bool ConnectionPool::acquire(const Endpoint &endpoint,
+                             CommunicationBase &connection) {
+  uint64_t start = Stats::now();
+  EndpointPool &pool = getPool(endpoint);
+  PooledSocket socket;
+  while (true) {
+    while (popIdle(pool, socket)) {
+      if (Stats::now() - socket.since <= _idle_timeout &&
+          checkSocket(socket.fd)) {
+        _hits.fetch_add(1, std::memory_order_relaxed);
+        connection.adoptSocket(socket.fd, start);
+        return true;
+      }
+      close(socket.fd);
+      _discarded.fetch_add(1, std::memory_order_relaxed);
+      free(pool);
+    }
+
+    if (reserve(pool)) {
+      _misses.fetch_add(1, std::memory_order_relaxed);
+      int fd = startSocket(pool);
+      if (fd == -1 || !checkSocket(fd)) {
+        if (fd != -1) {
+          close(fd);
+        }
+        free(pool);
+        return false;
+      }
+      connection.adoptSocket(fd, start);
+      return true;
+    }
+
+    /* Endpoint is at its cap until some socket is released */
+    _waits.fetch_add(1, std::memory_order_relaxed);
+    pool.waiting++;
+    {
+      std::unique_lock<std::mutex> lock(pool.wait_mutex);
+      pool.released.wait(lock, [&] {
+        return pool.idle.load() || pool.open.load() < _max_per_endpoint;
+      });
+    }
+    pool.waiting--;
+  }
+}
+
+/**
+ * @brief  Closes the used socket of the connection and starts connecting
+ * the spare one, the handshake runs while the worker handles the response,
+ * one release per half of the idle timeout reaps stale sockets
+ * @param  &endpoint: server
+ * @param  &connection: connection holding the socket from acquire
+ * @retval None
+ */
+void ConnectionPool::release(const Endpoint &endpoint,
+                             CommunicationBase &connection) {
+  connection.endConnection();
+  EndpointPool &pool = getPool(endpoint);
+  int fd = startSocket(pool);
+  if (fd == -1) {
+    free(pool);
+  } else {
+    pushIdle(pool, fd);
+  }
+
+  uint64_t now = Stats::now();
+  uint64_t next = _next_reap.load(std::memory_order_relaxed);
+  if (now >= next &&
+      _next_reap.compare_exchange_strong(next, now + _idle_timeout / 2)) {
+    reap();
+  }
+}
+
+/**
+ * @brief  Closes sockets idle longer than the idle timeout
+ * @retval number of closed sockets
+ */
+size_t ConnectionPool::reap() {
+  uint64_t now = Stats::now();
+  size_t reaped{};
+  std::shared_lock<std::shared_mutex> lock(_mutex);
+  for (auto &item : _pools) {
+    EndpointPool &pool = *item.second;
+    for (auto &shard : pool.shards) {
+      size_t closed{};
+      {
+        std::lock_guard<std::mutex> shard_lock(shard.mutex);
+        auto end = shard.idle.begin();
+        for (auto &socket : shard.idle) {
+          if (now - socket.since > _idle_timeout) {
+            close(socket.fd);
+            closed++;
+          } else {
+            *end++ = socket;
+          }
+        }
+        shard.idle.erase(end, shard.idle.end());
+        pool.idle -= closed;
+      }
+      for (size_t i = 0; i < closed; i++) {
+        free(pool);
+      }
+      reaped += closed;
+    }
+  }
+  _reaped.fetch_add(reaped, std::memory_order_relaxed);
+  return reaped;
+}
+
+/**
+ * @brief  Writes how sockets were obtained
+ * @param  &os: output stream
+ * @retval None
+ */
+void ConnectionPool::printReport(std::ostream &os) const {
+  os << "pool: " << _hits.load() << " ready, " << _misses.load()
+     << " connected on demand, " << _discarded.load() << " discarded, "
+     << _reaped.load() << " reaped, " << _waits.load() << " waits at cap"
+     << std::endl;
+}
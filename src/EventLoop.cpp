@@ -0,0 +1,246 @@
+#include "../include/EventLoop.hpp"
+#include "../include/Stats.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+/**
+ * @brief  Coroutine started by the loop, destroys itself when it finishes
+ * @retval None
+ */
+struct DetachedTask {
+  struct promise_type {
+    DetachedTask get_return_object() {
+      return {std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    std::suspend_always initial_suspend() const noexcept { return {}; }
+    std::suspend_never final_suspend() const noexcept { return {}; }
+    void return_void() const noexcept {}
+    void unhandled_exception() const noexcept { std::terminate(); }
+  };
+
+  std::coroutine_handle<promise_type> handle;
+};
+
+/**
+ * @brief  Runs the task to its end without anybody awaiting it
+ * @param  task: task to be run
+ * @retval detached coroutine
+ */
+static DetachedTask detach(Task<> task) { co_await task; }
+
+/**
+ * @brief  EventWait constructor
+ * @param  &loop: loop resuming the coroutine
+ * @param  fd: descriptor to wait for, -1 waits only for the deadline
+ * @param  events: epoll events to wait for
+ * @param  deadline: monotonic deadline in nanoseconds, 0 waits forever
+ * @retval Constructed object
+ */
+EventWait::EventWait(EventLoop &loop, int fd, uint32_t events,
+                     uint64_t deadline)
+    : _loop(loop), _events(events), _deadline(deadline) {
+  _waiter.fd = fd;
+}
+
+/**
+ * @brief  Registers the suspended coroutine in the loop
+ * @param  handle: suspended coroutine
+ * @retval True: coroutine stays suspended | False: waiting failed, coroutine
+ * continues immediately
+ */
+bool EventWait::await_suspend(std::coroutine_handle<> handle) {
+  _waiter.handle = handle;
+  return _loop.add(&_waiter, _events, _deadline);
+}
+
+/**
+ * @brief  EventLoop constructor
+ * @retval Constructed object
+ */
+EventLoop::EventLoop() {
+  _epoll_fd = epoll_create1(0);
+  if (_epoll_fd == -1) {
+    std::cerr << "ERR: Unable to create event loop :(" << std::endl;
+    exit(1);
+  }
+}
+
+/**
+ * @brief  EventLoop destructor
+ * @retval None
+ */
+EventLoop::~EventLoop() { close(_epoll_fd); }
+
+/**
+ * @brief  Starts the task within the next loop iteration
+ * @param  task: task to be run
+ * @retval None
+ */
+void EventLoop::spawn(Task<> task) {
+  _ready.push_back(detach(std::move(task)).handle);
+}
+
+/**
+ * @brief  Returns awaitable waiting until the descriptor is ready
+ * @param  fd: descriptor to wait for
+ * @param  events: epoll events to wait for
+ * @param  deadline: monotonic deadline in nanoseconds, 0 waits forever
+ * @retval awaitable resulting in READY, TIMEOUT, CANCELLED or FAILED
+ */
+EventWait EventLoop::wait(int fd, uint32_t events, uint64_t deadline) {
+  return EventWait(*this, fd, events, deadline);
+}
+
+/**
+ * @brief  Returns awaitable waiting for the given time
+ * @param  duration: time to wait in nanoseconds
+ * @retval awaitable resulting in TIMEOUT
+ */
+EventWait EventLoop::sleep(uint64_t duration) {
+  return EventWait(*this, -1, 0, Stats::now() + duration);
+}
+
+/**
+ * @brief  Registers the waiter, every descriptor has at most one waiter
+ * @param  *waiter: waiter of the suspended coroutine
+ * @param  events: epoll events to wait for
+ * @param  deadline: monotonic deadline in nanoseconds, 0 waits forever
+ * @retval True: waiter was registered | False: waiter could not be registered
+ */
+bool EventLoop::add(EventWaiter *waiter, uint32_t events, uint64_t deadline) {
+  if (waiter->fd != -1) {
+    struct epoll_event event {};
+    event.events = events;
+    event.data.ptr = waiter;
+    if (_waiters.count(waiter->fd) ||
+        epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, waiter->fd, &event) == -1) {
+      waiter->result = WaitResult::FAILED;
+      return false;
+    }
+    _waiters[waiter->fd] = waiter;
+  }
+  if (deadline) {
+    waiter->timer = _timers.emplace(deadline, waiter);
+    waiter->has_timer = true;
+  }
+  return true;
+}
+
+/**
+ * @brief  Unregisters the waiter and schedules its coroutine
+ * @param  *waiter: waiter to be completed
+ * @param  result: result of the wait
+ * @retval None
+ */
+void EventLoop::complete(EventWaiter *waiter, WaitResult result) {
+  if (waiter->fd != -1) {
+    epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, waiter->fd, nullptr);
+    _waiters.erase(waiter->fd);
+  }
+  if (waiter->has_timer) {
+    _timers.erase(waiter->timer);
+    waiter->has_timer = false;
+  }
+  waiter->result = result;
+  _ready.push_back(waiter->handle);
+}
+
+/**
+ * @brief  Completes waiters whose deadline has passed
+ * @retval None
+ */
+void EventLoop::expireTimers() {
+  uint64_t now = Stats::now();
+  while (!_timers.empty() && _timers.begin()->first <= now) {
+    complete(_timers.begin()->second, WaitResult::TIMEOUT);
+  }
+}
+
+/**
+ * @brief  Cancels waiting on the descriptor, its coroutine is resumed with
+ * CANCELLED
+ * @param  fd: descriptor
+ * @retval True: a coroutine was waiting | False: nobody waits for descriptor
+ */
+bool EventLoop::cancel(int fd) {
+  auto waiter = _waiters.find(fd);
+  if (waiter == _waiters.end()) {
+    return false;
+  }
+  complete(waiter->second, WaitResult::CANCELLED);
+  return true;
+}
+
+/**
+ * @brief  Sets work done when no coroutine is ready, the loop does not wait
+ * for descriptors while the work keeps coming and the wake descriptor
+ * interrupts the wait when new work arrives
+ * @param  idle: runs one piece of work, returns false when there was none
+ * @param  wake_fd: eventfd written when there is new work
+ * @retval None
+ */
+void EventLoop::setIdle(std::function<bool()> idle, int wake_fd) {
+  _idle = std::move(idle);
+  _wake_fd = wake_fd;
+  struct epoll_event event {};
+  event.events = EPOLLIN;
+  event.data.ptr = nullptr;
+  if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wake_fd, &event) == -1) {
+    std::cerr << "ERR: Unable to create event loop :(" << std::endl;
+    exit(1);
+  }
+}
+
+/**
+ * @brief  Runs coroutines until all of them finish
+ * @retval None
+ */
+void EventLoop::run() {
+  struct epoll_event events[256];
+
+  while (!_ready.empty() || !_waiters.empty() || !_timers.empty()) {
+    while (!_ready.empty()) {
+      auto handle = _ready.front();
+      _ready.pop_front();
+      handle.resume();
+    }
+    if (_waiters.empty() && _timers.empty()) {
+      break;
+    }
+
+    int timeout{-1};
+    if (_idle && _idle()) {
+      timeout = 0;
+    } else if (!_timers.empty()) {
+      uint64_t now = Stats::now();
+      uint64_t deadline = _timers.begin()->first;
+      /* Round up so the timer is due when epoll_wait returns */
+      timeout = deadline > now
+                    ? static_cast<int>((deadline - now + 999999) / 1000000)
+                    : 0;
+    }
+
+    int count = epoll_wait(_epoll_fd, events, 256, timeout);
+    if (count == -1 && errno != EINTR) {
+      std::cerr << "ERR: Event loop failed :(" << std::endl;
+      exit(1);
+    }
+    for (int i = 0; i < count; i++) {
+      if (!events[i].data.ptr) {
+        uint64_t value;
+        if (read(_wake_fd, &value, sizeof(value)) == -1 && errno != EAGAIN) {
+          std::cerr << "ERR: Event loop failed :(" << std::endl;
+          exit(1);
+        }
+        continue;
+      }
+      complete(static_cast<EventWaiter *>(events[i].data.ptr),
+               WaitResult::READY);
+    }
+    expireTimers();
+  }
+}
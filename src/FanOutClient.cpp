@@ -0,0 +1,244 @@
+#include "../include/FanOutClient.hpp"
+#include "../include/Client.hpp"
+#include "../include/Stats.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+/**
+ * @brief  Splits message id of the merged list into server and id
+ * @param  tagged: id in the form <endpoint>:<id>, endpoints are numbered
+ * from 1
+ * @param  &endpoint: index of the server counted from 0
+ * @param  &id: id of the message on the server
+ * @retval True: id is tagged | False: id is not tagged or the endpoint
+ * number is out of range
+ */
+bool FanOutClient::parseTag(const std::string tagged, size_t &endpoint,
+                            std::string &id) {
+  auto separator = tagged.find(':');
+  if (separator == std::string::npos || separator == 0 ||
+      tagged.find_first_not_of("0123456789") != separator) {
+    return false;
+  }
+  try {
+    endpoint = std::stoul(tagged.substr(0, separator));
+  } catch (const std::out_of_range &) {
+    return false;
+  }
+  id = tagged.substr(separator + 1);
+  return endpoint > 0 && !id.empty();
+}
+
+/**
+ * @brief  Issues the command on one server and keeps its result
+ * @param  index: index of the server
+ * @param  command: command type
+ * @param  command_args: command arguments
+ * @retval None
+ */
+Task<> FanOutClient::requestEndpoint(
+    size_t index, CommandType command,
+    CommandArgs command_args) {
+  _results[index] = co_await _sessions[index].request(command, command_args);
+}
+
+/**
+ * @brief  Issues the command on the servers concurrently and waits for all
+ * of them
+ * @param  &indexes: indexes of the servers
+ * @param  command: command type
+ * @param  command_args: command arguments
+ * @retval None
+ */
+void FanOutClient::requestAll(
+    const std::vector<size_t> &indexes, CommandType command,
+    CommandArgs command_args) {
+  for (auto index : indexes) {
+    _loop.spawn(requestEndpoint(index, command, command_args));
+  }
+  _loop.run();
+}
+
+/**
+ * @brief  Writes the outcome of the command on one server
+ * @param  index: index of the server
+ * @param  &os: output stream
+ * @retval None
+ */
+void FanOutClient::printResult(size_t index, std::ostream &os) {
+  auto &result = _results[index];
+  std::string name = getEndpointName(_endpoints[index]);
+  if (result.ok()) {
+    /* Login response carries the token after the text */
+    std::string content = Client::parseMessageContent(result.message);
+    os << "SUCCESS: [" << name << "] "
+       << content.substr(0, content.find("\" \"")) << std::endl;
+  } else if (result.status == AsyncStatus::SERVER_ERROR) {
+    os << "ERROR: [" << name << "] " << result.message << std::endl;
+  } else {
+    os << "ERROR: [" << name << "] "
+       << AsyncSession::getStatusName(result.status) << std::endl;
+  }
+}
+
+/**
+ * @brief  Writes messages of all servers as one list ordered by server and
+ * id, ids are tagged with the server number
+ * @param  &os: output stream
+ * @retval None
+ */
+void FanOutClient::printMergedList(std::ostream &os) {
+  bool listed{false};
+  for (size_t i = 0; i < _results.size(); i++) {
+    if (!_results[i].ok()) {
+      continue;
+    }
+    if (!listed) {
+      os << "SUCCESS: " << std::endl;
+      listed = true;
+    }
+    for (auto &entry : Client::parseList(_results[i].message)) {
+      os << i + 1 << ":" << entry.id << ": " << std::endl;
+      os << "  From: " << entry.sender << std::endl;
+      os << "  Subject: " << entry.subject << std::endl;
+    }
+  }
+  for (size_t i = 0; i < _results.size(); i++) {
+    if (!_results[i].ok()) {
+      printResult(i, os);
+    }
+  }
+}
+
+/**
+ * @brief  FanOutClient constructor (and server communication launcher),
+ * register, login, logout and list go to every server, fetch to the server
+ * of its tag and send to the first server
+ * @param  args: parsed program arguments
+ * @retval FanOutClient
+ */
+FanOutClient::FanOutClient(ArgsParser args)
+    : _endpoints(args.getEndpoints()) {
+  Stats &stats = Stats::instance();
+  CommandType command = args.getCommandType();
+  auto command_args = args.getCommandArgs();
+
+  _sessions.reserve(_endpoints.size());
+  for (auto &endpoint : _endpoints) {
+    _sessions.emplace_back(_loop, endpoint.address, endpoint.is_v6,
+                           endpoint.port);
+  }
+  _results.resize(_endpoints.size());
+
+  std::vector<size_t> indexes;
+  if (command == CommandType::FETCH) {
+    size_t endpoint;
+    std::string id;
+    if (!parseTag(command_args[CommandArg::ID], endpoint, id) ||
+        endpoint > _endpoints.size()) {
+      std::cerr << "ERR: Message id has to be <endpoint>:<id> from the list "
+                   ":("
+                << std::endl;
+      exit(1);
+    }
+    command_args[CommandArg::ID] = id;
+    indexes.push_back(endpoint - 1);
+  } else if (command == CommandType::SEND) {
+    indexes.push_back(0);
+  } else {
+    for (size_t i = 0; i < _endpoints.size(); i++) {
+      indexes.push_back(i);
+    }
+  }
+
+  /* Servers the user is not logged in to are reported and skipped */
+  uint64_t start = Stats::now();
+  TokenStore store(TOKEN_STORE_FILENAME);
+  bool session = describeCommand(command).session != SessionEffect::NONE;
+  if (Client::needsToken(command) || session) {
+    Client::openTokenStore(store);
+  }
+  std::vector<std::string> users(_endpoints.size());
+  std::vector<size_t> requested;
+  for (auto index : indexes) {
+    std::string name = getEndpointName(_endpoints[index]);
+    if (Client::needsToken(command)) {
+      std::string token;
+      if (!Client::findUser(store, name, args, users[index]) ||
+          !store.get(name, users[index], token)) {
+        _results[index].status = AsyncStatus::SERVER_ERROR;
+        _results[index].message = "not logged in";
+        continue;
+      }
+      _sessions[index].setToken(token);
+    } else if (session) {
+      Client::findUser(store, name, args, users[index]);
+    }
+    requested.push_back(index);
+  }
+  if (requested.empty()) {
+    std::cerr << "ERR: Login token could not be obtained :(" << std::endl;
+    exit(1);
+  }
+  if (Client::needsToken(command)) {
+    stats.add(Phase::TOKEN, start);
+  }
+
+  requestAll(requested, command, command_args);
+  for (auto index : requested) {
+    stats.addRequest(_sessions[index].getTiming());
+  }
+
+  start = Stats::now();
+  std::ostringstream output;
+  switch (command) {
+  case CommandType::LIST:
+    printMergedList(output);
+    break;
+  case CommandType::FETCH:
+    if (_results[indexes[0]].ok()) {
+      output << "SUCCESS: ";
+      Client::printFetch(_results[indexes[0]].message, output);
+      if (args.useIndex()) {
+        Client::indexFetch(getEndpointName(_endpoints[indexes[0]]),
+                           command_args[CommandArg::ID],
+                           _results[indexes[0]].message);
+      }
+    } else {
+      printResult(indexes[0], output);
+    }
+    break;
+  default:
+    for (auto index : indexes) {
+      printResult(index, output);
+    }
+    break;
+  }
+
+  /* Tokens of servers that did not answer are kept */
+  if (session) {
+    for (auto index : requested) {
+      if (!_results[index].ok()) {
+        continue;
+      }
+      std::string name = getEndpointName(_endpoints[index]);
+      if (describeCommand(command).session == SessionEffect::END) {
+        store.remove(name, users[index]);
+      } else if (!store.put(name, users[index],
+                            _sessions[index].getToken())) {
+        std::cerr << "ERR: Login token could not be saved :(" << std::endl;
+      }
+    }
+  }
+  stats.add(Phase::PARSE, start);
+
+  start = Stats::now();
+  std::cout << output.str() << std::flush;
+  stats.add(Phase::OUTPUT, start);
+
+  if (stats.isEnabled()) {
+    stats.print(std::cerr);
+  }
+}
@@ -0,0 +1,78 @@
+#include "../include/HedgePolicy.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+/**
+ * @brief  HedgePolicy constructor
+ * @param  percentile: percentile of latencies used as the delay
+ * @param  initial_delay: delay in nanoseconds until enough latencies are known
+ * @param  min_delay: lower limit of the delay in nanoseconds
+ * @retval Constructed object
+ */
+HedgePolicy::HedgePolicy(double percentile, uint64_t initial_delay,
+                         uint64_t min_delay)
+    : _percentile(percentile), _initial_delay(initial_delay),
+      _min_delay(min_delay) {}
+
+/**
+ * @brief  Returns time after which the request is duplicated
+ * @retval delay in nanoseconds
+ */
+uint64_t HedgePolicy::getDelay() const {
+  if (_latencies.count() < MIN_SAMPLES) {
+    return _initial_delay;
+  }
+  return std::max(_min_delay, _latencies.percentile(_percentile));
+}
+
+/**
+ * @brief  Records latency of one successful connection of a read-only request
+ * @param  latency: latency in nanoseconds
+ * @retval None
+ */
+void HedgePolicy::recordLatency(uint64_t latency) {
+  _latencies.record(latency);
+}
+
+/**
+ * @brief  Records outcome of one read-only request
+ * @param  hedged: duplicate request was issued
+ * @param  secondary_won: response of the duplicate was used
+ * @retval None
+ */
+void HedgePolicy::recordRequest(bool hedged, bool secondary_won) {
+  _requests++;
+  _hedged += hedged;
+  _secondary_wins += secondary_won;
+}
+
+/**
+ * @brief  Returns number of read-only requests
+ * @retval number of requests
+ */
+uint64_t HedgePolicy::getRequests() const { return _requests; }
+
+/**
+ * @brief  Returns number of duplicated requests
+ * @retval number of duplicated requests
+ */
+uint64_t HedgePolicy::getHedged() const { return _hedged; }
+
+/**
+ * @brief  Returns number of requests answered by the duplicate first
+ * @retval number of requests won by the duplicate
+ */
+uint64_t HedgePolicy::getSecondaryWins() const { return _secondary_wins; }
+
+/**
+ * @brief  Prints how often requests were duplicated
+ * @param  &os: output stream
+ * @retval None
+ */
+void HedgePolicy::printReport(std::ostream &os) const {
+  os << "hedged: " << _hedged << " of " << _requests
+     << " read-only requests, duplicate won " << _secondary_wins
+     << ", delay: " << std::fixed << std::setprecision(3) << getDelay() / 1e6
+     << " ms" << std::endl;
+}
@@ -0,0 +1,124 @@
+#include "../include/Histogram.hpp"
+
+/**
+ * @brief  Maps the value to its bucket
+ * @param  value: recorded value
+ * @retval bucket index
+ */
+int Histogram::bucketIndex(uint64_t value) {
+  if (value < SUB_BUCKETS) {
+    return static_cast<int>(value);
+  }
+  /* Position of the highest set bit selects the power of two, following bits
+   * select the linear sub-bucket */
+  int magnitude = 63 - __builtin_clzll(value);
+  int shift = magnitude - SUB_BUCKET_BITS;
+  int sub_bucket = static_cast<int>((value >> shift) & (SUB_BUCKETS - 1));
+  return (shift + 1) * SUB_BUCKETS + sub_bucket;
+}
+
+/**
+ * @brief  Returns the highest value that falls into the bucket
+ * @param  index: bucket index
+ * @retval upper bound of the bucket
+ */
+uint64_t Histogram::bucketUpperBound(int index) {
+  if (index < SUB_BUCKETS) {
+    return static_cast<uint64_t>(index);
+  }
+  int shift = index / SUB_BUCKETS - 1;
+  uint64_t sub_bucket = static_cast<uint64_t>(index % SUB_BUCKETS);
+  uint64_t lower = (SUB_BUCKETS + sub_bucket) << shift;
+  return lower + ((uint64_t{1} << shift) - 1);
+}
+
+/**
+ * @brief  Records one value
+ * @param  value: latency in nanoseconds
+ * @retval None
+ */
+void Histogram::record(uint64_t value) {
+  _counts[bucketIndex(value)]++;
+  _total++;
+  _sum += value;
+  if (value < _min)
+    _min = value;
+  if (value > _max)
+    _max = value;
+}
+
+/**
+ * @brief  Adds all values recorded by another histogram
+ * @param  &other: histogram to be merged in
+ * @retval None
+ */
+void Histogram::merge(const Histogram &other) {
+  for (int i = 0; i < BUCKETS; i++) {
+    _counts[i] += other._counts[i];
+  }
+  _total += other._total;
+  _sum += other._sum;
+  if (other._min < _min)
+    _min = other._min;
+  if (other._max > _max)
+    _max = other._max;
+}
+
+/**
+ * @brief  Forgets all recorded values
+ * @retval None
+ */
+void Histogram::reset() { *this = Histogram(); }
+
+/**
+ * @brief  Returns number of recorded values
+ * @retval number of values
+ */
+uint64_t Histogram::count() const { return _total; }
+
+/**
+ * @brief  Returns the lowest recorded value
+ * @retval lowest value, 0 if nothing was recorded
+ */
+uint64_t Histogram::min() const { return _total ? _min : 0; }
+
+/**
+ * @brief  Returns the highest recorded value
+ * @retval highest value
+ */
+uint64_t Histogram::max() const { return _max; }
+
+/**
+ * @brief  Returns arithmetic mean of recorded values
+ * @retval mean value, 0 if nothing was recorded
+ */
+double Histogram::mean() const {
+  return _total ? static_cast<double>(_sum) / _total : 0.0;
+}
+
+/**
+ * @brief  Returns value below which the given percentage of values falls
+ * @param  percentile: percentile in range 0-100
+ * @retval upper bound of the bucket containing the percentile (clamped to
+ * the highest recorded value)
+ */
+uint64_t Histogram::percentile(double percentile) const {
+  if (_total == 0) {
+    return 0;
+  }
+  uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * _total + 0.5);
+  if (rank < 1)
+    rank = 1;
+  if (rank > _total)
+    rank = _total;
+
+  uint64_t seen{};
+  for (int i = 0; i < BUCKETS; i++) {
+    seen += _counts[i];
+    if (seen >= rank) {
+      uint64_t bound = bucketUpperBound(i);
+      return bound < _max ? bound : _max;
+    }
+  }
+  return _max;
+}
@@ -0,0 +1,692 @@
+#include "../include/LoadGenerator.hpp"
+#include "../include/Client.hpp"
+#include "../include/CommunicationBase.hpp"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+/**
+ * @brief  VirtualUser constructor
+ * @param  &config: load generator settings
+ * @param  index: index of the user within the run
+ * @retval Constructed object
+ */
+VirtualUser::VirtualUser(const LoadConfig &config, int index)
+    : _config(config), _index(index),
+      _username(config.prefix + std::to_string(index)),
+      _password(ArgsParser::base64Encode(config.prefix)),
+      _random(static_cast<unsigned>(index)),
+      _endpoint{config.address, config.is_v6, config.port},
+      _connection(config.address, config.is_v6, config.port) {}
+
+/**
+ * @brief  Sends one command with the current arguments to the server within
+ * its own connection, taken from the pool when there is one, the response is
+ * kept in the response buffer, a failed connection leaves it empty so that
+ * the operation counts as an error
+ * @param  command: command type
+ * @retval True: response is received | False: connecting or communication
+ * failed
+ */
+bool VirtualUser::request(CommandType command) {
+  Client::getFormattedData(command, _command_args, _token, _request);
+  bool done;
+  if (_config.pool) {
+    uint64_t start = Stats::now();
+    done = _config.pool->acquire(_endpoint, _connection);
+    if (done) {
+      done = _connection.tryCommunicate(_request, _response);
+      _config.pool->release(_endpoint, _connection);
+      _timing = _connection.getTiming();
+    } else {
+      /* Connection keeps timing of its previous request */
+      _timing = RequestTiming();
+      _timing.connect_start = start;
+      _timing.connect_end = Stats::now();
+    }
+  } else {
+    done = _connection.tryConnection() &&
+           _connection.tryCommunicate(_request, _response);
+    _connection.endConnection();
+    _timing = _connection.getTiming();
+  }
+  if (!done) {
+    _response.clear();
+  }
+  return done;
+}
+
+/**
+ * @brief  Assembles arguments of the command from the user state, memory of
+ * the arguments is reused
+ * @param  command: command type
+ * @retval None
+ */
+void VirtualUser::setCommandArgs(CommandType command) {
+  switch (command) {
+  case CommandType::REGISTER:
+  case CommandType::LOGIN:
+    _command_args[CommandArg::USERNAME].assign(_username);
+    _command_args[CommandArg::PASSWORD].assign(_password);
+    break;
+  case CommandType::SEND: {
+    std::uniform_int_distribution<int> recipient(0, _config.users - 1);
+    _command_args[CommandArg::RECIPIENT].assign(_config.prefix);
+    _command_args[CommandArg::RECIPIENT].append(
+        std::to_string(recipient(_random)));
+    _command_args[CommandArg::SUBJECT].assign("load ");
+    _command_args[CommandArg::SUBJECT].append(std::to_string(_index));
+    _command_args[CommandArg::BODY].assign(_config.body_size, 'x');
+    break;
+  }
+  case CommandType::FETCH: {
+    if (_message_ids.empty()) {
+      _command_args[CommandArg::ID].assign("1");
+    } else {
+      std::uniform_int_distribution<size_t> id(0, _message_ids.size() - 1);
+      _command_args[CommandArg::ID].assign(_message_ids[id(_random)]);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+/**
+ * @brief  Updates the user state according to the server response, the
+ * response is decoded into the reused buffers
+ * @param  command: command type
+ * @param  &message: message from the server
+ * @retval None
+ */
+void VirtualUser::processResponse(CommandType command,
+                                  const std::string &message) {
+  if (!Client::isMessageOk(message)) {
+    _stats[command].errors++;
+    return;
+  }
+  visitCommand(command, [&](auto type) {
+    constexpr CommandDescriptor descriptor =
+        describeCommand(decltype(type)::value);
+    if constexpr (descriptor.response == ResponseShape::LOGIN) {
+      decodeResponse<descriptor.type>(message, _token);
+    } else if constexpr (descriptor.response == ResponseShape::LIST) {
+      decodeResponse<descriptor.type>(message, _entries);
+      _message_ids.resize(_entries.size());
+      for (size_t i = 0; i < _entries.size(); i++) {
+        _message_ids[i].assign(_entries[i].id);
+      }
+    } else if constexpr (descriptor.response == ResponseShape::FETCH) {
+      decodeResponse<descriptor.type>(message, _fetched);
+    } else {
+      decodeResponse<descriptor.type>(message, _text);
+    }
+    if constexpr (descriptor.session == SessionEffect::END) {
+      _token.clear();
+    }
+  });
+}
+
+/**
+ * @brief  Registers the user and logs it in, nothing is measured
+ * @retval None
+ */
+void VirtualUser::setUp() {
+  setCommandArgs(CommandType::REGISTER);
+  request(CommandType::REGISTER);
+  setCommandArgs(CommandType::LOGIN);
+  request(CommandType::LOGIN);
+  if (Client::isMessageOk(_response)) {
+    Client::parseLoginToken(_response, _token);
+  }
+}
+
+/**
+ * @brief  Registers the user and logs it in within the event loop, nothing is
+ * measured
+ * @param  &session: asynchronous session of the user
+ * @retval None
+ */
+Task<> VirtualUser::setUpAsync(AsyncSession &session) {
+  setCommandArgs(CommandType::REGISTER);
+  co_await session.request(CommandType::REGISTER, _command_args);
+  setCommandArgs(CommandType::LOGIN);
+  auto result = co_await session.request(CommandType::LOGIN, _command_args);
+  if (result.ok()) {
+    _token = session.getToken();
+  }
+}
+
+/**
+ * @brief  Issues one measured command, a logged out user logs in first,
+ * allocations from assembling the arguments to decoding the response are
+ * counted
+ * @param  command: command type
+ * @retval None
+ */
+void VirtualUser::runOperation(CommandType command) {
+  if (Client::needsToken(command) && _token.empty()) {
+    command = CommandType::LOGIN;
+  }
+
+  AllocCount alloc_start = AllocCounter::get();
+  setCommandArgs(command);
+  auto start = std::chrono::steady_clock::now();
+  request(command);
+  processResponse(command, _response);
+  uint64_t parsed = Stats::now();
+  auto end = std::chrono::steady_clock::now();
+  AllocCount allocated = AllocCounter::since(alloc_start);
+
+  OperationStats &stats = _stats[command];
+  if (stats.latency.count() > 0) {
+    stats.alloc_requests++;
+    stats.allocations += allocated.allocations;
+    stats.alloc_bytes += allocated.bytes;
+  }
+  stats.latency.record(static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+          .count()));
+
+  if (_config.trace) {
+    _config.trace->addRequest(_index + 1, getCommandTypeEq(command), _timing,
+                              parsed);
+  }
+}
+
+/**
+ * @brief  Issues one measured command within the event loop, a logged out
+ * user logs in first, large responses of a sharded run are parsed by any
+ * idle shard
+ * @param  &session: asynchronous session of the user
+ * @param  command: command type
+ * @param  *shards: shards of the run, nullptr runs one event loop
+ * @param  shard: shard of the user
+ * @retval None
+ */
+Task<> VirtualUser::runOperationAsync(AsyncSession &session,
+                                      CommandType command,
+                                      ShardGroup *shards, size_t shard) {
+  if (Client::needsToken(command) && _token.empty()) {
+    command = CommandType::LOGIN;
+  }
+  setCommandArgs(command);
+  session.setToken(_token);
+
+  auto start = std::chrono::steady_clock::now();
+  auto result = co_await session.request(command, _command_args);
+  /* Value keeps the raw response, failed connections count as errors */
+  if (shards && result.value.size() >= OFFLOAD_SIZE) {
+    co_await shards->offload(
+        shard, [&]() { processResponse(command, result.value); });
+  } else {
+    processResponse(command, result.value);
+  }
+  uint64_t parsed = Stats::now();
+  auto end = std::chrono::steady_clock::now();
+
+  _stats[command].latency.record(static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+          .count()));
+
+  if (_config.trace) {
+    _config.trace->addRequest(_index + 1, getCommandTypeEq(command),
+                              session.getTiming(), parsed);
+  }
+}
+
+/**
+ * @brief  Returns name of the user
+ * @retval username
+ */
+const std::string &VirtualUser::getUsername() const { return _username; }
+
+/**
+ * @brief  Returns statistics collected by the user
+ * @retval per-operation statistics
+ */
+const std::map<CommandType, OperationStats> &VirtualUser::getStats() const {
+  return _stats;
+}
+
+/**
+ * @brief  LoadGenerator constructor
+ * @param  config: run settings
+ * @retval Constructed object
+ */
+LoadGenerator::LoadGenerator(LoadConfig config) : _config(config) {
+  if (_config.mix.empty()) {
+    _config.mix[CommandType::LIST] = 4;
+    _config.mix[CommandType::FETCH] = 4;
+    _config.mix[CommandType::SEND] = 2;
+    _config.mix[CommandType::LOGIN] = 1;
+    _config.mix[CommandType::LOGOUT] = 1;
+  }
+  if (_config.hedge > 0) {
+    _hedge.reset(new HedgePolicy(_config.hedge, HEDGE_INITIAL_DELAY,
+                                 HEDGE_MIN_DELAY));
+  }
+  for (auto &item : _config.mix) {
+    _commands.push_back(item.first);
+    _weights.push_back(item.second);
+  }
+  for (int i = 0; i < _config.users; i++) {
+    _users.emplace_back(_config, i);
+    if (_config.trace) {
+      _config.trace->setTrackName(i + 1, "user " + std::to_string(i));
+    }
+  }
+
+  /* Session of the user stays within one shard for the whole run */
+  if (_config.shards) {
+    _shards.reset(new ShardGroup(_config.shards));
+    for (auto &user : _users) {
+      _user_shards.push_back(_shards->getShard(user.getUsername()));
+    }
+  }
+}
+
+/**
+ * @brief  Parses operation mix in the form "list=4,fetch=4,send=2"
+ * @param  mix: operation mix given by the user
+ * @param  &weights: parsed weights of operations
+ * @retval True: mix is valid | False: mix is not valid
+ */
+bool LoadGenerator::parseMix(const std::string mix,
+                             std::map<CommandType, int> &weights) {
+  std::stringstream s_mix(mix);
+  std::string item;
+  while (std::getline(s_mix, item, ',')) {
+    auto separator = item.find('=');
+    if (separator == std::string::npos) {
+      return false;
+    }
+    std::string name = item.substr(0, separator);
+    std::string weight = item.substr(separator + 1);
+    if (weight.empty() ||
+        weight.find_first_not_of("0123456789") != std::string::npos) {
+      return false;
+    }
+    bool found{false};
+    for (auto &command : COMMANDS) {
+      if (command.response != ResponseShape::LOCAL && command.name == name) {
+        weights[command.type] = std::stoi(weight);
+        found = true;
+      }
+    }
+    if (!found) {
+      return false;
+    }
+  }
+  return !weights.empty();
+}
+
+/**
+ * @brief  Issues operations of one user until the run is over
+ * @param  &user: simulated user
+ * @param  seed: seed of the operation choice
+ * @retval None
+ */
+void LoadGenerator::runUser(VirtualUser &user, unsigned seed) {
+  std::mt19937 random(seed);
+  std::discrete_distribution<size_t> choice(_weights.begin(), _weights.end());
+
+  while (!_stop.load(std::memory_order_relaxed)) {
+    if (_config.requests && _issued.fetch_add(1) >= _config.requests) {
+      break;
+    }
+    user.runOperation(_commands[choice(random)]);
+  }
+}
+
+/**
+ * @brief  Issues operations of one user within the event loop until the run
+ * is over
+ * @param  &user: simulated user
+ * @param  &session: asynchronous session of the user
+ * @param  seed: seed of the operation choice
+ * @param  shard: shard of the user in a sharded run
+ * @retval None
+ */
+Task<> LoadGenerator::runUserAsync(VirtualUser &user, AsyncSession &session,
+                                   unsigned seed, size_t shard) {
+  std::mt19937 random(seed);
+  std::discrete_distribution<size_t> choice(_weights.begin(), _weights.end());
+
+  while (!_stop.load(std::memory_order_relaxed)) {
+    if (_config.requests && _issued.fetch_add(1) >= _config.requests) {
+      break;
+    }
+    co_await user.runOperationAsync(session, _commands[choice(random)],
+                                    _shards.get(), shard);
+    if (_shards) {
+      _shards->getCounters(shard).operations++;
+    }
+  }
+}
+
+/**
+ * @brief  Ends the measured phase of the asynchronous run after its duration
+ * @param  &loop: event loop of the run
+ * @retval None
+ */
+Task<> LoadGenerator::stopAfter(EventLoop &loop) {
+  co_await loop.sleep(static_cast<uint64_t>(_config.duration * 1e9));
+  _stop = true;
+}
+
+/**
+ * @brief  Sets up every user in its own thread
+ * @retval None
+ */
+void LoadGenerator::setUpUsers() {
+  std::vector<std::thread> threads;
+  for (auto &user : _users) {
+    threads.emplace_back(&VirtualUser::setUp, &user);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+/**
+ * @brief  Sets up all users as coroutines of one event loop
+ * @retval None
+ */
+void LoadGenerator::setUpUsersAsync() {
+  if (_shards) {
+    runShards(false);
+    return;
+  }
+  EventLoop loop;
+  std::vector<AsyncSession> sessions;
+  sessions.reserve(_users.size());
+  for (auto &user : _users) {
+    sessions.emplace_back(loop, _config.address, _config.is_v6, _config.port);
+    sessions.back().setTimeout(_config.timeout);
+    loop.spawn(user.setUpAsync(sessions.back()));
+  }
+  loop.run();
+}
+
+/**
+ * @brief  Runs every user in its own thread
+ * @retval None
+ */
+void LoadGenerator::runMeasured() {
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < _users.size(); i++) {
+    threads.emplace_back(&LoadGenerator::runUser, this, std::ref(_users[i]),
+                         static_cast<unsigned>(i + 1));
+  }
+  if (!_config.requests) {
+    std::this_thread::sleep_for(
+        std::chrono::duration<double>(_config.duration));
+    _stop = true;
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+/**
+ * @brief  Runs all users as coroutines multiplexed by one event loop in the
+ * calling thread
+ * @retval None
+ */
+void LoadGenerator::runMeasuredAsync() {
+  if (_shards) {
+    runShards(true);
+    return;
+  }
+  EventLoop loop;
+  std::vector<AsyncSession> sessions;
+  sessions.reserve(_users.size());
+  for (size_t i = 0; i < _users.size(); i++) {
+    sessions.emplace_back(loop, _config.address, _config.is_v6, _config.port);
+    sessions.back().setTimeout(_config.timeout);
+    sessions.back().setHedge(_hedge.get(), _config.secondary);
+    loop.spawn(runUserAsync(_users[i], sessions.back(),
+                            static_cast<unsigned>(i + 1)));
+  }
+  if (!_config.requests) {
+    loop.spawn(stopAfter(loop));
+  }
+  loop.run();
+}
+
+/**
+ * @brief  Runs users of every shard as coroutines of the shard event loop,
+ * shards run in their own threads
+ * @param  measured: True: measured phase | False: setting up of users
+ * @retval None
+ */
+void LoadGenerator::runShards(bool measured) {
+  _shards->run([&](size_t shard, EventLoop &loop) {
+    std::vector<AsyncSession> sessions;
+    sessions.reserve(_users.size());
+    for (size_t i = 0; i < _users.size(); i++) {
+      if (_user_shards[i] != shard) {
+        continue;
+      }
+      sessions.emplace_back(loop, _config.address, _config.is_v6,
+                            _config.port);
+      sessions.back().setTimeout(_config.timeout);
+      if (measured) {
+        loop.spawn(runUserAsync(_users[i], sessions.back(),
+                                static_cast<unsigned>(i + 1), shard));
+      } else {
+        loop.spawn(_users[i].setUpAsync(sessions.back()));
+      }
+    }
+    if (measured && !_config.requests && !sessions.empty()) {
+      loop.spawn(stopAfter(loop));
+    }
+    loop.run();
+  });
+}
+
+/**
+ * @brief  Sets up all users and runs the measured phase
+ * @retval None
+ */
+void LoadGenerator::run() {
+  /* Registration and login of users is not measured */
+  if (_config.async) {
+    setUpUsersAsync();
+  } else {
+    setUpUsers();
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  if (_config.async) {
+    runMeasuredAsync();
+  } else {
+    runMeasured();
+  }
+  _elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                           start)
+                 .count();
+
+  for (auto &user : _users) {
+    for (auto &item : user.getStats()) {
+      _results[item.first].latency.merge(item.second.latency);
+      _results[item.first].errors += item.second.errors;
+      _results[item.first].alloc_requests += item.second.alloc_requests;
+      _results[item.first].allocations += item.second.allocations;
+      _results[item.first].alloc_bytes += item.second.alloc_bytes;
+    }
+  }
+}
+
+/**
+ * @brief  Returns duration of the measured phase
+ * @retval duration in seconds
+ */
+double LoadGenerator::getElapsed() const { return _elapsed; }
+
+/**
+ * @brief  Returns statistics aggregated over all users
+ * @retval per-operation statistics
+ */
+const std::map<CommandType, OperationStats> &LoadGenerator::getResults() const {
+  return _results;
+}
+
+/**
+ * @brief  Returns average allocations of one steady-state request
+ * @param  &stats: statistics of the operation
+ * @retval allocations per request, zero without steady-state requests
+ */
+double LoadGenerator::getAllocationsPerRequest(const OperationStats &stats) {
+  if (!stats.alloc_requests) {
+    return 0;
+  }
+  return static_cast<double>(stats.allocations) / stats.alloc_requests;
+}
+
+/**
+ * @brief  Checks that steady-state requests of every operation stay within the
+ * allocation limit
+ * @param  limit: allowed average allocations per request
+ * @param  &os: output stream receiving the exceeding operations
+ * @retval number of operations allocating more than the limit
+ */
+size_t LoadGenerator::checkAllocations(double limit, std::ostream &os) const {
+  size_t exceeded{};
+  for (auto &item : _results) {
+    double allocations = getAllocationsPerRequest(item.second);
+    if (allocations > limit) {
+      os << "ERR: " << getCommandTypeEq(item.first) << " makes "
+         << allocations << " allocations per request :(" << std::endl;
+      exceeded++;
+    }
+  }
+  return exceeded;
+}
+
+/**
+ * @brief  Prints human readable report of the run
+ * @param  &os: output stream
+ * @retval None
+ */
+void LoadGenerator::printReport(std::ostream &os) const {
+  Histogram total;
+  uint64_t errors{};
+
+  os << std::left << std::setw(10) << "operation" << std::right
+     << std::setw(10) << "count" << std::setw(8) << "errors" << std::setw(11)
+     << "p50[ms]" << std::setw(11) << "p90[ms]" << std::setw(11) << "p99[ms]"
+     << std::setw(11) << "p99.9[ms]" << std::setw(11) << "max[ms]"
+     << std::setw(12) << "req/s" << std::endl;
+
+  auto row = [&](const std::string name, const Histogram &latency,
+                 uint64_t row_errors) {
+    os << std::left << std::setw(10) << name << std::right << std::setw(10)
+       << latency.count() << std::setw(8) << row_errors << std::fixed
+       << std::setprecision(3) << std::setw(11)
+       << latency.percentile(50) / 1e6 << std::setw(11)
+       << latency.percentile(90) / 1e6 << std::setw(11)
+       << latency.percentile(99) / 1e6 << std::setw(11)
+       << latency.percentile(99.9) / 1e6 << std::setw(11)
+       << latency.max() / 1e6 << std::setprecision(1) << std::setw(12)
+       << (_elapsed > 0 ? latency.count() / _elapsed : 0.0) << std::endl;
+  };
+
+  for (auto &item : _results) {
+    row(getCommandTypeEq(item.first), item.second.latency, item.second.errors);
+    total.merge(item.second.latency);
+    errors += item.second.errors;
+  }
+  row("total", total, errors);
+  os << "users: " << _config.users << ", elapsed: " << std::setprecision(3)
+     << _elapsed << " s" << std::endl;
+
+  /* Coroutines of the async mode share one thread, allocations of a request
+   * cannot be told apart */
+  if (!_config.async && AllocCounter::isEnabled()) {
+    os << "allocs/req:" << std::setprecision(2);
+    for (auto &item : _results) {
+      const OperationStats &stats = item.second;
+      os << " " << getCommandTypeEq(item.first) << "="
+         << getAllocationsPerRequest(stats) << "/"
+         << (stats.alloc_requests ? stats.alloc_bytes / stats.alloc_requests
+                                  : 0)
+         << "B";
+    }
+    os << std::endl;
+  }
+  if (_config.pool) {
+    _config.pool->printReport(os);
+  }
+  if (_shards) {
+    _shards->printReport(os);
+  }
+  if (_hedge) {
+    _hedge->printReport(os);
+  }
+}
+
+/**
+ * @brief  Writes the results in CSV format, latencies in microseconds
+ * @param  &os: output stream
+ * @retval None
+ */
+void LoadGenerator::writeCsv(std::ostream &os) const {
+  os << "operation,count,errors,mean_us,p50_us,p90_us,p99_us,p999_us,max_us,"
+        "throughput_rps"
+     << std::endl;
+  os << std::fixed << std::setprecision(3);
+  for (auto &item : _results) {
+    const Histogram &latency = item.second.latency;
+    os << getCommandTypeEq(item.first) << "," << latency.count() << ","
+       << item.second.errors << "," << latency.mean() / 1e3 << ","
+       << latency.percentile(50) / 1e3 << "," << latency.percentile(90) / 1e3
+       << "," << latency.percentile(99) / 1e3 << ","
+       << latency.percentile(99.9) / 1e3 << "," << latency.max() / 1e3 << ","
+       << (_elapsed > 0 ? latency.count() / _elapsed : 0.0) << std::endl;
+  }
+}
+
+/**
+ * @brief  Writes the results in JSON format, latencies in microseconds
+ * @param  &os: output stream
+ * @retval None
+ */
+void LoadGenerator::writeJson(std::ostream &os) const {
+  os << std::fixed << std::setprecision(3);
+  os << "{\"users\":" << _config.users << ",\"elapsed_s\":" << _elapsed
+     << ",\"operations\":{";
+  bool first{true};
+  for (auto &item : _results) {
+    const Histogram &latency = item.second.latency;
+    if (!first) {
+      os << ",";
+    }
+    first = false;
+    os << "\"" << getCommandTypeEq(item.first) << "\":{"
+       << "\"count\":" << latency.count()
+       << ",\"errors\":" << item.second.errors
+       << ",\"mean_us\":" << latency.mean() / 1e3
+       << ",\"p50_us\":" << latency.percentile(50) / 1e3
+       << ",\"p90_us\":" << latency.percentile(90) / 1e3
+       << ",\"p99_us\":" << latency.percentile(99) / 1e3
+       << ",\"p999_us\":" << latency.percentile(99.9) / 1e3
+       << ",\"max_us\":" << latency.max() / 1e3 << ",\"throughput_rps\":"
+       << (_elapsed > 0 ? latency.count() / _elapsed : 0.0);
+    if (!_config.async) {
+      const OperationStats &stats = item.second;
+      os << ",\"allocs_per_req\":" << getAllocationsPerRequest(stats)
+         << ",\"alloc_bytes_per_req\":"
+         << (stats.alloc_requests
+                 ? static_cast<double>(stats.alloc_bytes) / stats.alloc_requests
+                 : 0.0);
+    }
+    os << "}";
+  }
+  os << "}}" << std::endl;
+}
@@ -0,0 +1,400 @@
+#include "../include/MailStore.hpp"
+#include "../include/ArgsParser.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+
+const char SNAPSHOT_MAGIC[] = "ISASNAP1";
+const uint64_t MAX_SNAPSHOT_STRING = 1ULL << 32;
+
+/**
+ * @brief  Formats successful response
+ * @param  message: text of the response
+ * @retval Response data
+ */
+std::string MailStore::ok(const std::string message) {
+  return "(ok " + SExpression::quote(message) + ")";
+}
+
+/**
+ * @brief  Formats error response
+ * @param  message: text of the response
+ * @retval Response data
+ */
+std::string MailStore::err(const std::string message) {
+  return "(err " + SExpression::quote(message) + ")";
+}
+
+/**
+ * @brief  Checks that the request has the given number of string arguments
+ * @param  &request: parsed request
+ * @param  count: expected number of arguments
+ * @retval True: arguments are valid | False: arguments are not valid
+ */
+bool MailStore::hasStringArgs(const SExpression &request, size_t count) {
+  if (request.items.size() != count + 1) {
+    return false;
+  }
+  for (size_t i = 1; i < request.items.size(); i++) {
+    if (!request.items[i].isString()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief  Creates new login token of the user
+ * @param  &username: logged in user
+ * @retval Login token
+ */
+std::string MailStore::createToken(const std::string &username) {
+  auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                 std::chrono::system_clock::now().time_since_epoch())
+                 .count();
+  std::string token = ArgsParser::base64Encode(
+      username + std::to_string(now) + "." + std::to_string(++_token_counter));
+  _tokens[token] = username;
+  return token;
+}
+
+/**
+ * @brief  Finds the user the login token belongs to
+ * @param  &token: login token argument of the request
+ * @retval Username, nullptr if the token is not valid
+ */
+const std::string *MailStore::getUser(const SExpression &token) const {
+  if (!token.isString()) {
+    return nullptr;
+  }
+  auto user = _tokens.find(token.value);
+  if (user == _tokens.end()) {
+    return nullptr;
+  }
+  return &user->second;
+}
+
+/**
+ * @brief  Registers new user
+ * @param  &request: (register "<username>" "<base64 password>")
+ * @retval Response data
+ */
+std::string MailStore::handleRegister(const SExpression &request) {
+  if (!hasStringArgs(request, 2)) {
+    return err("wrong arguments");
+  }
+  const std::string &username = request.items[1].value;
+  if (_passwords.count(username)) {
+    return err("user already registered");
+  }
+  _passwords[username] = request.items[2].value;
+  _mailboxes[username];
+  return ok("registered user " + username);
+}
+
+/**
+ * @brief  Logs the user in and issues a login token
+ * @param  &request: (login "<username>" "<base64 password>")
+ * @retval Response data
+ */
+std::string MailStore::handleLogin(const SExpression &request) {
+  if (!hasStringArgs(request, 2)) {
+    return err("wrong arguments");
+  }
+  auto password = _passwords.find(request.items[1].value);
+  if (password == _passwords.end()) {
+    return err("incorrect username");
+  }
+  if (password->second != request.items[2].value) {
+    return err("incorrect password");
+  }
+  return "(ok " + SExpression::quote("user logged in") + " " +
+         SExpression::quote(createToken(password->first)) + ")";
+}
+
+/**
+ * @brief  Lists messages in the mailbox of the user
+ * @param  &request: (list "<token>")
+ * @retval Response data
+ */
+std::string MailStore::handleList(const SExpression &request) const {
+  if (request.items.size() != 2) {
+    return err("wrong arguments");
+  }
+  const std::string *user = getUser(request.items[1]);
+  if (!user) {
+    return err("incorrect login token");
+  }
+
+  const std::vector<Mail> &mailbox = _mailboxes.at(*user);
+  std::string data = "(ok (";
+  for (size_t i = 0; i < mailbox.size(); i++) {
+    if (i) {
+      data += ' ';
+    }
+    data += "(" + std::to_string(i + 1) + " " +
+            SExpression::quote(mailbox[i].sender) + " " +
+            SExpression::quote(mailbox[i].subject) + ")";
+  }
+  data += "))";
+  return data;
+}
+
+/**
+ * @brief  Delivers message to the mailbox of the recipient
+ * @param  &request: (send "<token>" "<recipient>" "<subject>" "<body>")
+ * @retval Response data
+ */
+std::string MailStore::handleSend(const SExpression &request) {
+  if (!hasStringArgs(request, 4)) {
+    return err("wrong arguments");
+  }
+  const std::string *user = getUser(request.items[1]);
+  if (!user) {
+    return err("incorrect login token");
+  }
+  auto mailbox = _mailboxes.find(request.items[2].value);
+  if (mailbox == _mailboxes.end()) {
+    return err("unknown recipient");
+  }
+  mailbox->second.push_back(
+      {*user, request.items[3].value, request.items[4].value});
+  return ok("message sent");
+}
+
+/**
+ * @brief  Returns message from the mailbox of the user
+ * @param  &request: (fetch "<token>" <id>)
+ * @retval Response data
+ */
+std::string MailStore::handleFetch(const SExpression &request) const {
+  if (request.items.size() != 3 || !request.items[2].isAtom()) {
+    return err("wrong arguments");
+  }
+  const std::string *user = getUser(request.items[1]);
+  if (!user) {
+    return err("incorrect login token");
+  }
+
+  const std::string &id = request.items[2].value;
+  if (id.empty() || id.size() > 18 ||
+      id.find_first_not_of("0123456789") != std::string::npos) {
+    return err("wrong arguments");
+  }
+  unsigned long long index = std::stoull(id);
+  if (index == 0) {
+    return err("wrong arguments");
+  }
+  const std::vector<Mail> &mailbox = _mailboxes.at(*user);
+  if (index > mailbox.size()) {
+    return err("message id not found");
+  }
+
+  const Mail &mail = mailbox[index - 1];
+  return "(ok (" + SExpression::quote(mail.sender) + " " +
+         SExpression::quote(mail.subject) + " " +
+         SExpression::quote(mail.body) + "))";
+}
+
+/**
+ * @brief  Invalidates the login token
+ * @param  &request: (logout "<token>")
+ * @retval Response data
+ */
+std::string MailStore::handleLogout(const SExpression &request) {
+  if (request.items.size() != 2) {
+    return err("wrong arguments");
+  }
+  if (!getUser(request.items[1])) {
+    return err("incorrect login token");
+  }
+  _tokens.erase(request.items[1].value);
+  return ok("logged out");
+}
+
+/**
+ * @brief  Parses and answers the request
+ * @param  &data: request data
+ * @retval Response data
+ */
+std::string MailStore::handle(const std::string &data) {
+  SExpression request;
+  if (!SExpression::parse(data, request)) {
+    return err("unknown command");
+  }
+  return handle(request);
+}
+
+/**
+ * @brief  Answers the request according to the command
+ * @param  &request: parsed request
+ * @retval Response data
+ */
+std::string MailStore::handle(const SExpression &request) {
+  if (request.items.empty() || !request.items[0].isAtom()) {
+    return err("unknown command");
+  }
+
+  const std::string &command = request.items[0].value;
+  if (command == "register")
+    return handleRegister(request);
+  if (command == "login")
+    return handleLogin(request);
+  if (command == "list")
+    return handleList(request);
+  if (command == "send")
+    return handleSend(request);
+  if (command == "fetch")
+    return handleFetch(request);
+  if (command == "logout")
+    return handleLogout(request);
+
+  return err("unknown command");
+}
+
+/**
+ * @brief  Writes length prefixed string
+ * @param  &file: output file
+ * @param  &value: written string
+ * @retval None
+ */
+static void writeString(std::ofstream &file, const std::string &value) {
+  uint64_t size = value.size();
+  file.write(reinterpret_cast<const char *>(&size), sizeof(size));
+  file.write(value.data(), value.size());
+}
+
+/**
+ * @brief  Writes number
+ * @param  &file: output file
+ * @param  value: written number
+ * @retval None
+ */
+static void writeNumber(std::ofstream &file, uint64_t value) {
+  file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+/**
+ * @brief  Reads length prefixed string
+ * @param  &file: input file
+ * @param  &value: read string
+ * @retval True: string was read | False: file is damaged
+ */
+static bool readString(std::ifstream &file, std::string &value) {
+  uint64_t size{};
+  if (!file.read(reinterpret_cast<char *>(&size), sizeof(size)) ||
+      size > MAX_SNAPSHOT_STRING) {
+    return false;
+  }
+  value.resize(size);
+  return static_cast<bool>(file.read(&value[0], size));
+}
+
+/**
+ * @brief  Reads number
+ * @param  &file: input file
+ * @param  &value: read number
+ * @retval True: number was read | False: file is damaged
+ */
+static bool readNumber(std::ifstream &file, uint64_t &value) {
+  return static_cast<bool>(
+      file.read(reinterpret_cast<char *>(&value), sizeof(value)));
+}
+
+/**
+ * @brief  Saves users, mailboxes and tokens to the snapshot file, the file is
+ * replaced atomically
+ * @param  filename: snapshot file
+ * @retval True: snapshot saved | False: snapshot could not be saved
+ */
+bool MailStore::save(const std::string filename) const {
+  std::string tmp_filename = filename + ".tmp";
+  {
+    std::ofstream file(tmp_filename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      return false;
+    }
+    file.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC) - 1);
+
+    writeNumber(file, _passwords.size());
+    for (auto &user : _passwords) {
+      writeString(file, user.first);
+      writeString(file, user.second);
+      const std::vector<Mail> &mailbox = _mailboxes.at(user.first);
+      writeNumber(file, mailbox.size());
+      for (auto &mail : mailbox) {
+        writeString(file, mail.sender);
+        writeString(file, mail.subject);
+        writeString(file, mail.body);
+      }
+    }
+
+    writeNumber(file, _tokens.size());
+    for (auto &token : _tokens) {
+      writeString(file, token.first);
+      writeString(file, token.second);
+    }
+    if (!file.flush()) {
+      return false;
+    }
+  }
+  return std::rename(tmp_filename.c_str(), filename.c_str()) == 0;
+}
+
+/**
+ * @brief  Loads users, mailboxes and tokens from the snapshot file
+ * @param  filename: snapshot file
+ * @retval True: snapshot loaded | False: snapshot is missing or damaged
+ */
+bool MailStore::load(const std::string filename) {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open()) {
+    return false;
+  }
+  char magic[sizeof(SNAPSHOT_MAGIC) - 1];
+  if (!file.read(magic, sizeof(magic)) ||
+      std::string(magic, sizeof(magic)) != SNAPSHOT_MAGIC) {
+    return false;
+  }
+
+  MailStore loaded;
+  uint64_t users{};
+  if (!readNumber(file, users)) {
+    return false;
+  }
+  for (uint64_t i = 0; i < users; i++) {
+    std::string username;
+    uint64_t mails{};
+    if (!readString(file, username) ||
+        !readString(file, loaded._passwords[username]) ||
+        !readNumber(file, mails)) {
+      return false;
+    }
+    std::vector<Mail> &mailbox = loaded._mailboxes[username];
+    for (uint64_t j = 0; j < mails; j++) {
+      Mail mail;
+      if (!readString(file, mail.sender) || !readString(file, mail.subject) ||
+          !readString(file, mail.body)) {
+        return false;
+      }
+      mailbox.push_back(mail);
+    }
+  }
+
+  uint64_t tokens{};
+  if (!readNumber(file, tokens)) {
+    return false;
+  }
+  for (uint64_t i = 0; i < tokens; i++) {
+    std::string token;
+    if (!readString(file, token) || !readString(file, loaded._tokens[token])) {
+      return false;
+    }
+  }
+
+  loaded._token_counter = _token_counter;
+  *this = std::move(loaded);
+  return true;
+}
@@ -0,0 +1,824 @@
+#include "../include/MessageIndex.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iterator>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char INDEX_MAGIC[] = "ISAIDX02";
+const size_t INDEX_HEADER_LENGTH = 32;
+/* Header field behind the magic, 0 when nothing is indexed */
+const size_t INDEX_FIRST = 8;
+/* Segment fields, tables and strings of the segment follow the header */
+const size_t SEGMENT_NEXT = 0;
+const size_t SEGMENT_LENGTH = 8;
+const size_t SEGMENT_DOCUMENTS = 12;
+const size_t SEGMENT_TERMS = 16;
+const size_t SEGMENT_HEADER_LENGTH = 24;
+const size_t INDEX_DOCUMENT_LENGTH = 40;
+const size_t INDEX_TERM_LENGTH = 24;
+/* Terms of the message keys start with a byte tokenize never keeps */
+const char INDEX_KEY_PREFIX = '\x01';
+const uint64_t FNV_OFFSET = 14695981039346656037ull;
+const uint64_t FNV_PRIME = 1099511628211ull;
+
+/**
+ * @brief  Computes FNV-1a hash of the message content, tells apart messages
+ * that share the id
+ * @param  &message: fetched message
+ * @retval hash
+ */
+static uint64_t hashMessage(const FetchedMessage &message) {
+  uint64_t hash = FNV_OFFSET;
+  for (auto *field : {&message.sender, &message.subject, &message.body}) {
+    for (unsigned char c : *field) {
+      hash = (hash ^ c) * FNV_PRIME;
+    }
+    /* Field separator, "ab" "c" differs from "a" "bc" */
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+/**
+ * @brief  Appends number to the buffer in the byte order of the machine
+ * @param  &buffer: buffer
+ * @param  value: number
+ * @retval None
+ */
+template <typename T> static void writeNumber(std::string &buffer, T value) {
+  buffer.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+/**
+ * @brief  Appends number to the buffer as varint, 7 bits per byte
+ * @param  &buffer: buffer
+ * @param  value: number
+ * @retval None
+ */
+static void writeVarint(std::string &buffer, uint32_t value) {
+  while (value >= 0x80) {
+    buffer.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  buffer.push_back(static_cast<char>(value));
+}
+
+/**
+ * @brief  Reads varint from the buffer
+ * @param  *&data: position in the buffer, moved past the number
+ * @param  *end: end of the buffer
+ * @param  &value: number
+ * @retval True: number was read | False: buffer ends within the number
+ */
+static bool readVarint(const uint8_t *&data, const uint8_t *end,
+                       uint32_t &value) {
+  value = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (data == end) {
+      return false;
+    }
+    uint8_t byte = *data++;
+    value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief  Returns key term of the message, the message is indexed when the
+ * term is found
+ * @param  &server: name of the server the message was fetched from
+ * @param  &id: id of the message on the server
+ * @param  hash: hash of the message content
+ * @retval key term
+ */
+static std::string getMessageKey(const std::string &server,
+                                 const std::string &id, uint64_t hash) {
+  std::string key(1, INDEX_KEY_PREFIX);
+  key += server;
+  key.push_back('\0');
+  key += id;
+  key.push_back('\0');
+  writeNumber<uint64_t>(key, hash);
+  return key;
+}
+
+/**
+ * @brief  Writes the whole buffer to the file at the offset
+ * @param  fd: file
+ * @param  &data: buffer
+ * @param  offset: position in the file
+ * @retval True: buffer was written | False: writing failed
+ */
+static bool writeAt(int fd, const std::string &data, size_t offset) {
+  size_t written{};
+  while (written < data.size()) {
+    ssize_t result = pwrite(fd, data.data() + written, data.size() - written,
+                            offset + written);
+    if (result == -1 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      return false;
+    }
+    written += result;
+  }
+  return true;
+}
+
+/**
+ * @brief  MessageIndex constructor, maps the index file if there is one
+ * @param  filename: index file
+ * @retval Constructed object
+ */
+MessageIndex::MessageIndex(const std::string filename) : _filename(filename) {
+  map();
+}
+
+/**
+ * @brief  MessageIndex destructor, unmaps the index file
+ * @retval None
+ */
+MessageIndex::~MessageIndex() { unmap(); }
+
+/**
+ * @brief  Maps the index file and follows the chain of its segments, a link
+ * always points further into the file, so the chain ends at the first link
+ * past the mapped part, which belongs to a later update
+ * @retval True: index is mapped | False: there is no valid index
+ */
+bool MessageIndex::map() {
+  _fd = ::open(_filename.c_str(), O_RDONLY);
+  if (_fd == -1) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(_fd, &info) == -1 ||
+      static_cast<size_t>(info.st_size) < INDEX_HEADER_LENGTH) {
+    unmap();
+    return false;
+  }
+  _size = info.st_size;
+  void *mapped = mmap(nullptr, _size, PROT_READ, MAP_SHARED, _fd, 0);
+  if (mapped == MAP_FAILED) {
+    _size = 0;
+    unmap();
+    return false;
+  }
+  _data = static_cast<const uint8_t *>(mapped);
+  if (memcmp(_data, INDEX_MAGIC, sizeof(INDEX_MAGIC) - 1) != 0) {
+    unmap();
+    return false;
+  }
+
+  _end = INDEX_HEADER_LENGTH;
+  size_t offset = read64(INDEX_FIRST);
+  while (offset) {
+    if (offset < _end || offset % 8 ||
+        offset > _size - SEGMENT_HEADER_LENGTH) {
+      break;
+    }
+    IndexSegment segment;
+    segment.offset = offset;
+    segment.end = offset + read32(offset + SEGMENT_LENGTH);
+    segment.base = _document_count;
+    segment.document_count = read32(offset + SEGMENT_DOCUMENTS);
+    segment.term_count = read32(offset + SEGMENT_TERMS);
+    segment.terms_offset =
+        offset + SEGMENT_HEADER_LENGTH +
+        static_cast<size_t>(segment.document_count) * INDEX_DOCUMENT_LENGTH;
+    segment.blob_offset =
+        segment.terms_offset +
+        static_cast<size_t>(segment.term_count) * INDEX_TERM_LENGTH;
+    if (segment.end > _size || segment.blob_offset > segment.end) {
+      break;
+    }
+    _segments.push_back(segment);
+    _document_count += segment.document_count;
+    _live += segment.end - segment.offset;
+    _end = segment.end;
+    offset = read64(offset + SEGMENT_NEXT);
+  }
+  return true;
+}
+
+/**
+ * @brief  Unmaps the index file, the index is empty afterwards
+ * @retval None
+ */
+void MessageIndex::unmap() {
+  if (_data) {
+    munmap(const_cast<uint8_t *>(_data), _size);
+  }
+  if (_fd != -1) {
+    close(_fd);
+  }
+  _fd = -1;
+  _data = nullptr;
+  _size = 0;
+  _segments.clear();
+  _document_count = 0;
+  _end = INDEX_HEADER_LENGTH;
+  _live = 0;
+}
+
+/**
+ * @brief  Opens the index file for an update and locks it against other
+ * processes, the file is created when there is none
+ * @retval locked file | -1: file could not be locked
+ */
+int MessageIndex::lockFile() const {
+  while (true) {
+    int fd = ::open(_filename.c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd == -1) {
+      return -1;
+    }
+    struct stat locked, current;
+    if (flock(fd, LOCK_EX) == -1 || fstat(fd, &locked) == -1) {
+      close(fd);
+      return -1;
+    }
+    /* Compaction by other process replaces the file while this one waits */
+    if (stat(_filename.c_str(), &current) == 0 &&
+        locked.st_dev == current.st_dev && locked.st_ino == current.st_ino) {
+      return fd;
+    }
+    close(fd);
+  }
+}
+
+/**
+ * @brief  Reads 32 bit number of the index
+ * @param  offset: position in the file
+ * @retval number
+ */
+uint32_t MessageIndex::read32(size_t offset) const {
+  uint32_t value;
+  memcpy(&value, _data + offset, sizeof(value));
+  return value;
+}
+
+/**
+ * @brief  Reads 64 bit number of the index
+ * @param  offset: position in the file
+ * @retval number
+ */
+uint64_t MessageIndex::read64(size_t offset) const {
+  uint64_t value;
+  memcpy(&value, _data + offset, sizeof(value));
+  return value;
+}
+
+/**
+ * @brief  Reads string stored after the tables of the segment
+ * @param  &segment: segment
+ * @param  offset: position relative to the start of the strings
+ * @param  length: length of the string
+ * @param  &text: string
+ * @retval True: string was read | False: string lies outside of the segment
+ */
+bool MessageIndex::readBlob(const IndexSegment &segment, uint32_t offset,
+                            uint32_t length, std::string &text) const {
+  if (static_cast<size_t>(offset) + length >
+      segment.end - segment.blob_offset) {
+    return false;
+  }
+  text.assign(
+      reinterpret_cast<const char *>(_data + segment.blob_offset + offset),
+      length);
+  return true;
+}
+
+/**
+ * @brief  Reads entry of the message table
+ * @param  &segment: segment
+ * @param  document: number of the message within the segment
+ * @param  &message: message
+ * @retval True: entry was read | False: entry is damaged
+ */
+bool MessageIndex::readDocument(const IndexSegment &segment, uint32_t document,
+                                IndexedMessage &message) const {
+  size_t offset = segment.offset + SEGMENT_HEADER_LENGTH +
+                  static_cast<size_t>(document) * INDEX_DOCUMENT_LENGTH;
+  message.hash = read64(offset + 32);
+  return readBlob(segment, read32(offset), read32(offset + 4),
+                  message.server) &&
+         readBlob(segment, read32(offset + 8), read32(offset + 12),
+                  message.id) &&
+         readBlob(segment, read32(offset + 16), read32(offset + 20),
+                  message.sender) &&
+         readBlob(segment, read32(offset + 24), read32(offset + 28),
+                  message.subject);
+}
+
+/**
+ * @brief  Reads text of the term table entry
+ * @param  &segment: segment
+ * @param  term: number of the term
+ * @param  &text: term
+ * @retval True: term was read | False: entry is damaged
+ */
+bool MessageIndex::readTerm(const IndexSegment &segment, uint32_t term,
+                            std::string &text) const {
+  size_t offset =
+      segment.terms_offset + static_cast<size_t>(term) * INDEX_TERM_LENGTH;
+  return readBlob(segment, read32(offset), read32(offset + 4), text);
+}
+
+/**
+ * @brief  Decodes posting list of the term, documents and positions are
+ * stored as varint deltas
+ * @param  &segment: segment
+ * @param  term: number of the term
+ * @param  &postings: messages containing the term ordered by number
+ * @retval True: postings were read | False: posting list is damaged
+ */
+bool MessageIndex::readPostings(const IndexSegment &segment, uint32_t term,
+                                std::vector<Posting> &postings) const {
+  size_t offset =
+      segment.terms_offset + static_cast<size_t>(term) * INDEX_TERM_LENGTH;
+  uint32_t count = read32(offset + 8);
+  uint32_t start = read32(offset + 16);
+  uint32_t length = read32(offset + 20);
+  if (static_cast<size_t>(start) + length >
+          segment.end - segment.blob_offset ||
+      count > length) {
+    return false;
+  }
+  const uint8_t *data = _data + segment.blob_offset + start;
+  const uint8_t *end = data + length;
+
+  postings.clear();
+  postings.reserve(count);
+  uint32_t document{};
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t delta, positions;
+    if (!readVarint(data, end, delta) || !readVarint(data, end, positions) ||
+        positions > length) {
+      return false;
+    }
+    document += delta;
+    Posting posting{document, {}};
+    posting.positions.reserve(positions);
+    uint32_t position{};
+    for (uint32_t j = 0; j < positions; j++) {
+      if (!readVarint(data, end, delta)) {
+        return false;
+      }
+      position += delta;
+      posting.positions.push_back(position);
+    }
+    postings.push_back(std::move(posting));
+  }
+  return document < segment.document_count || count == 0;
+}
+
+/**
+ * @brief  Copies messages and posting lists of the segment behind the ones
+ * already read, only the first document delta of every list is re-encoded
+ * @param  &segment: segment
+ * @param  shift: number of the first message of the segment in the copy
+ * @param  &messages: messages of the copy
+ * @param  &terms: posting lists of the copy by term
+ * @retval True: segment was copied | False: segment is damaged
+ */
+bool MessageIndex::readSegment(
+    const IndexSegment &segment, uint32_t shift,
+    std::vector<IndexedMessage> &messages,
+    std::map<std::string, PostingList> &terms) const {
+  for (uint32_t i = 0; i < segment.document_count; i++) {
+    IndexedMessage message;
+    if (!readDocument(segment, i, message)) {
+      return false;
+    }
+    messages.push_back(std::move(message));
+  }
+
+  std::string text;
+  for (uint32_t i = 0; i < segment.term_count; i++) {
+    size_t offset =
+        segment.terms_offset + static_cast<size_t>(i) * INDEX_TERM_LENGTH;
+    uint32_t count = read32(offset + 8);
+    uint32_t start = read32(offset + 16);
+    uint32_t length = read32(offset + 20);
+    if (!readTerm(segment, i, text) ||
+        static_cast<size_t>(start) + length >
+            segment.end - segment.blob_offset) {
+      return false;
+    }
+    const uint8_t *data = _data + segment.blob_offset + start;
+    const uint8_t *end = data + length;
+    uint32_t document;
+    if (!count || !readVarint(data, end, document)) {
+      return false;
+    }
+
+    PostingList &list = terms[text];
+    document += shift;
+    writeVarint(list.data, list.count ? document - list.last : document);
+    list.data.append(reinterpret_cast<const char *>(data), end - data);
+    list.count += count;
+    list.last = read32(offset + 12) + shift;
+  }
+  return true;
+}
+
+/**
+ * @brief  Looks the term up by binary search over the sorted term table
+ * @param  &segment: segment
+ * @param  &term: term
+ * @param  &postings: messages containing the term
+ * @retval True: term is indexed | False: term is unknown
+ */
+bool MessageIndex::findTerm(const IndexSegment &segment,
+                            const std::string &term,
+                            std::vector<Posting> &postings) const {
+  uint32_t low{}, high{segment.term_count};
+  std::string text;
+  while (low < high) {
+    uint32_t middle = low + (high - low) / 2;
+    if (!readTerm(segment, middle, text)) {
+      return false;
+    }
+    if (text == term) {
+      return readPostings(segment, middle, postings);
+    }
+    if (text < term) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief  Finds messages of the segment containing the terms one right after
+ * another
+ * @param  &segment: segment
+ * @param  &terms: terms of the phrase, a single term matches on its own
+ * @retval numbers of the matching messages in ascending order
+ */
+std::vector<uint32_t>
+MessageIndex::matchPhrase(const IndexSegment &segment,
+                          const std::vector<std::string> &terms) const {
+  std::vector<std::vector<Posting>> lists(terms.size());
+  for (size_t i = 0; i < terms.size(); i++) {
+    if (!findTerm(segment, terms[i], lists[i])) {
+      return {};
+    }
+  }
+
+  std::vector<uint32_t> documents;
+  for (auto &first : lists[0]) {
+    /* Positions of the following terms within the same message */
+    std::vector<const std::vector<uint32_t> *> positions{&first.positions};
+    for (size_t i = 1; i < lists.size(); i++) {
+      auto posting = std::lower_bound(
+          lists[i].begin(), lists[i].end(), first.document,
+          [](const Posting &p, uint32_t document) {
+            return p.document < document;
+          });
+      if (posting == lists[i].end() || posting->document != first.document) {
+        break;
+      }
+      positions.push_back(&posting->positions);
+    }
+    if (positions.size() != lists.size()) {
+      continue;
+    }
+    for (auto start : first.positions) {
+      size_t i = 1;
+      while (i < positions.size() &&
+             std::binary_search(positions[i]->begin(), positions[i]->end(),
+                                start + i)) {
+        i++;
+      }
+      if (i == positions.size()) {
+        documents.push_back(first.document);
+        break;
+      }
+    }
+  }
+  return documents;
+}
+
+/**
+ * @brief  Encodes the segment, its link to the next segment is left empty
+ * @param  &messages: messages of the segment
+ * @param  &terms: posting lists by term
+ * @param  &segment: encoded segment padded to 8 bytes
+ * @retval True: segment encoded | False: segment is too large
+ */
+bool MessageIndex::buildSegment(
+    const std::vector<IndexedMessage> &messages,
+    const std::map<std::string, PostingList> &terms, std::string &segment) {
+  std::string tables, blob;
+  auto addString = [&tables, &blob](const std::string &text) {
+    writeNumber<uint32_t>(tables, blob.size());
+    writeNumber<uint32_t>(tables, text.size());
+    blob += text;
+  };
+
+  writeNumber<uint64_t>(tables, 0);
+  writeNumber<uint32_t>(tables, 0);
+  writeNumber<uint32_t>(tables, messages.size());
+  writeNumber<uint32_t>(tables, terms.size());
+  writeNumber<uint32_t>(tables, 0);
+  for (auto &message : messages) {
+    addString(message.server);
+    addString(message.id);
+    addString(message.sender);
+    addString(message.subject);
+    writeNumber<uint64_t>(tables, message.hash);
+  }
+  /* std::map keeps the terms sorted for the binary search */
+  for (auto &term : terms) {
+    addString(term.first);
+    writeNumber<uint32_t>(tables, term.second.count);
+    writeNumber<uint32_t>(tables, term.second.last);
+    writeNumber<uint32_t>(tables, blob.size());
+    writeNumber<uint32_t>(tables, term.second.data.size());
+    blob += term.second.data;
+  }
+
+  segment = std::move(tables);
+  segment += blob;
+  segment.resize((segment.size() + 7) / 8 * 8, '\0');
+  if (segment.size() > UINT32_MAX) {
+    return false;
+  }
+  uint32_t length = segment.size();
+  memcpy(&segment[SEGMENT_LENGTH], &length, sizeof(length));
+  return true;
+}
+
+/**
+ * @brief  Writes the new segment behind the last one and links it, the
+ * trailing segments holding no more messages than the new one together are
+ * folded into it, so sizes at least double towards the start of the chain
+ * and the chain stays short, to be called with the lock held
+ * @param  fd: locked index file
+ * @param  &server: name of the server the message was fetched from
+ * @param  &id: id of the message on the server
+ * @param  &message: fetched message
+ * @retval True: index is up to date | False: index could not be updated
+ */
+bool MessageIndex::append(int fd, const std::string &server,
+                          const std::string &id,
+                          const FetchedMessage &message) {
+  uint64_t hash = hashMessage(message);
+  std::string key = getMessageKey(server, id, hash);
+  std::vector<Posting> postings;
+  for (auto &segment : _segments) {
+    if (findTerm(segment, key, postings)) {
+      return true;
+    }
+  }
+
+  size_t first = _segments.size();
+  uint32_t documents = 1;
+  while (first > 0 && _segments[first - 1].document_count <= documents) {
+    first--;
+    documents += _segments[first].document_count;
+  }
+  uint32_t base =
+      first < _segments.size() ? _segments[first].base : _document_count;
+  std::vector<IndexedMessage> messages;
+  std::map<std::string, PostingList> terms;
+  for (size_t i = first; i < _segments.size(); i++) {
+    if (!readSegment(_segments[i], _segments[i].base - base, messages,
+                     terms)) {
+      return false;
+    }
+  }
+
+  uint32_t document = messages.size();
+  messages.push_back({server, id, message.sender, message.subject, hash});
+  std::map<std::string, std::vector<uint32_t>> occurrences;
+  occurrences[key];
+  uint32_t position{};
+  for (auto *field : {&message.sender, &message.subject, &message.body}) {
+    for (auto &token : tokenize(*field)) {
+      occurrences[token].push_back(position++);
+    }
+    position++;
+  }
+  for (auto &occurrence : occurrences) {
+    /* Documents and positions are stored as varint deltas */
+    PostingList &list = terms[occurrence.first];
+    writeVarint(list.data, list.count ? document - list.last : document);
+    writeVarint(list.data, occurrence.second.size());
+    uint32_t previous{};
+    for (auto next : occurrence.second) {
+      writeVarint(list.data, next - previous);
+      previous = next;
+    }
+    list.count++;
+    list.last = document;
+  }
+
+  std::string segment;
+  if (!buildSegment(messages, terms, segment)) {
+    return false;
+  }
+  if (!_data) {
+    /* No valid index, the file is started over */
+    std::string header(INDEX_MAGIC, sizeof(INDEX_MAGIC) - 1);
+    header.resize(INDEX_HEADER_LENGTH, '\0');
+    if (ftruncate(fd, 0) == -1 || !writeAt(fd, header, 0)) {
+      return false;
+    }
+  }
+  if (!writeAt(fd, segment, _end)) {
+    return false;
+  }
+
+  /* Linking the segment publishes it, folded segments are left unused */
+  std::string link;
+  writeNumber<uint64_t>(link, _end);
+  return writeAt(fd, link,
+                 first > 0 ? _segments[first - 1].offset + SEGMENT_NEXT
+                           : INDEX_FIRST);
+}
+
+/**
+ * @brief  Copies the linked segments to a new file which then replaces the
+ * old one, to be called with the lock held
+ * @retval True: index compacted | False: old file is kept
+ */
+bool MessageIndex::compact() const {
+  std::string data(INDEX_MAGIC, sizeof(INDEX_MAGIC) - 1);
+  writeNumber<uint64_t>(data, _segments.empty() ? 0 : INDEX_HEADER_LENGTH);
+  data.resize(INDEX_HEADER_LENGTH, '\0');
+  for (size_t i = 0; i < _segments.size(); i++) {
+    size_t offset = data.size();
+    size_t length = _segments[i].end - _segments[i].offset;
+    data.append(reinterpret_cast<const char *>(_data + _segments[i].offset),
+                length);
+    uint64_t next = i + 1 < _segments.size() ? offset + length : 0;
+    memcpy(&data[offset + SEGMENT_NEXT], &next, sizeof(next));
+  }
+
+  /* Every process writes its own file */
+  std::string tmp_filename = _filename + ".XXXXXX";
+  int fd = mkstemp(tmp_filename.data());
+  if (fd == -1) {
+    return false;
+  }
+  bool written = writeAt(fd, data, 0);
+  if (close(fd) == -1 || !written ||
+      std::rename(tmp_filename.c_str(), _filename.c_str()) != 0) {
+    unlink(tmp_filename.c_str());
+    return false;
+  }
+  return true;
+}
+
+/**
+ * @brief  Splits the text into lowercase runs of letters and digits, bytes of
+ * UTF-8 sequences are kept within the token
+ * @param  &text: text
+ * @retval tokens in the order of the text
+ */
+std::vector<std::string> MessageIndex::tokenize(const std::string &text) {
+  std::vector<std::string> tokens;
+  std::string token;
+  for (unsigned char c : text) {
+    if (isalnum(c) || c >= 0x80) {
+      token.push_back(static_cast<char>(tolower(c)));
+    } else if (!token.empty()) {
+      tokens.push_back(token);
+      token.clear();
+    }
+  }
+  if (!token.empty()) {
+    tokens.push_back(token);
+  }
+  return tokens;
+}
+
+/**
+ * @brief  Splits the query into clauses which all have to match, a clause is
+ * one word or a phrase in double quotes, the word AND is optional
+ * @param  &query: search query
+ * @retval terms of the clauses
+ */
+std::vector<std::vector<std::string>>
+MessageIndex::parseQuery(const std::string &query) {
+  std::vector<std::vector<std::string>> clauses;
+  size_t position{};
+  while (position < query.size()) {
+    size_t end;
+    std::string clause;
+    if (query[position] == '"') {
+      end = query.find('"', position + 1);
+      clause = query.substr(position + 1, end - position - 1);
+      end = end == std::string::npos ? end : end + 1;
+    } else {
+      end = query.find_first_of(" \t\n\"", position);
+      clause = query.substr(position, end - position);
+      if (clause == "AND") {
+        clause.clear();
+      }
+    }
+    auto terms = tokenize(clause);
+    if (!terms.empty()) {
+      clauses.push_back(terms);
+    }
+    if (end == std::string::npos) {
+      break;
+    }
+    position = query[end] == '"' ? end : end + 1;
+  }
+  return clauses;
+}
+
+/**
+ * @brief  Adds the fetched message to the index unless it is already there,
+ * positions continue across sender, subject and body with a gap in between
+ * so that phrases do not span two fields, only the new message and the
+ * small trailing segments are written, the file is compacted once unused
+ * segments take more space than the linked ones
+ * @param  server: name of the server the message was fetched from
+ * @param  id: id of the message on the server
+ * @param  &message: fetched message
+ * @retval True: index is up to date | False: index could not be saved
+ */
+bool MessageIndex::add(const std::string server, const std::string id,
+                       const FetchedMessage &message) {
+  int fd = lockFile();
+  if (fd == -1) {
+    return false;
+  }
+  /* Other processes may have added messages since the index was mapped */
+  unmap();
+  map();
+  bool added = append(fd, server, id, message);
+  if (added) {
+    unmap();
+    map();
+    if (_end - INDEX_HEADER_LENGTH - _live > _live) {
+      compact();
+    }
+  }
+  flock(fd, LOCK_UN);
+  close(fd);
+  unmap();
+  map();
+  return added;
+}
+
+/**
+ * @brief  Finds messages matching all clauses of the query
+ * @param  &query: search query
+ * @retval matching messages in the order they were indexed
+ */
+std::vector<IndexedMessage>
+MessageIndex::search(const std::string &query) const {
+  auto clauses = parseQuery(query);
+  std::vector<IndexedMessage> messages;
+  for (auto &segment : _segments) {
+    std::vector<uint32_t> documents;
+    for (size_t i = 0; i < clauses.size(); i++) {
+      auto matched = matchPhrase(segment, clauses[i]);
+      if (i == 0) {
+        documents = matched;
+      } else {
+        std::vector<uint32_t> both;
+        std::set_intersection(documents.begin(), documents.end(),
+                              matched.begin(), matched.end(),
+                              std::back_inserter(both));
+        documents.swap(both);
+      }
+      if (documents.empty()) {
+        break;
+      }
+    }
+
+    for (auto document : documents) {
+      IndexedMessage message;
+      if (readDocument(segment, document, message)) {
+        messages.push_back(message);
+      }
+    }
+  }
+  return messages;
+}
+
+/**
+ * @brief  Returns number of indexed messages
+ * @retval number of messages
+ */
+size_t MessageIndex::getMessageCount() const { return _document_count; }
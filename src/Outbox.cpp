@@ -0,0 +1,427 @@
+#include "../include/Outbox.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char OUTBOX_MAGIC[] = "ISAOBX03";
+const size_t OUTBOX_HEADER_LENGTH = 24;
+/* Header fields behind the magic */
+const size_t OUTBOX_TAIL = 8;
+const size_t OUTBOX_SEQUENCE = 16;
+const size_t OUTBOX_ENTRY_LENGTH = 40;
+/* Entry fields, the checksum covers the sequence, lengths and fields */
+const size_t OUTBOX_SEQUENCE_OFFSET = 8;
+const size_t OUTBOX_LENGTHS_OFFSET = 16;
+const size_t OUTBOX_STATE_OFFSET = 36;
+const size_t OUTBOX_FIELDS = 5;
+const uint8_t OUTBOX_PENDING = 0;
+const uint8_t OUTBOX_ACKNOWLEDGED = 1;
+const uint8_t OUTBOX_REJECTED = 2;
+const uint32_t FNV32_OFFSET = 2166136261u;
+const uint32_t FNV32_PRIME = 16777619u;
+
+/**
+ * @brief  Continues FNV-1a hash over the bytes
+ * @param  hash: hash of the preceding bytes
+ * @param  *data: bytes
+ * @param  length: number of bytes
+ * @retval hash
+ */
+static uint32_t hashBytes(uint32_t hash, const uint8_t *data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ data[i]) * FNV32_PRIME;
+  }
+  return hash;
+}
+
+/**
+ * @brief  Outbox constructor, the journal is opened by open
+ * @param  filename: journal file
+ * @retval Constructed object
+ */
+Outbox::Outbox(const std::string filename) : _filename(filename) {}
+
+/**
+ * @brief  Outbox destructor, unmaps the journal and releases its lock
+ * @retval None
+ */
+Outbox::~Outbox() { unmap(); }
+
+/**
+ * @brief  Maps the journal, it is extended to the size first when shorter
+ * @param  size: size of the mapping in bytes
+ * @retval True: journal is mapped | False: mapping failed
+ */
+bool Outbox::map(size_t size) {
+  struct stat info;
+  if (fstat(_fd, &info) == -1 ||
+      (static_cast<size_t>(info.st_size) < size &&
+       ftruncate(_fd, size) == -1)) {
+    return false;
+  }
+  if (_data) {
+    munmap(_data, _size);
+    _data = nullptr;
+    _size = 0;
+  }
+  void *mapped =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+  if (mapped == MAP_FAILED) {
+    return false;
+  }
+  _data = static_cast<uint8_t *>(mapped);
+  _size = size;
+  return true;
+}
+
+/**
+ * @brief  Unmaps and closes the journal
+ * @retval None
+ */
+void Outbox::unmap() {
+  if (_data) {
+    munmap(_data, _size);
+    _data = nullptr;
+    _size = 0;
+  }
+  if (_fd != -1) {
+    close(_fd);
+    _fd = -1;
+  }
+  if (_resume_fd != -1) {
+    close(_resume_fd);
+    _resume_fd = -1;
+  }
+}
+
+/**
+ * @brief  Maps the whole journal again when another process extended it
+ * @retval True: mapping is current | False: mapping failed
+ */
+bool Outbox::refresh() {
+  struct stat info;
+  if (fstat(_fd, &info) == -1) {
+    return false;
+  }
+  return static_cast<size_t>(info.st_size) == _size || map(info.st_size);
+}
+
+/**
+ * @brief  Returns end of the last complete entry
+ * @retval offset in the journal
+ */
+uint64_t Outbox::getTail() const {
+  uint64_t tail;
+  memcpy(&tail, _data + OUTBOX_TAIL, sizeof(tail));
+  return tail;
+}
+
+/**
+ * @brief  Sets end of the last complete entry
+ * @param  tail: offset in the journal
+ * @retval None
+ */
+void Outbox::setTail(uint64_t tail) {
+  memcpy(_data + OUTBOX_TAIL, &tail, sizeof(tail));
+}
+
+/**
+ * @brief  Reads the entry and checks it was completely written
+ * @param  offset: offset of the entry
+ * @param  tail: end of the entries
+ * @param  *entry: read entry, nullptr when only checked
+ * @param  &state: pending or acknowledged
+ * @param  &next: offset of the following entry
+ * @retval True: entry is complete | False: entry is torn or out of the journal
+ */
+bool Outbox::readEntry(uint64_t offset, uint64_t tail, OutboxEntry *entry,
+                       uint8_t &state, uint64_t &next) const {
+  if (offset < OUTBOX_HEADER_LENGTH || offset + OUTBOX_ENTRY_LENGTH > tail ||
+      tail > _size) {
+    return false;
+  }
+  const uint8_t *data = _data + offset;
+  uint32_t size;
+  uint32_t checksum;
+  uint32_t lengths[OUTBOX_FIELDS];
+  memcpy(&size, data, sizeof(size));
+  memcpy(&checksum, data + 4, sizeof(checksum));
+  memcpy(lengths, data + OUTBOX_LENGTHS_OFFSET, sizeof(lengths));
+
+  uint64_t fields_length{};
+  for (auto length : lengths) {
+    fields_length += length;
+  }
+  if (size < OUTBOX_ENTRY_LENGTH + fields_length || offset + size > tail) {
+    return false;
+  }
+  uint32_t hash = hashBytes(FNV32_OFFSET, data + OUTBOX_SEQUENCE_OFFSET,
+                            OUTBOX_STATE_OFFSET - OUTBOX_SEQUENCE_OFFSET);
+  hash = hashBytes(hash, data + OUTBOX_ENTRY_LENGTH, fields_length);
+  if (hash != checksum) {
+    return false;
+  }
+
+  state = data[OUTBOX_STATE_OFFSET];
+  next = offset + size;
+  if (entry) {
+    std::string *fields[] = {&entry->server, &entry->user, &entry->recipient,
+                             &entry->subject, &entry->body};
+    const char *field = reinterpret_cast<const char *>(data) +
+                        OUTBOX_ENTRY_LENGTH;
+    for (size_t i = 0; i < OUTBOX_FIELDS; i++) {
+      fields[i]->assign(field, lengths[i]);
+      field += lengths[i];
+    }
+    entry->ref.offset = offset;
+    memcpy(&entry->ref.sequence, data + OUTBOX_SEQUENCE_OFFSET,
+           sizeof(entry->ref.sequence));
+  }
+  return true;
+}
+
+/**
+ * @brief  Writes the beginning of the journal to the disk, acknowledgements
+ * made so far are part of it
+ * @param  end: end of the written part
+ * @retval True: data is on the disk | False: writing failed
+ */
+bool Outbox::sync(uint64_t end) {
+  if (msync(_data, std::min<uint64_t>(end, _size), MS_SYNC) == -1) {
+    return false;
+  }
+  _unsynced = 0;
+  return true;
+}
+
+/**
+ * @brief  Opens or creates the journal, an entry torn by a crash and the ones
+ * behind it are dropped
+ * @retval True: journal is ready | False: journal is not valid
+ */
+bool Outbox::open() {
+  _fd = ::open(_filename.c_str(), O_RDWR | O_CREAT, 0600);
+  if (_fd == -1 || !lock(true)) {
+    unmap();
+    return false;
+  }
+  struct stat info;
+  bool valid = fstat(_fd, &info) != -1;
+  bool created = valid && static_cast<size_t>(info.st_size) <
+                              OUTBOX_HEADER_LENGTH;
+  valid = valid && map(created ? INITIAL_SIZE : info.st_size);
+  if (valid && created) {
+    memcpy(_data, OUTBOX_MAGIC, sizeof(OUTBOX_MAGIC) - 1);
+    setTail(OUTBOX_HEADER_LENGTH);
+    uint64_t sequence{1};
+    memcpy(_data + OUTBOX_SEQUENCE, &sequence, sizeof(sequence));
+    valid = sync(OUTBOX_HEADER_LENGTH);
+  }
+  valid = valid &&
+          memcmp(_data, OUTBOX_MAGIC, sizeof(OUTBOX_MAGIC) - 1) == 0 &&
+          getTail() >= OUTBOX_HEADER_LENGTH && getTail() <= _size;
+
+  if (valid) {
+    uint64_t tail = getTail();
+    uint64_t offset = OUTBOX_HEADER_LENGTH;
+    uint8_t state;
+    while (offset < tail && readEntry(offset, tail, nullptr, state, offset)) {
+      ;
+    }
+    if (offset != tail) {
+      setTail(offset);
+      valid = sync(OUTBOX_HEADER_LENGTH);
+    }
+  }
+  unlock();
+  if (!valid) {
+    unmap();
+  }
+  return valid;
+}
+
+/**
+ * @brief  Locks the journal against other processes
+ * @param  wait: True: waits for the lock | False: fails when it is held
+ * @retval True: journal is locked | False: lock is held by another process
+ */
+bool Outbox::lock(bool wait) {
+  return flock(_fd, LOCK_EX | (wait ? 0 : LOCK_NB)) == 0;
+}
+
+/**
+ * @brief  Unlocks the journal
+ * @retval None
+ */
+void Outbox::unlock() { flock(_fd, LOCK_UN); }
+
+/**
+ * @brief  Locks resending of the journal until it is closed, the journal
+ * itself stays unlocked so messages can be appended meanwhile
+ * @retval True: resending is locked | False: another process resends
+ */
+bool Outbox::lockResume() {
+  if (_resume_fd == -1) {
+    std::string filename = _filename + ".resume";
+    _resume_fd = ::open(filename.c_str(), O_RDWR | O_CREAT, 0600);
+  }
+  return _resume_fd != -1 && flock(_resume_fd, LOCK_EX | LOCK_NB) == 0;
+}
+
+/**
+ * @brief  Appends the message to the journal and writes it to the disk before
+ * it is sent, the journal grows twice when it is full, the entry gets the
+ * next sequence number, which compaction does not reset
+ * @param  &server: name of the server the message is sent to
+ * @param  &user: user sending the message
+ * @param  &command_args: arguments of the send command
+ * @param  &ref: offset and sequence number of the entry
+ * @retval True: entry is on the disk | False: appending failed
+ */
+bool Outbox::append(const std::string &server, const std::string &user,
+                    const CommandArgs &command_args, OutboxRef &ref) {
+  const std::string *fields[] = {&server, &user,
+                                 &command_args[CommandArg::RECIPIENT],
+                                 &command_args[CommandArg::SUBJECT],
+                                 &command_args[CommandArg::BODY]};
+  uint32_t lengths[OUTBOX_FIELDS];
+  uint64_t size = OUTBOX_ENTRY_LENGTH;
+  for (size_t i = 0; i < OUTBOX_FIELDS; i++) {
+    lengths[i] = static_cast<uint32_t>(fields[i]->size());
+    size += lengths[i];
+  }
+  /* Entries stay aligned to 8 bytes */
+  size = (size + 7) & ~static_cast<uint64_t>(7);
+  if (size > UINT32_MAX || !lock(true)) {
+    return false;
+  }
+
+  bool appended = refresh();
+  uint64_t tail = appended ? getTail() : 0;
+  if (appended && tail + size > _size) {
+    size_t new_size = _size;
+    while (new_size < tail + size) {
+      new_size *= 2;
+    }
+    appended = map(new_size);
+  }
+  if (appended) {
+    uint8_t *data = _data + tail;
+    uint32_t entry_size = static_cast<uint32_t>(size);
+    uint64_t sequence;
+    memcpy(&sequence, _data + OUTBOX_SEQUENCE, sizeof(sequence));
+    memset(data, 0, OUTBOX_ENTRY_LENGTH);
+    memcpy(data, &entry_size, sizeof(entry_size));
+    memcpy(data + OUTBOX_SEQUENCE_OFFSET, &sequence, sizeof(sequence));
+    memcpy(data + OUTBOX_LENGTHS_OFFSET, lengths, sizeof(lengths));
+    data[OUTBOX_STATE_OFFSET] = OUTBOX_PENDING;
+    uint8_t *field = data + OUTBOX_ENTRY_LENGTH;
+    for (auto *text : fields) {
+      memcpy(field, text->data(), text->size());
+      field += text->size();
+    }
+    uint32_t checksum =
+        hashBytes(FNV32_OFFSET, data + OUTBOX_SEQUENCE_OFFSET,
+                  OUTBOX_STATE_OFFSET - OUTBOX_SEQUENCE_OFFSET);
+    checksum = hashBytes(checksum, data + OUTBOX_ENTRY_LENGTH,
+                         field - data - OUTBOX_ENTRY_LENGTH);
+    memcpy(data + 4, &checksum, sizeof(checksum));
+    setTail(tail + size);
+    sequence++;
+    memcpy(_data + OUTBOX_SEQUENCE, &sequence, sizeof(sequence));
+
+    /* One fsync covers the entry, the tail and earlier acknowledgements, a
+     * torn entry fails its checksum when the journal is opened */
+    appended = sync(tail + size);
+    ref = {tail, sequence - 1};
+  }
+  unlock();
+  return appended;
+}
+
+/**
+ * @brief  Marks the entry answered in place under the lock, the disk is
+ * written once per group of acknowledgements or by the next append, nothing
+ * is marked when the journal was compacted and the offset holds another
+ * entry
+ * @param  &ref: offset and sequence number of the entry
+ * @param  accepted: True: server accepted the message | False: server
+ * rejected it, it is not sent again either
+ * @retval None
+ */
+void Outbox::acknowledge(const OutboxRef &ref, bool accepted) {
+  if (!lock(true)) {
+    return;
+  }
+  OutboxEntry entry;
+  uint8_t state;
+  uint64_t next;
+  if (refresh() && readEntry(ref.offset, getTail(), &entry, state, next) &&
+      entry.ref.sequence == ref.sequence) {
+    _data[ref.offset + OUTBOX_STATE_OFFSET] =
+        accepted ? OUTBOX_ACKNOWLEDGED : OUTBOX_REJECTED;
+    if (++_unsynced >= GROUP_COMMIT) {
+      commit();
+    }
+  }
+  unlock();
+}
+
+/**
+ * @brief  Writes acknowledgements made so far to the disk, to be called with
+ * the lock held
+ * @retval True: acknowledgements are on the disk | False: writing failed
+ */
+bool Outbox::commit() { return !_unsynced || sync(getTail()); }
+
+/**
+ * @brief  Returns entries the user sent to the server and that are not
+ * acknowledged yet, to be called with the lock held
+ * @param  &server: name of the server
+ * @param  &user: user who sent the messages
+ * @retval pending entries in the order they were appended
+ */
+std::vector<OutboxEntry> Outbox::getPending(const std::string &server,
+                                            const std::string &user) {
+  std::vector<OutboxEntry> entries;
+  if (!refresh()) {
+    return entries;
+  }
+  uint64_t tail = getTail();
+  uint64_t offset = OUTBOX_HEADER_LENGTH;
+  OutboxEntry entry;
+  uint8_t state;
+  while (offset < tail && readEntry(offset, tail, &entry, state, offset)) {
+    if (state == OUTBOX_PENDING && entry.server == server &&
+        entry.user == user) {
+      entries.push_back(entry);
+    }
+  }
+  return entries;
+}
+
+/**
+ * @brief  Empties the journal when no entry is pending, to be called
+ * with the lock held, the file keeps its size for the next entries
+ * @retval True: journal is consistent | False: writing failed
+ */
+bool Outbox::compact() {
+  if (!refresh() || !commit()) {
+    return false;
+  }
+  uint64_t tail = getTail();
+  uint64_t offset = OUTBOX_HEADER_LENGTH;
+  uint8_t state;
+  while (offset < tail && readEntry(offset, tail, nullptr, state, offset)) {
+    if (state == OUTBOX_PENDING) {
+      return true;
+    }
+  }
+  setTail(OUTBOX_HEADER_LENGTH);
+  return sync(OUTBOX_HEADER_LENGTH);
+}
@@ -0,0 +1,367 @@
+#include "../include/PcapReader.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const uint32_t PCAP_MAGIC = 0xa1b2c3d4;
+const uint32_t PCAP_MAGIC_NANO = 0xa1b23c4d;
+const size_t PCAP_HEADER_LENGTH = 24;
+const size_t PCAP_RECORD_HEADER_LENGTH = 16;
+
+const uint32_t PCAPNG_SECTION_HEADER = 0x0a0d0d0a;
+const uint32_t PCAPNG_BYTE_ORDER_MAGIC = 0x1a2b3c4d;
+const uint32_t PCAPNG_INTERFACE_DESCRIPTION = 1;
+const uint32_t PCAPNG_OBSOLETE_PACKET = 2;
+const uint32_t PCAPNG_SIMPLE_PACKET = 3;
+const uint32_t PCAPNG_ENHANCED_PACKET = 6;
+const uint16_t PCAPNG_OPTION_TSRESOL = 9;
+
+const uint32_t LINKTYPE_NULL = 0;
+const uint32_t LINKTYPE_ETHERNET = 1;
+const uint32_t LINKTYPE_RAW = 101;
+const uint32_t LINKTYPE_LINUX_SLL = 113;
+const uint32_t LINKTYPE_LINUX_SLL2 = 276;
+
+/**
+ * @brief  PcapReader destructor, unmaps the file
+ * @retval None
+ */
+PcapReader::~PcapReader() {
+  if (_data) {
+    munmap(const_cast<uint8_t *>(_data), _size);
+  }
+  if (_fd != -1) {
+    close(_fd);
+  }
+}
+
+/**
+ * @brief  Reads 16 bit number in byte order of the file
+ * @param  offset: position in the file
+ * @retval number
+ */
+uint16_t PcapReader::read16(size_t offset) const {
+  uint16_t value = static_cast<uint16_t>(_data[offset] |
+                                         (_data[offset + 1] << 8));
+  return _swapped ? static_cast<uint16_t>((value >> 8) | (value << 8)) : value;
+}
+
+/**
+ * @brief  Reads 32 bit number in byte order of the file
+ * @param  offset: position in the file
+ * @retval number
+ */
+uint32_t PcapReader::read32(size_t offset) const {
+  uint32_t value = static_cast<uint32_t>(_data[offset]) |
+                   (static_cast<uint32_t>(_data[offset + 1]) << 8) |
+                   (static_cast<uint32_t>(_data[offset + 2]) << 16) |
+                   (static_cast<uint32_t>(_data[offset + 3]) << 24);
+  return _swapped ? __builtin_bswap32(value) : value;
+}
+
+/**
+ * @brief  Maps the capture file and checks its header
+ * @param  filename: pcap file
+ * @retval True: file is a pcap capture | False: file could not be read
+ */
+bool PcapReader::open(const std::string filename) {
+  _fd = ::open(filename.c_str(), O_RDONLY);
+  if (_fd == -1) {
+    return false;
+  }
+  struct stat info;
+  if (fstat(_fd, &info) == -1 ||
+      static_cast<size_t>(info.st_size) < PCAP_HEADER_LENGTH) {
+    return false;
+  }
+  _size = info.st_size;
+  void *mapped = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+  if (mapped == MAP_FAILED) {
+    _size = 0;
+    return false;
+  }
+  _data = static_cast<const uint8_t *>(mapped);
+  madvise(mapped, _size, MADV_SEQUENTIAL);
+
+  /* Magic number decides byte order and timestamp precision */
+  uint32_t magic = read32(0);
+  if (magic == PCAPNG_SECTION_HEADER) {
+    _ng = true;
+    _offset = 0;
+    return true;
+  }
+  if (magic == __builtin_bswap32(PCAP_MAGIC) ||
+      magic == __builtin_bswap32(PCAP_MAGIC_NANO)) {
+    _swapped = true;
+    magic = __builtin_bswap32(magic);
+  }
+  if (magic != PCAP_MAGIC && magic != PCAP_MAGIC_NANO) {
+    return false;
+  }
+  _nano = magic == PCAP_MAGIC_NANO;
+  _linktype = read32(20) & 0x0fffffff;
+  _offset = PCAP_HEADER_LENGTH;
+  return true;
+}
+
+/**
+ * @brief  Returns next packet of the capture
+ * @param  &packet: read packet
+ * @retval True: packet was read | False: end of the capture
+ */
+bool PcapReader::next(CapturedPacket &packet) {
+  return _ng ? nextPcapng(packet) : nextPcap(packet);
+}
+
+/**
+ * @brief  Returns position of the reader in the file
+ * @retval offset in bytes
+ */
+size_t PcapReader::getOffset() const { return _offset; }
+
+/**
+ * @brief  Returns size of the capture file
+ * @retval size in bytes
+ */
+size_t PcapReader::getSize() const { return _size; }
+
+/**
+ * @brief  Returns next packet record of the pcap capture
+ * @param  &packet: read packet
+ * @retval True: packet was read | False: end of the capture
+ */
+bool PcapReader::nextPcap(CapturedPacket &packet) {
+  if (_offset + PCAP_RECORD_HEADER_LENGTH > _size) {
+    return false;
+  }
+  uint64_t seconds = read32(_offset);
+  uint64_t fraction = read32(_offset + 4);
+  uint32_t captured = read32(_offset + 8);
+  _offset += PCAP_RECORD_HEADER_LENGTH;
+  if (_offset + captured > _size) {
+    return false;
+  }
+
+  packet.timestamp =
+      seconds * 1000000000ULL + (_nano ? fraction : fraction * 1000);
+  packet.linktype = _linktype;
+  packet.length = captured;
+  packet.data = _data + _offset;
+  _offset += captured;
+  return true;
+}
+
+/**
+ * @brief  Reads interface description block of the pcapng capture
+ * @param  offset: start of the block body
+ * @param  length: length of the block body
+ * @retval None
+ */
+void PcapReader::readInterface(size_t offset, size_t length) {
+  CaptureInterface interface;
+  if (length < 8) {
+    _interfaces.push_back(interface);
+    return;
+  }
+  interface.linktype = read16(offset);
+
+  /* Options follow link type, reserved field and snap length */
+  size_t option = offset + 8;
+  size_t end = offset + length;
+  while (option + 4 <= end) {
+    uint16_t code = read16(option);
+    uint16_t option_length = read16(option + 2);
+    if (code == 0 || option + 4 + option_length > end) {
+      break;
+    }
+    if (code == PCAPNG_OPTION_TSRESOL && option_length >= 1) {
+      uint8_t resolution = _data[option + 4];
+      uint64_t units{1};
+      for (int i = 0; i < (resolution & 0x7f) && units < 1000000000000ULL;
+           i++) {
+        units *= (resolution & 0x80) ? 2 : 10;
+      }
+      interface.units_per_second = units;
+    }
+    option += 4 + ((option_length + 3) & ~3u);
+  }
+  _interfaces.push_back(interface);
+}
+
+/**
+ * @brief  Returns next packet block of the pcapng capture, other blocks are
+ * processed or skipped on the way
+ * @param  &packet: read packet
+ * @retval True: packet was read | False: end of the capture
+ */
+bool PcapReader::nextPcapng(CapturedPacket &packet) {
+  while (_offset + 12 <= _size) {
+    uint32_t type = read32(_offset);
+    if (type == PCAPNG_SECTION_HEADER) {
+      /* Every section may have its own byte order and interfaces */
+      uint32_t magic = read32(_offset + 8);
+      if (magic != PCAPNG_BYTE_ORDER_MAGIC) {
+        _swapped = !_swapped;
+        if (read32(_offset + 8) != PCAPNG_BYTE_ORDER_MAGIC) {
+          return false;
+        }
+      }
+      _interfaces.clear();
+    }
+
+    uint32_t length = read32(_offset + 4);
+    if (length < 12 || (length & 3) || _offset + length > _size) {
+      return false;
+    }
+    size_t body = _offset + 8;
+    size_t body_length = length - 12;
+    _offset += length;
+
+    switch (type) {
+    case PCAPNG_INTERFACE_DESCRIPTION:
+      readInterface(body, body_length);
+      break;
+    case PCAPNG_ENHANCED_PACKET:
+    case PCAPNG_OBSOLETE_PACKET: {
+      if (body_length < 20) {
+        break;
+      }
+      uint32_t interface_id = type == PCAPNG_ENHANCED_PACKET
+                                  ? read32(body)
+                                  : read16(body);
+      uint32_t captured = read32(body + 12);
+      if (interface_id >= _interfaces.size() || captured > body_length - 20) {
+        break;
+      }
+      const CaptureInterface &interface = _interfaces[interface_id];
+      uint64_t units = (static_cast<uint64_t>(read32(body + 4)) << 32) |
+                       read32(body + 8);
+      packet.timestamp = static_cast<uint64_t>(
+          static_cast<unsigned __int128>(units) * 1000000000ULL /
+          interface.units_per_second);
+      packet.linktype = interface.linktype;
+      packet.length = captured;
+      packet.data = _data + body + 20;
+      return true;
+    }
+    case PCAPNG_SIMPLE_PACKET: {
+      if (body_length < 4 || _interfaces.empty()) {
+        break;
+      }
+      uint32_t original = read32(body);
+      packet.timestamp = 0;
+      packet.linktype = _interfaces[0].linktype;
+      packet.length = original < body_length - 4 ? original : body_length - 4;
+      packet.data = _data + body + 4;
+      return true;
+    }
+    default:
+      break;
+    }
+  }
+  return false;
+}
+
+/**
+ * @brief  Decodes link, network and transport layer of the packet
+ * @param  &packet: captured packet
+ * @param  &segment: decoded TCP segment
+ * @retval True: packet is a TCP segment | False: packet is something else
+ */
+bool PcapReader::decodeTcp(const CapturedPacket &packet, TcpSegment &segment) {
+  const uint8_t *data = packet.data;
+  size_t length = packet.length;
+  size_t offset{};
+  uint16_t ethertype{};
+
+  /* Link layer */
+  switch (packet.linktype) {
+  case LINKTYPE_ETHERNET:
+    if (length < 14)
+      return false;
+    ethertype = static_cast<uint16_t>((data[12] << 8) | data[13]);
+    offset = 14;
+    while ((ethertype == 0x8100 || ethertype == 0x88a8) &&
+           length >= offset + 4) {
+      ethertype = static_cast<uint16_t>((data[offset + 2] << 8) |
+                                        data[offset + 3]);
+      offset += 4;
+    }
+    break;
+  case LINKTYPE_LINUX_SLL:
+    if (length < 16)
+      return false;
+    ethertype = static_cast<uint16_t>((data[14] << 8) | data[15]);
+    offset = 16;
+    break;
+  case LINKTYPE_LINUX_SLL2:
+    if (length < 20)
+      return false;
+    ethertype = static_cast<uint16_t>((data[0] << 8) | data[1]);
+    offset = 20;
+    break;
+  case LINKTYPE_NULL:
+  case LINKTYPE_RAW:
+    offset = packet.linktype == LINKTYPE_NULL ? 4 : 0;
+    if (length <= offset)
+      return false;
+    ethertype = (data[offset] >> 4) == 6 ? 0x86dd : 0x0800;
+    break;
+  default:
+    return false;
+  }
+
+  /* Network layer */
+  char address[INET6_ADDRSTRLEN];
+  size_t end = length;
+  if (ethertype == 0x0800) {
+    if (length < offset + 20 || data[offset + 9] != IPPROTO_TCP)
+      return false;
+    size_t header = (data[offset] & 0x0f) * 4;
+    size_t total = static_cast<size_t>((data[offset + 2] << 8) |
+                                       data[offset + 3]);
+    if (offset + total < end && total >= header)
+      end = offset + total;
+    inet_ntop(AF_INET, data + offset + 12, address, sizeof(address));
+    segment.source = address;
+    inet_ntop(AF_INET, data + offset + 16, address, sizeof(address));
+    segment.destination = address;
+    offset += header;
+  } else if (ethertype == 0x86dd) {
+    /* Extension headers are not expected in the captures */
+    if (length < offset + 40 || data[offset + 6] != IPPROTO_TCP)
+      return false;
+    size_t payload = static_cast<size_t>((data[offset + 4] << 8) |
+                                         data[offset + 5]);
+    if (offset + 40 + payload < end)
+      end = offset + 40 + payload;
+    inet_ntop(AF_INET6, data + offset + 8, address, sizeof(address));
+    segment.source = address;
+    inet_ntop(AF_INET6, data + offset + 24, address, sizeof(address));
+    segment.destination = address;
+    offset += 40;
+  } else {
+    return false;
+  }
+
+  /* Transport layer */
+  if (end < offset + 20)
+    return false;
+  const uint8_t *tcp = data + offset;
+  size_t header = (tcp[12] >> 4) * 4;
+  if (end < offset + header)
+    return false;
+  segment.timestamp = packet.timestamp;
+  segment.source_port = static_cast<uint16_t>((tcp[0] << 8) | tcp[1]);
+  segment.destination_port = static_cast<uint16_t>((tcp[2] << 8) | tcp[3]);
+  segment.sequence = (static_cast<uint32_t>(tcp[4]) << 24) |
+                     (static_cast<uint32_t>(tcp[5]) << 16) |
+                     (static_cast<uint32_t>(tcp[6]) << 8) | tcp[7];
+  segment.flags = tcp[13];
+  segment.payload = tcp + header;
+  segment.length = static_cast<uint32_t>(end - offset - header);
+  return true;
+}
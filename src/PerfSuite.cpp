@@ -0,0 +1,354 @@
+#include "../include/PerfSuite.hpp"
+#include "../include/Client.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+/**
+ * @brief  Runs the benchmark in rounds after one warm-up iteration growing
+ * the buffers, a round repeats it until it takes at least the round time
+ * @param  &&benchmark: callable running one iteration
+ * @retval nanoseconds of one iteration in the fastest round
+ */
+template <typename F> double PerfSuite::measure(F &&benchmark) {
+  benchmark();
+  double best{};
+  for (int round = 0; round < ROUNDS; round++) {
+    uint64_t iterations{};
+    uint64_t elapsed{};
+    auto start = std::chrono::steady_clock::now();
+    do {
+      benchmark();
+      iterations++;
+      elapsed = static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::steady_clock::now() - start)
+              .count());
+    } while (elapsed < ROUND_TIME);
+    double time = static_cast<double>(elapsed) / iterations;
+    if (!round || time < best) {
+      best = time;
+    }
+  }
+  return best;
+}
+
+/**
+ * @brief  Adds result of the microbenchmark
+ * @param  name: name of the benchmark
+ * @param  size: size of the input in bytes
+ * @param  nanoseconds: time of one iteration
+ * @retval None
+ */
+void PerfSuite::add(const std::string name, size_t size, double nanoseconds) {
+  std::string metric = "micro." + name + "." + getSizeName(size);
+  _metrics[metric] = nanoseconds;
+  _sizes[metric] = size;
+}
+
+/**
+ * @brief  Returns short name of the size, e.g. 64KB
+ * @param  size: size in bytes
+ * @retval name of the size
+ */
+std::string PerfSuite::getSizeName(size_t size) {
+  if (size >= 1 << 20 && size % (1 << 20) == 0) {
+    return std::to_string(size >> 20) + "MB";
+  }
+  if (size >= 1 << 10 && size % (1 << 10) == 0) {
+    return std::to_string(size >> 10) + "KB";
+  }
+  return std::to_string(size) + "B";
+}
+
+/**
+ * @brief  Generates message body of the size, every line contains quotes,
+ * a backslash and a written out newline to be escaped
+ * @param  size: size in bytes
+ * @retval message body
+ */
+std::string PerfSuite::makeBody(size_t size) {
+  const std::string line = "Lorem ipsum \"dolor\" sit amet, C:\\mail\\n";
+  std::string body;
+  body.reserve(size + line.size());
+  while (body.size() < size) {
+    body += line;
+  }
+  body.resize(size);
+  /* Cut off escape would escape the closing quote of the argument */
+  if (!body.empty() && body.back() == '\\') {
+    body.back() = 'x';
+  }
+  return body;
+}
+
+/**
+ * @brief  Generates server message of the list type of the size
+ * @param  size: size in bytes
+ * @retval message data from the server
+ */
+std::string PerfSuite::makeList(size_t size) {
+  std::string message = "(ok (";
+  message.reserve(size + 128);
+  for (size_t id = 1; message.size() < size; id++) {
+    if (id > 1) {
+      message += ' ';
+    }
+    message += '(';
+    message += std::to_string(id);
+    message += " \"perf\" \"Weekly report \\\"";
+    message += std::to_string(id);
+    message += "\\\" of the benchmark\")";
+  }
+  message += "))";
+  return message;
+}
+
+/**
+ * @brief  Generates server message of the fetch type containing the body
+ * @param  &body: message body
+ * @retval message data from the server
+ */
+std::string PerfSuite::makeFetch(const std::string &body) {
+  std::string message = "(ok (\"perf\" \"Weekly report\" \"";
+  appendEscaped(message, body);
+  message += "\"))";
+  return message;
+}
+
+/**
+ * @brief  Runs microbenchmarks of encoding, escaping, base64 and parsing on
+ * synthetic data of every size, buffers are reused like in the client
+ * @param  &sizes: sizes of the data in bytes
+ * @retval None
+ */
+void PerfSuite::runMicro(const std::vector<size_t> &sizes) {
+  const std::string token = ArgsParser::base64Encode("perf-token");
+
+  for (size_t size : sizes) {
+    std::string body = makeBody(size);
+    {
+      CommandArgs command_args;
+      command_args[CommandArg::RECIPIENT] = "perf";
+      command_args[CommandArg::SUBJECT] = "Weekly report";
+      command_args[CommandArg::BODY] = body;
+      std::string data;
+      add("encode", size, measure([&]() {
+            Client::getFormattedData(CommandType::SEND, command_args, token,
+                                     data);
+            _sink += data.size();
+          }));
+    }
+    {
+      std::string data;
+      add("escape", size, measure([&]() {
+            data.clear();
+            appendEscaped(data, body);
+            _sink += data.size();
+          }));
+    }
+    {
+      std::string message = "(ok \"";
+      appendEscaped(message, body);
+      message += "\")";
+      std::string content;
+      add("unescape", size, measure([&]() {
+            Client::parseMessageContent(message, content);
+            _sink += content.size();
+          }));
+    }
+    add("base64", size, measure([&]() {
+          _sink += ArgsParser::base64Encode(body).size();
+        }));
+    {
+      std::string message = makeFetch(body);
+      FetchedMessage fetched;
+      add("parse_fetch", size, measure([&]() {
+            Client::parseFetch(message, fetched);
+            _sink += fetched.body.size();
+          }));
+    }
+    {
+      std::string message = makeList(size);
+      std::vector<ListEntry> entries;
+      add("parse_list", size, measure([&]() {
+            Client::parseList(message, entries);
+            _sink += entries.size();
+          }));
+    }
+  }
+}
+
+/**
+ * @brief  Runs the load generator against the server, latencies of every
+ * operation and time per request become metrics, steady-state allocations
+ * are kept for the allocation check
+ * @param  &config: load generator settings
+ * @retval None
+ */
+void PerfSuite::runEndToEnd(const LoadConfig &config) {
+  LoadGenerator generator(config);
+  generator.run();
+  for (auto &item : generator.getResults()) {
+    _allocations[getCommandTypeEq(item.first)] =
+        LoadGenerator::getAllocationsPerRequest(item.second);
+  }
+
+  uint64_t count{};
+  for (auto &item : generator.getResults()) {
+    const Histogram &latency = item.second.latency;
+    std::string prefix = "e2e." + getCommandTypeEq(item.first);
+    _metrics[prefix + ".mean_us"] = latency.mean() / 1e3;
+    _metrics[prefix + ".p50_us"] = latency.percentile(50) / 1e3;
+    count += latency.count();
+  }
+  if (count) {
+    _metrics["e2e.total.us_per_req"] = generator.getElapsed() * 1e6 / count;
+  }
+}
+
+/**
+ * @brief  Reads metrics from the results in JSON format written by writeJson
+ * @param  filename: input file
+ * @param  &metrics: read metrics
+ * @retval True: metrics were read | False: file is missing or malformed
+ */
+bool PerfSuite::readJson(const std::string filename,
+                         std::map<std::string, double> &metrics) {
+  std::ifstream file(filename);
+  if (!file.is_open()) {
+    return false;
+  }
+  std::stringstream s_file;
+  s_file << file.rdbuf();
+  std::string data = s_file.str();
+
+  const std::string header = "\"metrics\":{";
+  size_t position = data.find(header);
+  if (position == std::string::npos) {
+    return false;
+  }
+  position = data.find_first_not_of(" \n", position + header.size());
+  while (position != std::string::npos && data[position] != '}') {
+    size_t name_start = position;
+    size_t name_end = data.find('"', name_start + 1);
+    if (data[name_start] != '"' || name_end == std::string::npos ||
+        name_end + 1 >= data.size() || data[name_end + 1] != ':') {
+      return false;
+    }
+    const char *value = data.c_str() + name_end + 2;
+    char *value_end;
+    double number = std::strtod(value, &value_end);
+    if (value_end == value) {
+      return false;
+    }
+    metrics[data.substr(name_start + 1, name_end - name_start - 1)] = number;
+    position = value_end - data.c_str();
+    if (position < data.size() && data[position] == ',') {
+      position++;
+    }
+    position = data.find_first_not_of(" \n", position);
+  }
+  return position != std::string::npos;
+}
+
+/**
+ * @brief  Writes the metrics in JSON format, times in nanoseconds for
+ * microbenchmarks and microseconds for the end to end benchmark
+ * @param  &os: output stream
+ * @retval None
+ */
+void PerfSuite::writeJson(std::ostream &os) const {
+  os << std::fixed << std::setprecision(3) << "{\"metrics\":{";
+  bool first{true};
+  for (auto &item : _metrics) {
+    if (!first) {
+      os << ",";
+    }
+    first = false;
+    os << "\n\"" << item.first << "\":" << item.second;
+  }
+  os << "\n}}" << std::endl;
+}
+
+/**
+ * @brief  Prints human readable results, throughput of microbenchmarks in
+ * megabytes per second
+ * @param  &os: output stream
+ * @retval None
+ */
+void PerfSuite::printReport(std::ostream &os) const {
+  os << std::left << std::setw(32) << "metric" << std::right << std::setw(16)
+     << "value" << std::setw(12) << "MB/s" << std::endl;
+  for (auto &item : _metrics) {
+    os << std::left << std::setw(32) << item.first << std::right << std::fixed
+       << std::setprecision(3) << std::setw(16) << item.second;
+    auto size = _sizes.find(item.first);
+    if (size != _sizes.end()) {
+      os << std::setprecision(1) << std::setw(12)
+         << size->second * 1e3 / item.second;
+    }
+    os << std::endl;
+  }
+  if (!_allocations.empty()) {
+    os << "allocs/req:" << std::setprecision(2);
+    for (auto &item : _allocations) {
+      os << " " << item.first << "=" << item.second;
+    }
+    os << std::endl;
+  }
+}
+
+/**
+ * @brief  Checks that steady-state requests of every operation of the end
+ * to end benchmark stay within the allocation limit
+ * @param  limit: allowed average allocations per request
+ * @param  &os: output stream receiving the exceeding operations
+ * @retval number of operations allocating more than the limit
+ */
+size_t PerfSuite::checkAllocations(double limit, std::ostream &os) const {
+  size_t exceeded{};
+  for (auto &item : _allocations) {
+    if (item.second > limit) {
+      os << "ERR: " << item.first << " makes " << item.second
+         << " allocations per request :(" << std::endl;
+      exceeded++;
+    }
+  }
+  return exceeded;
+}
+
+/**
+ * @brief  Compares the metrics with the baseline, metrics missing in either
+ * of them are skipped
+ * @param  &baseline: metrics of the baseline
+ * @param  threshold: allowed slowdown in percent
+ * @param  &os: output stream
+ * @retval number of metrics slower than the threshold allows
+ */
+size_t PerfSuite::compare(const std::map<std::string, double> &baseline,
+                          double threshold, std::ostream &os) const {
+  size_t compared{};
+  size_t regressed{};
+  for (auto &item : baseline) {
+    auto current = _metrics.find(item.first);
+    if (current == _metrics.end() || item.second <= 0) {
+      continue;
+    }
+    compared++;
+    double change = (current->second / item.second - 1) * 100;
+    if (change > threshold) {
+      regressed++;
+      os << "REGRESSION " << item.first << ": " << std::fixed
+         << std::setprecision(3) << item.second << " -> " << current->second
+         << " (" << std::showpos << std::setprecision(1) << change << "%)"
+         << std::noshowpos << std::endl;
+    }
+  }
+  os << "compared " << compared << " metrics with the baseline, " << regressed
+     << " slower by more than " << threshold << "%" << std::endl;
+  return regressed;
+}
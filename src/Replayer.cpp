@@ -0,0 +1,270 @@
+#include "../include/Replayer.hpp"
+#include "../include/CommunicationBase.hpp"
+#include "../include/Histogram.hpp"
+#include "../include/PcapReader.hpp"
+#include "../include/TcpReassembler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <thread>
+
+/**
+ * @brief  Replayer constructor
+ * @param  address: address of the target server
+ * @param  isV6: IPv6 flag
+ * @param  port: port of the target server
+ * @retval Constructed object
+ */
+Replayer::Replayer(std::string address, bool isV6, int port)
+    : _address(address), _is_v6(isV6), _port(port) {}
+
+/**
+ * @brief  Sets trace collecting spans of replayed requests
+ * @param  *trace: trace writer, nullptr disables tracing
+ * @retval None
+ */
+void Replayer::setTrace(TraceWriter *trace) {
+  _trace = trace;
+  if (_trace) {
+    _trace->setTrackName(1, "replay");
+  }
+}
+
+/**
+ * @brief  Extracts client requests and server responses from the capture
+ * @param  filename: pcap file
+ * @param  capture_port: server port in the capture
+ * @retval True: capture was read | False: capture could not be read
+ */
+bool Replayer::load(const std::string filename, uint16_t capture_port) {
+  PcapReader reader;
+  if (!reader.open(filename)) {
+    return false;
+  }
+
+  TcpReassembler reassembler(capture_port, [this](TcpFlow &flow) {
+    std::vector<StreamMessage> requests = flow.request.messages();
+    std::vector<StreamMessage> responses = flow.response.messages();
+    for (size_t i = 0; i < requests.size(); i++) {
+      ReplayRequest request;
+      request.timestamp = requests[i].first_timestamp;
+      request.request = requests[i].data;
+      if (i < responses.size()) {
+        request.captured_response = responses[i].data;
+        request.captured_latency =
+            responses[i].first_timestamp - requests[i].last_timestamp;
+      }
+      _requests.push_back(request);
+    }
+  });
+
+  CapturedPacket packet;
+  TcpSegment segment;
+  while (reader.next(packet)) {
+    if (PcapReader::decodeTcp(packet, segment)) {
+      reassembler.add(segment);
+    }
+  }
+  reassembler.flush();
+
+  std::stable_sort(_requests.begin(), _requests.end(),
+                   [](const ReplayRequest &a, const ReplayRequest &b) {
+                     return a.timestamp < b.timestamp;
+                   });
+  return true;
+}
+
+/**
+ * @brief  Compares shape of two messages, i.e. element types and list sizes
+ * @param  &captured: parsed captured response
+ * @param  &replayed: parsed replayed response
+ * @retval True: structure is the same | False: structure differs
+ */
+bool Replayer::sameStructure(const SExpression &captured,
+                             const SExpression &replayed) {
+  if (captured.type != replayed.type ||
+      captured.items.size() != replayed.items.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < captured.items.size(); i++) {
+    if (!sameStructure(captured.items[i], replayed.items[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief  Compares replayed response with the captured one, the status has to
+ * be the same for a structural match
+ * @param  &captured: captured response
+ * @param  &replayed: replayed response
+ * @retval Level of match
+ */
+ReplayMatch Replayer::compare(const std::string &captured,
+                              const std::string &replayed) {
+  if (captured == replayed) {
+    return ReplayMatch::EXACT;
+  }
+  SExpression captured_message;
+  SExpression replayed_message;
+  if (!SExpression::parse(captured, captured_message) ||
+      !SExpression::parse(replayed, replayed_message) ||
+      captured_message.items.empty() || replayed_message.items.empty() ||
+      captured_message.items[0].value != replayed_message.items[0].value) {
+    return ReplayMatch::MISMATCH;
+  }
+  return sameStructure(captured_message, replayed_message)
+             ? ReplayMatch::STRUCTURAL
+             : ReplayMatch::MISMATCH;
+}
+
+/**
+ * @brief  Returns token of the successful login response
+ * @param  &response: server response
+ * @retval Token, empty if the response does not carry one
+ */
+std::string Replayer::getLoginToken(const std::string &response) {
+  SExpression message;
+  if (!SExpression::parse(response, message) || message.items.size() != 3 ||
+      message.items[0].value != "ok" || !message.items[2].isString()) {
+    return "";
+  }
+  return message.items[2].value;
+}
+
+/**
+ * @brief  Replaces captured login tokens by tokens issued during the replay
+ * @param  request: captured request
+ * @retval Request valid for the target server
+ */
+std::string Replayer::substituteTokens(std::string request) const {
+  for (auto &token : _tokens) {
+    std::string captured = SExpression::quote(token.first);
+    size_t position = request.find(captured);
+    if (position != std::string::npos) {
+      request.replace(position, captured.size(),
+                      SExpression::quote(token.second));
+    }
+  }
+  return request;
+}
+
+/**
+ * @brief  Sends all requests to the target server one after another
+ * @param  original_timing: True: keeps gaps of the capture | False: sends the
+ * next request as soon as the previous one is answered
+ * @param  speed: speed up factor of the original timing
+ * @retval None
+ */
+void Replayer::run(bool original_timing, double speed) {
+  _results.clear();
+  _tokens.clear();
+  if (_requests.empty()) {
+    return;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  uint64_t first_timestamp = _requests.front().timestamp;
+
+  for (auto &request : _requests) {
+    if (original_timing) {
+      std::this_thread::sleep_until(
+          start + std::chrono::nanoseconds(static_cast<uint64_t>(
+                      (request.timestamp - first_timestamp) / speed)));
+    }
+
+    ReplayResult result;
+    SExpression parsed;
+    if (SExpression::parse(request.request, parsed) && !parsed.items.empty()) {
+      result.command = parsed.items[0].value;
+    }
+
+    std::string data = substituteTokens(request.request);
+    auto sent = std::chrono::steady_clock::now();
+    CommunicationBase c(_address, _is_v6, _port);
+    c.setConnection();
+    result.response = c.communicate(data);
+    c.endConnection();
+    result.latency = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - sent)
+            .count());
+    result.match = compare(request.captured_response, result.response);
+    if (_trace) {
+      _trace->addRequest(1, result.command, c.getTiming(), Stats::now());
+    }
+
+    /* Later requests of the capture use the captured token */
+    std::string captured_token = getLoginToken(request.captured_response);
+    std::string replayed_token = getLoginToken(result.response);
+    if (!captured_token.empty() && !replayed_token.empty()) {
+      _tokens[captured_token] = replayed_token;
+    }
+
+    _results.push_back(result);
+  }
+}
+
+/**
+ * @brief  Prints per-request latencies, matches and summary
+ * @param  &os: output stream
+ * @param  verbose: prints also responses that did not match
+ * @retval None
+ */
+void Replayer::printReport(std::ostream &os, bool verbose) const {
+  static const char *match_names[] = {"exact", "structural", "MISMATCH"};
+  Histogram replayed;
+  Histogram captured;
+  size_t matches[3]{};
+
+  os << std::left << std::setw(6) << "#" << std::setw(10) << "command"
+     << std::right << std::setw(14) << "captured[ms]" << std::setw(14)
+     << "replayed[ms]" << "  match" << std::endl;
+  for (size_t i = 0; i < _results.size(); i++) {
+    const ReplayResult &result = _results[i];
+    const ReplayRequest &request = _requests[i];
+    os << std::left << std::setw(6) << i + 1 << std::setw(10) << result.command
+       << std::right << std::fixed << std::setprecision(3) << std::setw(14)
+       << request.captured_latency / 1e6 << std::setw(14)
+       << result.latency / 1e6 << "  "
+       << match_names[static_cast<int>(result.match)] << std::endl;
+    if (verbose && result.match == ReplayMatch::MISMATCH) {
+      os << "    captured: " << request.captured_response << std::endl
+         << "    replayed: " << result.response << std::endl;
+    }
+    replayed.record(result.latency);
+    captured.record(request.captured_latency);
+    matches[static_cast<int>(result.match)]++;
+  }
+
+  os << "requests: " << _results.size() << ", exact: " << matches[0]
+     << ", structural: " << matches[1] << ", mismatch: " << matches[2]
+     << std::endl;
+  for (auto item : {std::make_pair("captured", &captured),
+                    std::make_pair("replayed", &replayed)}) {
+    os << item.first << " latency [ms] p50: " << std::setprecision(3)
+       << item.second->percentile(50) / 1e6
+       << " p90: " << item.second->percentile(90) / 1e6
+       << " p99: " << item.second->percentile(99) / 1e6
+       << " max: " << item.second->max() / 1e6 << std::endl;
+  }
+}
+
+/**
+ * @brief  Returns number of requests extracted from the capture
+ * @retval number of requests
+ */
+size_t Replayer::getRequestCount() const { return _requests.size(); }
+
+/**
+ * @brief  Returns number of replayed responses that did not match
+ * @retval number of mismatches
+ */
+size_t Replayer::getMismatchCount() const {
+  return std::count_if(_results.begin(), _results.end(),
+                       [](const ReplayResult &result) {
+                         return result.match == ReplayMatch::MISMATCH;
+                       });
+}
@@ -0,0 +1,447 @@
+#include "../include/RingBuffer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+const char RING_MAGIC[] = "ISARNG02";
+const size_t RING_CAPACITY_OFFSET = 8;
+/* Writer and reader words sit on their own cache lines */
+const size_t RING_HEAD = 64;
+const size_t RING_DATA_SEQ = 72;
+const size_t RING_CONSUMER_WAITING = 76;
+const size_t RING_TAIL = 128;
+const size_t RING_SPACE_SEQ = 136;
+const size_t RING_PRODUCER_WAITING = 140;
+const size_t RING_HEADER_LENGTH = 192;
+const size_t RING_RECORD_LENGTH = 40;
+const size_t RING_MIN_CAPACITY = 4096;
+/* Record flags */
+const uint16_t RING_OK = 1;
+const uint16_t RING_MORE = 2;
+
+/**
+ * @brief  Returns 64-bit word of the ring header for atomic access
+ * @param  *data: mapped ring
+ * @param  offset: offset of the word
+ * @retval atomic reference
+ */
+static std::atomic_ref<uint64_t> getWord64(uint8_t *data, size_t offset) {
+  return std::atomic_ref<uint64_t>(
+      *reinterpret_cast<uint64_t *>(data + offset));
+}
+
+/**
+ * @brief  Returns 32-bit word of the ring header for atomic access
+ * @param  *data: mapped ring
+ * @param  offset: offset of the word
+ * @retval atomic reference
+ */
+static std::atomic_ref<uint32_t> getWord32(uint8_t *data, size_t offset) {
+  return std::atomic_ref<uint32_t>(
+      *reinterpret_cast<uint32_t *>(data + offset));
+}
+
+/**
+ * @brief  Sleeps while the futex word holds the value, the word is shared
+ * by processes
+ * @param  *data: mapped ring
+ * @param  offset: offset of the futex word
+ * @param  value: value seen before sleeping
+ * @param  timeout: time limit in milliseconds, negative waits forever
+ * @retval True: woken or value changed | False: time limit passed
+ */
+static bool waitFutex(uint8_t *data, size_t offset, uint32_t value,
+                      int timeout) {
+  struct timespec limit = {timeout / 1000, (timeout % 1000) * 1000000L};
+  long result = syscall(SYS_futex, data + offset, FUTEX_WAIT, value,
+                        timeout < 0 ? nullptr : &limit, nullptr, 0);
+  return result == 0 || errno != ETIMEDOUT;
+}
+
+/**
+ * @brief  Wakes processes sleeping on the futex word
+ * @param  *data: mapped ring
+ * @param  offset: offset of the futex word
+ * @retval None
+ */
+static void wakeFutex(uint8_t *data, size_t offset) {
+  syscall(SYS_futex, data + offset, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+/**
+ * @brief  Returns capacity of the ring stored in its header
+ * @param  *data: mapped ring
+ * @retval capacity in bytes
+ */
+static uint64_t getCapacity(const uint8_t *data) {
+  uint64_t capacity;
+  memcpy(&capacity, data + RING_CAPACITY_OFFSET, sizeof(capacity));
+  return capacity;
+}
+
+/**
+ * @brief  Checks that the mapped memory holds a complete ring
+ * @param  *data: mapped ring
+ * @param  size: size of the mapping
+ * @retval True: ring is valid | False: ring is not initialized or broken
+ */
+static bool isRingValid(const uint8_t *data, size_t size) {
+  uint64_t capacity = getCapacity(data);
+  return !memcmp(data, RING_MAGIC, sizeof(RING_MAGIC) - 1) &&
+         capacity >= RING_MIN_CAPACITY && !(capacity & (capacity - 1)) &&
+         RING_HEADER_LENGTH + capacity == size;
+}
+
+/**
+ * @brief  Opens the ring in the shared memory, the first process creates it
+ * with the given capacity under the file lock
+ * @param  &name: name of the shared memory object
+ * @param  capacity: capacity of a created ring, power of two
+ * @param  &fd: shared memory descriptor
+ * @param  *&data: mapped ring
+ * @param  &size: size of the mapping
+ * @retval True: ring is mapped | False: ring could not be opened
+ */
+static bool mapRing(const std::string &name, size_t capacity, int &fd,
+                    uint8_t *&data, size_t &size) {
+  if (name.empty() || name.find('/') != std::string::npos ||
+      capacity < RING_MIN_CAPACITY || (capacity & (capacity - 1))) {
+    return false;
+  }
+  fd = shm_open(("/" + name).c_str(), O_RDWR | O_CREAT, 0600);
+  if (fd == -1) {
+    return false;
+  }
+
+  struct stat info;
+  bool valid{false};
+  for (int attempt = 0; attempt < 2 && !valid; attempt++) {
+    /* Second attempt waits for the process initializing the ring */
+    if (attempt && flock(fd, LOCK_EX) == -1) {
+      return false;
+    }
+    if (fstat(fd, &info) == -1) {
+      return false;
+    }
+    if (attempt && !info.st_size) {
+      info.st_size = RING_HEADER_LENGTH + capacity;
+      if (ftruncate(fd, info.st_size) == -1) {
+        flock(fd, LOCK_UN);
+        return false;
+      }
+    }
+    if (info.st_size >= static_cast<off_t>(RING_HEADER_LENGTH)) {
+      size = info.st_size;
+      void *mapped =
+          mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (mapped == MAP_FAILED) {
+        return false;
+      }
+      data = static_cast<uint8_t *>(mapped);
+      if (attempt && memcmp(data, RING_MAGIC, sizeof(RING_MAGIC) - 1)) {
+        /* Magic goes last so that a reader never sees half a header */
+        memset(data, 0, RING_HEADER_LENGTH);
+        memcpy(data + RING_CAPACITY_OFFSET, &capacity, sizeof(capacity));
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(data, RING_MAGIC, sizeof(RING_MAGIC) - 1);
+      }
+      valid = isRingValid(data, size);
+      if (!valid) {
+        munmap(data, size);
+        data = nullptr;
+      }
+    }
+    if (attempt) {
+      flock(fd, LOCK_UN);
+    }
+  }
+  return valid;
+}
+
+/**
+ * @brief  RingWriter destructor, the ring is given to the next writer
+ * @retval None
+ */
+RingWriter::~RingWriter() {
+  if (_data) {
+    munmap(_data, _size);
+  }
+  if (_fd != -1) {
+    close(_fd);
+  }
+}
+
+/**
+ * @brief  Opens the ring, records are written once it is locked
+ * @param  &name: name of the shared memory object
+ * @retval True: ring is open | False: ring could not be opened
+ */
+bool RingWriter::open(const std::string &name) {
+  return mapRing(name, RING_CAPACITY, _fd, _data, _size);
+}
+
+/**
+ * @brief  Waits until no other writer holds the ring, it is held until the
+ * writer is destroyed
+ * @retval True: ring is held | False: locking failed
+ */
+bool RingWriter::lock() {
+  if (flock(_fd, LOCK_EX) == -1) {
+    return false;
+  }
+  _head = getWord64(_data, RING_HEAD).load();
+  return true;
+}
+
+/**
+ * @brief  Waits until the reader frees space for the record
+ * @param  needed: bytes the record takes including padding
+ * @retval True: space is free | False: reader did not free it in time
+ */
+bool RingWriter::waitForSpace(uint64_t needed) {
+  uint64_t capacity = getCapacity(_data);
+  auto tail = getWord64(_data, RING_TAIL);
+  auto waiting = getWord32(_data, RING_PRODUCER_WAITING);
+  while (_head + needed - tail.load() > capacity) {
+    /* Reader drains records published so far */
+    flush();
+    waiting.store(1);
+    uint32_t sequence = getWord32(_data, RING_SPACE_SEQ).load();
+    bool woken = _head + needed - tail.load() <= capacity ||
+                 waitFutex(_data, RING_SPACE_SEQ, sequence, FULL_WAIT);
+    waiting.store(0);
+    if (!woken) {
+      return _head + needed - tail.load() <= capacity;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief  Copies the record into the ring, a record never wraps, the end of
+ * the ring is skipped by a padding record instead
+ * @param  type: type of the record
+ * @param  flags: the command succeeded, the fields continue in the next record
+ * @param  (&fields): id, sender, subject and body, half of the ring at most
+ * @retval True: record is published | False: record does not fit the ring or
+ * the reader does not take records
+ */
+bool RingWriter::writeRecord(RingRecordType type, uint16_t flags,
+                             const std::string_view (&fields)[RING_FIELDS]) {
+  uint64_t capacity = getCapacity(_data);
+  uint32_t offsets[RING_FIELDS];
+  uint32_t lengths[RING_FIELDS];
+  uint64_t size = RING_RECORD_LENGTH;
+  for (size_t i = 0; i < RING_FIELDS; i++) {
+    offsets[i] = static_cast<uint32_t>(size);
+    lengths[i] = static_cast<uint32_t>(fields[i].size());
+    size += fields[i].size();
+  }
+  size = (size + 7) & ~static_cast<uint64_t>(7);
+  /* Record and the padding before it fit any position */
+  if (size > capacity / 2) {
+    return false;
+  }
+
+  uint64_t position = _head & (capacity - 1);
+  uint64_t contiguous = capacity - position;
+  if (!waitForSpace(size + (contiguous < size ? contiguous : 0))) {
+    return false;
+  }
+  uint8_t *ring = _data + RING_HEADER_LENGTH;
+  if (contiguous < size) {
+    uint32_t pad_length = static_cast<uint32_t>(contiguous);
+    uint16_t pad_type = static_cast<uint16_t>(RingRecordType::PAD);
+    memcpy(ring + position, &pad_length, sizeof(pad_length));
+    memcpy(ring + position + 4, &pad_type, sizeof(pad_type));
+    _head += contiguous;
+    position = 0;
+  }
+
+  uint8_t *record = ring + position;
+  uint32_t length = static_cast<uint32_t>(size);
+  uint16_t record_type = static_cast<uint16_t>(type);
+  memcpy(record, &length, sizeof(length));
+  memcpy(record + 4, &record_type, sizeof(record_type));
+  memcpy(record + 6, &flags, sizeof(flags));
+  memcpy(record + 8, offsets, sizeof(offsets));
+  memcpy(record + 24, lengths, sizeof(lengths));
+  for (size_t i = 0; i < RING_FIELDS; i++) {
+    memcpy(record + offsets[i], fields[i].data(), fields[i].size());
+  }
+  _head += size;
+  getWord64(_data, RING_HEAD).store(_head);
+  return true;
+}
+
+/**
+ * @brief  Publishes the record, one larger than half of the ring is split
+ * into records filled field by field, all but the last one flagged to
+ * continue
+ * @param  type: type of the record
+ * @param  ok: the command succeeded, used by END
+ * @param  (&fields): id, sender, subject and body
+ * @retval True: record is published | False: the reader does not take
+ * records
+ */
+bool RingWriter::write(RingRecordType type, bool ok,
+                       const std::string_view (&fields)[RING_FIELDS]) {
+  uint64_t budget = getCapacity(_data) / 2 - RING_RECORD_LENGTH;
+  std::string_view rest[RING_FIELDS];
+  std::copy(std::begin(fields), std::end(fields), rest);
+  while (true) {
+    std::string_view part[RING_FIELDS];
+    uint64_t left = budget;
+    bool more{false};
+    for (size_t i = 0; i < RING_FIELDS; i++) {
+      part[i] = rest[i].substr(0, left);
+      left -= part[i].size();
+      rest[i].remove_prefix(part[i].size());
+      more = more || !rest[i].empty();
+    }
+    if (!writeRecord(type, (ok ? RING_OK : 0) | (more ? RING_MORE : 0),
+                     part)) {
+      return false;
+    }
+    if (!more) {
+      return true;
+    }
+  }
+}
+
+/**
+ * @brief  Wakes the reader sleeping on an empty ring, called once per batch
+ * of records
+ * @retval None
+ */
+void RingWriter::flush() {
+  getWord32(_data, RING_DATA_SEQ).fetch_add(1);
+  if (getWord32(_data, RING_CONSUMER_WAITING).load()) {
+    wakeFutex(_data, RING_DATA_SEQ);
+  }
+}
+
+/**
+ * @brief  RingReader destructor
+ * @retval None
+ */
+RingReader::~RingReader() {
+  consume();
+  if (_data) {
+    munmap(_data, _size);
+  }
+  if (_fd != -1) {
+    close(_fd);
+  }
+}
+
+/**
+ * @brief  Opens the ring, it is created when it does not exist yet
+ * @param  &name: name of the shared memory object
+ * @param  capacity: capacity of a created ring, power of two
+ * @retval True: ring is open | False: ring could not be opened
+ */
+bool RingReader::open(const std::string &name, size_t capacity) {
+  if (!mapRing(name, capacity, _fd, _data, _size)) {
+    return false;
+  }
+  _tail = getWord64(_data, RING_TAIL).load();
+  return true;
+}
+
+/**
+ * @brief  Gives space of the record read last back to the writer
+ * @retval None
+ */
+void RingReader::consume() {
+  if (!_current) {
+    return;
+  }
+  _tail += _current;
+  _current = 0;
+  getWord64(_data, RING_TAIL).store(_tail);
+  if (getWord32(_data, RING_PRODUCER_WAITING).load()) {
+    getWord32(_data, RING_SPACE_SEQ).fetch_add(1);
+    wakeFutex(_data, RING_SPACE_SEQ);
+  }
+}
+
+/**
+ * @brief  Reads the next record, the previous one is released
+ * @param  &record: record pointing into the ring
+ * @param  timeout: time to wait for a record in milliseconds, negative waits
+ * forever
+ * @retval True: record is read | False: no record in time or broken ring
+ */
+bool RingReader::next(RingRecord &record, int timeout) {
+  consume();
+  uint64_t capacity = getCapacity(_data);
+  const uint8_t *ring = _data + RING_HEADER_LENGTH;
+  auto head = getWord64(_data, RING_HEAD);
+  while (true) {
+    if (head.load() == _tail) {
+      if (!timeout) {
+        return false;
+      }
+      auto waiting = getWord32(_data, RING_CONSUMER_WAITING);
+      waiting.store(1);
+      uint32_t sequence = getWord32(_data, RING_DATA_SEQ).load();
+      bool woken = head.load() != _tail ||
+                   waitFutex(_data, RING_DATA_SEQ, sequence, timeout);
+      waiting.store(0);
+      if (!woken && head.load() == _tail) {
+        return false;
+      }
+      continue;
+    }
+
+    uint64_t position = _tail & (capacity - 1);
+    const uint8_t *data = ring + position;
+    uint32_t length;
+    uint16_t type;
+    memcpy(&length, data, sizeof(length));
+    memcpy(&type, data + 4, sizeof(type));
+    if (length < 8 || (length & 7) || length > capacity - position) {
+      return false;
+    }
+    if (type == static_cast<uint16_t>(RingRecordType::PAD)) {
+      _current = length;
+      consume();
+      continue;
+    }
+
+    uint16_t flags;
+    uint32_t offsets[RING_FIELDS];
+    uint32_t lengths[RING_FIELDS];
+    if (length < RING_RECORD_LENGTH ||
+        type > static_cast<uint16_t>(RingRecordType::END)) {
+      return false;
+    }
+    memcpy(&flags, data + 6, sizeof(flags));
+    memcpy(offsets, data + 8, sizeof(offsets));
+    memcpy(lengths, data + 24, sizeof(lengths));
+    for (size_t i = 0; i < RING_FIELDS; i++) {
+      if (offsets[i] > length || lengths[i] > length - offsets[i]) {
+        return false;
+      }
+      record.fields[i] = std::string_view(
+          reinterpret_cast<const char *>(data) + offsets[i], lengths[i]);
+    }
+    record.type = static_cast<RingRecordType>(type);
+    record.ok = flags & RING_OK;
+    record.more = flags & RING_MORE;
+    _current = length;
+    return true;
+  }
+}
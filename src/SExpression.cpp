@@ -0,0 +1,207 @@
+#include "../include/SExpression.hpp"
+
+/**
+ * @brief  Skips white characters
+ * @param  &data: message data
+ * @param  &position: position in the data, moved to first non-white char
+ * @retval None
+ */
+static void skipSpaces(const std::string &data, size_t &position) {
+  while (position < data.size() &&
+         (data[position] == ' ' || data[position] == '\t' ||
+          data[position] == '\n' || data[position] == '\r')) {
+    position++;
+  }
+}
+
+/**
+ * @brief  Parses one element of the message starting at the position
+ * @param  &data: message data
+ * @param  &position: position in the data, moved behind the element
+ * @param  &result: parsed element
+ * @retval True: element is valid | False: element is not valid
+ */
+static bool parseElement(const std::string &data, size_t &position,
+                         SExpression &result) {
+  skipSpaces(data, position);
+  if (position >= data.size()) {
+    return false;
+  }
+
+  if (data[position] == '(') {
+    /* Nested list */
+    result.type = SExpression::Type::LIST;
+    position++;
+    while (true) {
+      skipSpaces(data, position);
+      if (position >= data.size()) {
+        return false;
+      }
+      if (data[position] == ')') {
+        position++;
+        return true;
+      }
+      result.items.emplace_back();
+      if (!parseElement(data, position, result.items.back())) {
+        return false;
+      }
+    }
+  }
+
+  if (data[position] == '"') {
+    /* Quoted string with escaped characters */
+    result.type = SExpression::Type::STRING;
+    position++;
+    while (position < data.size() && data[position] != '"') {
+      if (data[position] == '\\' && position + 1 < data.size()) {
+        position++;
+        result.value += data[position] == 'n' ? '\n' : data[position];
+      } else {
+        result.value += data[position];
+      }
+      position++;
+    }
+    if (position >= data.size()) {
+      return false;
+    }
+    position++;
+    return true;
+  }
+
+  if (data[position] == ')') {
+    return false;
+  }
+
+  /* Atom is anything up to the next white char or bracket */
+  result.type = SExpression::Type::ATOM;
+  size_t start = position;
+  while (position < data.size() && data[position] != ' ' &&
+         data[position] != '(' && data[position] != ')' &&
+         data[position] != '"' && data[position] != '\t' &&
+         data[position] != '\n' && data[position] != '\r') {
+    position++;
+  }
+  result.value = data.substr(start, position - start);
+  return true;
+}
+
+/**
+ * @brief  Finds end of the first complete message in the data
+ * @param  &data: received data
+ * @param  offset: position where the message starts
+ * @retval Length of the complete message, 0 if the message is not complete
+ */
+size_t SExpression::findEnd(const std::string &data, size_t offset) {
+  int depth{};
+  bool in_string{false};
+  for (size_t i = offset; i < data.size(); i++) {
+    char c = data[i];
+    if (in_string) {
+      if (c == '\\') {
+        i++;
+      } else if (c == '"') {
+        in_string = false;
+      }
+    } else if (c == '"') {
+      in_string = true;
+    } else if (c == '(') {
+      depth++;
+    } else if (c == ')') {
+      depth--;
+      if (depth <= 0) {
+        return i + 1 - offset;
+      }
+    }
+  }
+  return 0;
+}
+
+/**
+ * @brief  Parses the message
+ * @param  &data: message data
+ * @param  &result: parsed message
+ * @retval True: message is valid | False: message is not valid
+ */
+bool SExpression::parse(const std::string &data, SExpression &result) {
+  size_t position{};
+  result = SExpression();
+  skipSpaces(data, position);
+  if (position >= data.size() || data[position] != '(') {
+    return false;
+  }
+  if (!parseElement(data, position, result)) {
+    return false;
+  }
+  skipSpaces(data, position);
+  return position == data.size();
+}
+
+/**
+ * @brief  Wraps the value in quotes and escapes special characters
+ * @param  &value: string value
+ * @retval Quoted string
+ */
+std::string SExpression::quote(const std::string &value) {
+  std::string quoted;
+  quoted.reserve(value.size() + 2);
+  quoted += '"';
+  for (char c : value) {
+    switch (c) {
+    case '\\':
+      quoted += "\\\\";
+      break;
+    case '"':
+      quoted += "\\\"";
+      break;
+    case '\n':
+      quoted += "\\n";
+      break;
+    default:
+      quoted += c;
+    }
+  }
+  quoted += '"';
+  return quoted;
+}
+
+/**
+ * @brief  Identifies whether the element is a quoted string
+ * @retval True: element is a string | False: element is not a string
+ */
+bool SExpression::isString() const { return type == Type::STRING; }
+
+/**
+ * @brief  Identifies whether the element is an atom
+ * @retval True: element is an atom | False: element is not an atom
+ */
+bool SExpression::isAtom() const { return type == Type::ATOM; }
+
+/**
+ * @brief  Identifies whether the element is a list
+ * @retval True: element is a list | False: element is not a list
+ */
+bool SExpression::isList() const { return type == Type::LIST; }
+
+/**
+ * @brief  Serializes the element back to the protocol form
+ * @retval Message data
+ */
+std::string SExpression::toString() const {
+  switch (type) {
+  case Type::STRING:
+    return quote(value);
+  case Type::ATOM:
+    return value;
+  default:
+    break;
+  }
+  std::string data = "(";
+  for (size_t i = 0; i < items.size(); i++) {
+    if (i) {
+      data += ' ';
+    }
+    data += items[i].toString();
+  }
+  data += ')';
+  return data;
+}
@@ -0,0 +1,306 @@
+#include "../include/Server.hpp"
+#include "../include/SExpression.hpp"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+const int MAX_EVENTS = 256;
+const size_t READ_BUFFER_SIZE = 65536;
+const size_t MAX_REQUEST_SIZE = 64 * 1024 * 1024;
+
+/**
+ * @brief  Server class constructor
+ * @param  address: address to listen on
+ * @param  isV6: IPv6 flag
+ * @param  port: port to listen on
+ * @param  &store: storage answering the requests
+ * @retval Constructed object
+ */
+Server::Server(std::string address, bool isV6, int port, MailStore &store)
+    : _address(address), _is_v6(isV6), _port(port), _store(store) {}
+
+/**
+ * @brief  Server class destructor, closes all descriptors
+ * @retval None
+ */
+Server::~Server() {
+  for (auto &connection : _connections) {
+    close(connection.first);
+  }
+  for (int fd : {_listenfd, _epollfd, _signalfd, _timerfd}) {
+    if (fd != -1) {
+      close(fd);
+    }
+  }
+}
+
+/**
+ * @brief  Enables snapshots of the storage
+ * @param  filename: snapshot file, saved on exit
+ * @param  interval: period of snapshots in seconds, 0 saves only on exit
+ * @retval None
+ */
+void Server::setSnapshot(const std::string filename, int interval) {
+  _snapshot = filename;
+  _snapshot_interval = interval;
+}
+
+/**
+ * @brief  Creates non-blocking listening socket
+ * @retval None
+ */
+void Server::createListener() {
+  int enable = 1;
+  int disable = 0;
+
+  if (_is_v6) {
+    _listenfd = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK, IPPROTO_TCP);
+  } else {
+    _listenfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  }
+  if (_listenfd == -1) {
+    std::cerr << "ERR: Unable to create socket :(" << std::endl;
+    exit(1);
+  }
+  setsockopt(_listenfd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+  int result;
+  if (_is_v6) {
+    /* Dual stack, IPv4 clients are accepted as mapped addresses */
+    setsockopt(_listenfd, IPPROTO_IPV6, IPV6_V6ONLY, &disable,
+               sizeof(disable));
+    struct sockaddr_in6 server6_address {};
+    server6_address.sin6_family = AF_INET6;
+    server6_address.sin6_port = htons(_port);
+    inet_pton(AF_INET6, _address.c_str(), &server6_address.sin6_addr);
+    result = bind(_listenfd, (struct sockaddr *)&server6_address,
+                  sizeof(server6_address));
+  } else {
+    struct sockaddr_in server_address {};
+    server_address.sin_family = AF_INET;
+    server_address.sin_port = htons(_port);
+    server_address.sin_addr.s_addr = inet_addr(_address.c_str());
+    result = bind(_listenfd, (struct sockaddr *)&server_address,
+                  sizeof(server_address));
+  }
+  if (result < 0 || listen(_listenfd, SOMAXCONN) < 0) {
+    std::cerr << "ERR: Unable to listen on port " << _port << " :("
+              << std::endl;
+    exit(1);
+  }
+}
+
+/**
+ * @brief  Creates epoll instance with signal and snapshot timer sources
+ * @retval None
+ */
+void Server::createEventSources() {
+  _epollfd = epoll_create1(0);
+  if (_epollfd == -1) {
+    std::cerr << "ERR: Unable to create epoll instance :(" << std::endl;
+    exit(1);
+  }
+  watch(_listenfd, EPOLLIN);
+
+  /* Termination signals are handled within the loop */
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  sigprocmask(SIG_BLOCK, &signals, nullptr);
+  signal(SIGPIPE, SIG_IGN);
+  _signalfd = signalfd(-1, &signals, SFD_NONBLOCK);
+  watch(_signalfd, EPOLLIN);
+
+  if (!_snapshot.empty() && _snapshot_interval > 0) {
+    _timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    struct itimerspec period {};
+    period.it_interval.tv_sec = _snapshot_interval;
+    period.it_value.tv_sec = _snapshot_interval;
+    timerfd_settime(_timerfd, 0, &period, nullptr);
+    watch(_timerfd, EPOLLIN);
+  }
+}
+
+/**
+ * @brief  Registers descriptor in the epoll instance or changes its events
+ * @param  fd: watched descriptor
+ * @param  events: epoll events
+ * @param  modify: True: descriptor is already registered | False: new one
+ * @retval None
+ */
+void Server::watch(int fd, unsigned events, bool modify) {
+  struct epoll_event event {};
+  event.events = events;
+  event.data.fd = fd;
+  epoll_ctl(_epollfd, modify ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event);
+}
+
+/**
+ * @brief  Accepts all pending connections
+ * @retval None
+ */
+void Server::acceptConnections() {
+  while (true) {
+    int fd = accept4(_listenfd, nullptr, nullptr, SOCK_NONBLOCK);
+    if (fd == -1) {
+      return;
+    }
+    _connections[fd];
+    watch(fd, EPOLLIN);
+  }
+}
+
+/**
+ * @brief  Reads available request data, answers complete request
+ * @param  fd: connection descriptor
+ * @retval None
+ */
+void Server::readConnection(int fd) {
+  ServerConnection &connection = _connections[fd];
+  char buffer[READ_BUFFER_SIZE];
+
+  bool closed{false};
+
+  while (true) {
+    ssize_t received = read(fd, buffer, sizeof(buffer));
+    if (received > 0) {
+      connection.request.append(buffer, received);
+      continue;
+    }
+    if (received == -1 && errno == EINTR) {
+      continue;
+    }
+    /* Anything else than no more data means the peer is gone */
+    closed = received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+    break;
+  }
+
+  if (connection.request.size() > MAX_REQUEST_SIZE) {
+    closeConnection(fd);
+    return;
+  }
+
+  /* Message ends with bracket, only then is it worth looking for its end */
+  size_t end{};
+  size_t last = connection.request.find_last_not_of(" \t\r\n");
+  if (last != std::string::npos && connection.request[last] == ')') {
+    end = SExpression::findEnd(connection.request);
+  }
+  if (end == 0) {
+    if (closed) {
+      closeConnection(fd);
+    }
+    return;
+  }
+
+  connection.request.resize(end);
+  connection.response = _store.handle(connection.request);
+  connection.request.clear();
+  writeConnection(fd);
+}
+
+/**
+ * @brief  Writes pending response, closes the connection once it is written
+ * @param  fd: connection descriptor
+ * @retval None
+ */
+void Server::writeConnection(int fd) {
+  ServerConnection &connection = _connections[fd];
+
+  while (connection.written < connection.response.size()) {
+    ssize_t sent = write(fd, connection.response.data() + connection.written,
+                         connection.response.size() - connection.written);
+    if (sent == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        watch(fd, EPOLLOUT, true);
+        return;
+      }
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    connection.written += sent;
+  }
+  closeConnection(fd);
+}
+
+/**
+ * @brief  Closes the connection and forgets its state
+ * @param  fd: connection descriptor
+ * @retval None
+ */
+void Server::closeConnection(int fd) {
+  epoll_ctl(_epollfd, EPOLL_CTL_DEL, fd, nullptr);
+  close(fd);
+  _connections.erase(fd);
+}
+
+/**
+ * @brief  Saves snapshot of the storage if enabled
+ * @retval None
+ */
+void Server::saveSnapshot() {
+  if (!_snapshot.empty() && !_store.save(_snapshot)) {
+    std::cerr << "ERR: Snapshot could not be saved :(" << std::endl;
+  }
+}
+
+/**
+ * @brief  Runs the event loop until SIGINT or SIGTERM
+ * @retval None
+ */
+void Server::run() {
+  createListener();
+  createEventSources();
+
+  struct epoll_event events[MAX_EVENTS];
+  _running = true;
+  while (_running) {
+    int ready = epoll_wait(_epollfd, events, MAX_EVENTS, -1);
+    if (ready == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::cerr << "ERR: Event loop failed :(" << std::endl;
+      exit(1);
+    }
+
+    for (int i = 0; i < ready; i++) {
+      int fd = events[i].data.fd;
+      if (fd == _listenfd) {
+        acceptConnections();
+      } else if (fd == _signalfd) {
+        struct signalfd_siginfo info;
+        while (read(_signalfd, &info, sizeof(info)) > 0) {
+          ;
+        }
+        _running = false;
+      } else if (fd == _timerfd) {
+        uint64_t expirations;
+        while (read(_timerfd, &expirations, sizeof(expirations)) > 0) {
+          ;
+        }
+        saveSnapshot();
+      } else if (_connections.count(fd)) {
+        if (events[i].events & EPOLLOUT) {
+          writeConnection(fd);
+        } else {
+          readConnection(fd);
+        }
+      }
+    }
+  }
+
+  saveSnapshot();
+}
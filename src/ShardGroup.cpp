@@ -0,0 +1,253 @@
+#include "../include/ShardGroup.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <thread>
+#include <unistd.h>
+
+/**
+ * @brief  ShardGroup constructor, every shard runs queued work when its
+ * coroutines wait
+ * @param  count: number of shards
+ * @retval Constructed object
+ */
+ShardGroup::ShardGroup(size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    _shards.emplace_back(new Shard());
+    Shard &shard = *_shards.back();
+    shard.wake_fd = eventfd(0, EFD_NONBLOCK);
+    if (shard.wake_fd == -1) {
+      std::cerr << "ERR: Unable to create event loop :(" << std::endl;
+      exit(1);
+    }
+    shard.loop.setIdle([this, i]() { return runJob(i); }, shard.wake_fd);
+  }
+}
+
+/**
+ * @brief  ShardGroup destructor
+ * @retval None
+ */
+ShardGroup::~ShardGroup() {
+  for (auto &shard : _shards) {
+    close(shard->wake_fd);
+  }
+}
+
+/**
+ * @brief  Returns number of shards
+ * @retval number of shards
+ */
+size_t ShardGroup::size() const { return _shards.size(); }
+
+/**
+ * @brief  Returns shard the key is pinned to
+ * @param  &key: key of the session, the username
+ * @retval index of the shard
+ */
+size_t ShardGroup::getShard(const std::string &key) const {
+  return std::hash<std::string>()(key) % _shards.size();
+}
+
+/**
+ * @brief  Returns event loop of the shard
+ * @param  index: index of the shard
+ * @retval event loop
+ */
+EventLoop &ShardGroup::getLoop(size_t index) { return _shards[index]->loop; }
+
+/**
+ * @brief  Returns counters of the shard, to be updated by its thread only
+ * @param  index: index of the shard
+ * @retval counters
+ */
+ShardCounters &ShardGroup::getCounters(size_t index) {
+  return _shards[index]->counters;
+}
+
+/**
+ * @brief  Takes queued job, the oldest job of the shard goes first, then
+ * the newest job of other shards that are not busy
+ * @param  index: index of the shard
+ * @param  &stolen: job belongs to other shard
+ * @retval job | nullptr: no job is queued
+ */
+ShardJob *ShardGroup::popJob(size_t index, bool &stolen) {
+  for (size_t i = 0; i < _shards.size(); i++) {
+    Shard &shard = *_shards[(index + i) % _shards.size()];
+    std::unique_lock<std::mutex> lock(shard.mutex, std::defer_lock);
+    if (i == 0) {
+      lock.lock();
+    } else if (!lock.try_lock()) {
+      continue;
+    }
+    if (shard.jobs.empty()) {
+      continue;
+    }
+    ShardJob *job;
+    if (i == 0) {
+      job = shard.jobs.front();
+      shard.jobs.pop_front();
+    } else {
+      job = shard.jobs.back();
+      shard.jobs.pop_back();
+    }
+    stolen = i > 0;
+    return job;
+  }
+  return nullptr;
+}
+
+/**
+ * @brief  Runs one queued job within the shard, the shard is marked sleeping
+ * first so that a job queued meanwhile wakes it
+ * @param  index: index of the shard
+ * @retval True: job was run | False: no job is queued
+ */
+bool ShardGroup::runJob(size_t index) {
+  Shard &shard = *_shards[index];
+  shard.sleeping = true;
+  bool stolen{};
+  ShardJob *job = popJob(index, stolen);
+  if (!job) {
+    return false;
+  }
+  shard.sleeping = false;
+
+  job->work();
+  shard.counters.jobs++;
+  if (stolen) {
+    shard.counters.stolen++;
+  }
+  /* Job belongs to the suspended coroutine, it is not touched after this */
+  uint64_t one{1};
+  if (write(job->done_fd, &one, sizeof(one)) == -1) {
+    std::cerr << "ERR: Event loop failed :(" << std::endl;
+    exit(1);
+  }
+  return true;
+}
+
+/**
+ * @brief  Wakes one sleeping shard to steal the queued job
+ * @param  except: shard queueing the job
+ * @retval None
+ */
+void ShardGroup::wakeOne(size_t except) {
+  for (size_t i = 0; i < _shards.size(); i++) {
+    Shard &shard = *_shards[i];
+    if (i != except && shard.sleeping.exchange(false)) {
+      uint64_t one{1};
+      if (write(shard.wake_fd, &one, sizeof(one)) == -1) {
+        std::cerr << "ERR: Event loop failed :(" << std::endl;
+        exit(1);
+      }
+      return;
+    }
+  }
+}
+
+/**
+ * @brief  Pins the calling thread to the core of the shard
+ * @param  index: index of the shard
+ * @retval None
+ */
+void ShardGroup::pinThread(size_t index) {
+  unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(index % cores, &set);
+  /* Unpinned shard still runs, only its cache locality suffers */
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+/**
+ * @brief  Queues the work so that this or any idle shard runs it, the
+ * coroutine is resumed within its own shard when the work is done
+ * @param  index: shard of the calling coroutine
+ * @param  work: work to be done
+ * @retval None
+ */
+Task<> ShardGroup::offload(size_t index, std::function<void()> work) {
+  ShardJob job{std::move(work), eventfd(0, EFD_NONBLOCK)};
+  if (job.done_fd == -1) {
+    job.work();
+    co_return;
+  }
+  Shard &shard = *_shards[index];
+  shard.counters.offloaded++;
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.jobs.push_back(&job);
+  }
+  wakeOne(index);
+
+  /* Job must not outlive the coroutine frame, waiting is finished by hand
+   * when the loop fails to watch the descriptor */
+  if (co_await shard.loop.wait(job.done_fd, EPOLLIN) != WaitResult::READY) {
+    struct pollfd poll_fd = {job.done_fd, POLLIN, 0};
+    while (poll(&poll_fd, 1, -1) != 1) {
+    }
+  }
+  close(job.done_fd);
+}
+
+/**
+ * @brief  Runs the body of every shard in its own thread pinned to a core
+ * and waits for all of them
+ * @param  &body: spawns coroutines of the shard and runs its loop
+ * @retval None
+ */
+void ShardGroup::run(const std::function<void(size_t, EventLoop &)> &body) {
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < _shards.size(); i++) {
+    threads.emplace_back([this, &body, i]() {
+      pinThread(i);
+      body(i, _shards[i]->loop);
+      _shards[i]->sleeping = false;
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+}
+
+/**
+ * @brief  Returns counters summed over all shards, to be called when no
+ * shard runs
+ * @retval summed counters
+ */
+ShardCounters ShardGroup::getTotal() const {
+  ShardCounters total;
+  for (auto &shard : _shards) {
+    total.operations += shard->counters.operations;
+    total.offloaded += shard->counters.offloaded;
+    total.jobs += shard->counters.jobs;
+    total.stolen += shard->counters.stolen;
+  }
+  return total;
+}
+
+/**
+ * @brief  Writes summed counters and spread of operations over shards
+ * @param  &os: output stream
+ * @retval None
+ */
+void ShardGroup::printReport(std::ostream &os) const {
+  ShardCounters total = getTotal();
+  uint64_t fewest{UINT64_MAX};
+  uint64_t most{};
+  for (auto &shard : _shards) {
+    fewest = std::min(fewest, shard->counters.operations);
+    most = std::max(most, shard->counters.operations);
+  }
+  os << "shards: " << _shards.size() << ", operations " << total.operations
+     << " (" << fewest << " to " << most << " per shard), large responses "
+     << total.offloaded << ", parsed by other shard " << total.stolen
+     << std::endl;
+}
@@ -0,0 +1,205 @@
+#include "../include/Stats.hpp"
+
+#include <ctime>
+#include <iomanip>
+
+/**
+ * @brief  Stats constructor, the run starts when statistics are first used
+ * @retval Constructed object
+ */
+Stats::Stats()
+    : _alloc_start(AllocCounter::get()), _alloc_mark(_alloc_start),
+      _start(now()) {}
+
+/**
+ * @brief  Adds allocations made since the previous phase ended to the phase
+ * @param  phase: measured phase
+ * @retval None
+ */
+void Stats::addAllocations(Phase phase) {
+  AllocCount count = AllocCounter::since(_alloc_mark);
+  _allocations[static_cast<int>(phase)].allocations += count.allocations;
+  _allocations[static_cast<int>(phase)].bytes += count.bytes;
+  _alloc_mark = AllocCounter::get();
+}
+
+/**
+ * @brief  Returns statistics of the client run
+ * @retval process-wide statistics
+ */
+Stats &Stats::instance() {
+  static Stats stats;
+  return stats;
+}
+
+/**
+ * @brief  Returns monotonic timestamp
+ * @retval timestamp in nanoseconds
+ */
+uint64_t Stats::now() {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return static_cast<uint64_t>(time.tv_sec) * 1000000000ULL + time.tv_nsec;
+}
+
+/**
+ * @brief  Enum class to string 'converter' for phases
+ * @param  phase: phase to be 'converted'
+ * @retval string value according to phase
+ */
+const char *Stats::getPhaseName(Phase phase) {
+  switch (phase) {
+  case Phase::ARGS:
+    return "args";
+  case Phase::TOKEN:
+    return "token";
+  case Phase::CONNECT:
+    return "connect";
+  case Phase::ENCODE:
+    return "encode";
+  case Phase::SEND:
+    return "send";
+  case Phase::FIRST_BYTE:
+    return "first_byte";
+  case Phase::LAST_BYTE:
+    return "last_byte";
+  case Phase::PARSE:
+    return "parse";
+  case Phase::OUTPUT:
+    return "output";
+  default:
+    return "unknown";
+  }
+}
+
+/**
+ * @brief  Enables the report
+ * @param  json: True: JSON report | False: one-line summary
+ * @retval None
+ */
+void Stats::enable(bool json) {
+  _enabled = true;
+  _json = json;
+}
+
+/**
+ * @brief  Identifies whether the report was requested
+ * @retval True: report enabled | False: report disabled
+ */
+bool Stats::isEnabled() const { return _enabled; }
+
+/**
+ * @brief  Adds time elapsed since the start to the phase
+ * @param  phase: measured phase
+ * @param  start: timestamp of the phase start
+ * @retval None
+ */
+void Stats::add(Phase phase, uint64_t start) {
+  _durations[static_cast<int>(phase)] += now() - start;
+  addAllocations(phase);
+}
+
+/**
+ * @brief  Adds network phases and counters of the request, allocations of
+ * the exchange count to receiving the response
+ * @param  &timing: timing of the request on the connection
+ * @retval None
+ */
+void Stats::addRequest(const RequestTiming &timing) {
+  addAllocations(Phase::LAST_BYTE);
+  _durations[static_cast<int>(Phase::CONNECT)] +=
+      timing.connect_end - timing.connect_start;
+  _durations[static_cast<int>(Phase::SEND)] +=
+      timing.send_end - timing.send_start;
+  if (timing.first_byte) {
+    _durations[static_cast<int>(Phase::FIRST_BYTE)] +=
+        timing.first_byte - timing.send_end;
+    _durations[static_cast<int>(Phase::LAST_BYTE)] +=
+        timing.last_byte - timing.first_byte;
+  } else {
+    _durations[static_cast<int>(Phase::FIRST_BYTE)] +=
+        timing.last_byte - timing.send_end;
+  }
+  _bytes_sent += timing.bytes_sent;
+  _bytes_received += timing.bytes_received;
+  _syscalls += timing.syscalls;
+}
+
+/**
+ * @brief  Returns accumulated duration of the phase
+ * @param  phase: measured phase
+ * @retval duration in nanoseconds
+ */
+uint64_t Stats::getDuration(Phase phase) const {
+  return _durations[static_cast<int>(phase)];
+}
+
+/**
+ * @brief  Returns allocations made within the phase
+ * @param  phase: measured phase
+ * @retval allocation count and bytes
+ */
+AllocCount Stats::getAllocations(Phase phase) const {
+  return _allocations[static_cast<int>(phase)];
+}
+
+/**
+ * @brief  Prints the report, durations in milliseconds (microseconds in JSON),
+ * allocations only when they are counted
+ * @param  &os: output stream
+ * @retval None
+ */
+void Stats::print(std::ostream &os) const {
+  uint64_t total = now() - _start;
+  AllocCount allocations = AllocCounter::since(_alloc_start);
+  os << std::fixed << std::setprecision(3);
+
+  if (_json) {
+    os << "{\"phases_us\":{";
+    for (int i = 0; i < PHASE_COUNT; i++) {
+      os << (i ? "," : "") << "\"" << getPhaseName(static_cast<Phase>(i))
+         << "\":" << _durations[i] / 1e3;
+    }
+    os << "},\"total_us\":" << total / 1e3 << ",\"bytes_sent\":" << _bytes_sent
+       << ",\"bytes_received\":" << _bytes_received
+       << ",\"syscalls\":" << _syscalls;
+    /* Allocations are counted by the benchmarks only */
+    if (!AllocCounter::isEnabled()) {
+      os << "}" << std::endl;
+      return;
+    }
+    os << ",\"allocations\":{";
+    for (int i = 0; i < PHASE_COUNT; i++) {
+      os << (i ? "," : "") << "\"" << getPhaseName(static_cast<Phase>(i))
+         << "\":" << _allocations[i].allocations;
+    }
+    os << "},\"alloc_bytes\":{";
+    for (int i = 0; i < PHASE_COUNT; i++) {
+      os << (i ? "," : "") << "\"" << getPhaseName(static_cast<Phase>(i))
+         << "\":" << _allocations[i].bytes;
+    }
+    os << "},\"total_allocations\":" << allocations.allocations
+       << ",\"total_alloc_bytes\":" << allocations.bytes << "}" << std::endl;
+    return;
+  }
+
+  os << "stats:";
+  for (int i = 0; i < PHASE_COUNT; i++) {
+    os << " " << getPhaseName(static_cast<Phase>(i)) << "="
+       << _durations[i] / 1e6 << "ms";
+  }
+  os << " total=" << total / 1e6 << "ms sent=" << _bytes_sent
+     << "B received=" << _bytes_received << "B syscalls=" << _syscalls
+     << std::endl;
+
+  if (!AllocCounter::isEnabled()) {
+    return;
+  }
+  os << "allocs:";
+  for (int i = 0; i < PHASE_COUNT; i++) {
+    os << " " << getPhaseName(static_cast<Phase>(i)) << "="
+       << _allocations[i].allocations << "/" << _allocations[i].bytes << "B";
+  }
+  os << " total=" << allocations.allocations << "/" << allocations.bytes << "B"
+     << std::endl;
+}
@@ -0,0 +1,204 @@
+#include "../include/TcpReassembler.hpp"
+#include "../include/SExpression.hpp"
+
+#include <algorithm>
+
+/**
+ * @brief  Compares sequence numbers with respect to wrap around
+ * @param  a: first sequence number
+ * @param  b: second sequence number
+ * @retval distance of a from b, negative if a precedes b
+ */
+static int32_t sequenceDiff(uint32_t a, uint32_t b) {
+  return static_cast<int32_t>(a - b);
+}
+
+/**
+ * @brief  Adds the segment to the stream, out of order data waits until the
+ * gap is filled and retransmitted data is dropped
+ * @param  &segment: TCP segment of this direction
+ * @retval None
+ */
+void TcpStream::add(const TcpSegment &segment) {
+  if (segment.flags & TCP_SYN) {
+    next_sequence = segment.sequence + 1;
+    started = true;
+    return;
+  }
+  if (segment.flags & (TCP_FIN | TCP_RST)) {
+    closed = true;
+  }
+  if (segment.length == 0) {
+    return;
+  }
+  if (!started) {
+    /* Capture started in the middle of the connection */
+    next_sequence = segment.sequence;
+    started = true;
+  }
+
+  int32_t diff = sequenceDiff(segment.sequence, next_sequence);
+  if (diff > 0) {
+    pending[segment.sequence] = std::make_pair(
+        std::string(reinterpret_cast<const char *>(segment.payload),
+                    segment.length),
+        segment.timestamp);
+    return;
+  }
+  if (static_cast<uint32_t>(-diff) >= segment.length) {
+    return;
+  }
+  arrivals.emplace_back(data.size(), segment.timestamp);
+  data.append(reinterpret_cast<const char *>(segment.payload) - diff,
+              segment.length + diff);
+  next_sequence = segment.sequence + segment.length;
+
+  /* Segments waiting for this one */
+  while (!pending.empty()) {
+    auto first = pending.begin();
+    int32_t gap = sequenceDiff(first->first, next_sequence);
+    if (gap > 0) {
+      break;
+    }
+    const std::string &chunk = first->second.first;
+    if (static_cast<size_t>(-gap) < chunk.size()) {
+      arrivals.emplace_back(data.size(), first->second.second);
+      data.append(chunk, -gap, std::string::npos);
+      next_sequence = first->first + static_cast<uint32_t>(chunk.size());
+    }
+    pending.erase(first);
+  }
+}
+
+/**
+ * @brief  Returns time when the byte of the stream arrived
+ * @param  offset: position in the stream data
+ * @retval timestamp in nanoseconds
+ */
+uint64_t TcpStream::timestampAt(size_t offset) const {
+  if (arrivals.empty()) {
+    return 0;
+  }
+  auto arrival = std::upper_bound(
+      arrivals.begin(), arrivals.end(), offset,
+      [](size_t value, const std::pair<size_t, uint64_t> &item) {
+        return value < item.first;
+      });
+  if (arrival != arrivals.begin()) {
+    --arrival;
+  }
+  return arrival->second;
+}
+
+/**
+ * @brief  Cuts the stream data into complete protocol messages
+ * @retval Vector of messages
+ */
+std::vector<StreamMessage> TcpStream::messages() const {
+  std::vector<StreamMessage> container;
+  size_t offset{};
+  while (offset < data.size()) {
+    size_t start = data.find('(', offset);
+    if (start == std::string::npos) {
+      break;
+    }
+    size_t end = SExpression::findEnd(data, start);
+    if (end == 0) {
+      break;
+    }
+    StreamMessage message;
+    message.data = data.substr(start, end);
+    message.first_timestamp = timestampAt(start);
+    message.last_timestamp = timestampAt(start + end - 1);
+    container.push_back(message);
+    offset = start + end;
+  }
+  return container;
+}
+
+/**
+ * @brief  TcpReassembler constructor
+ * @param  port: server port
+ * @param  on_flow: called with every finished connection
+ * @retval Constructed object
+ */
+TcpReassembler::TcpReassembler(uint16_t port,
+                               std::function<void(TcpFlow &)> on_flow)
+    : _port(port), _on_flow(on_flow) {}
+
+/**
+ * @brief  Hands the connection over to the callback and forgets it
+ * @param  &key: connection key
+ * @retval None
+ */
+void TcpReassembler::finish(const std::string &key) {
+  auto flow = _flows.find(key);
+  if (flow == _flows.end()) {
+    return;
+  }
+  _on_flow(flow->second);
+  _flows.erase(flow);
+}
+
+/**
+ * @brief  Adds the segment to its connection
+ * @param  &segment: decoded TCP segment
+ * @retval None
+ */
+void TcpReassembler::add(const TcpSegment &segment) {
+  bool to_server = segment.destination_port == _port;
+  if (!to_server && segment.source_port != _port) {
+    return;
+  }
+
+  const std::string &client = to_server ? segment.source : segment.destination;
+  uint16_t client_port =
+      to_server ? segment.source_port : segment.destination_port;
+  std::string key = client + "#" + std::to_string(client_port);
+
+  /* New SYN on the same client port starts a new connection */
+  if (to_server && (segment.flags & TCP_SYN) && !(segment.flags & TCP_ACK)) {
+    finish(key);
+  }
+
+  auto found = _flows.find(key);
+  if (found == _flows.end()) {
+    /* Trailing acknowledgements of already finished connections */
+    if (!(segment.flags & TCP_SYN) && segment.length == 0) {
+      return;
+    }
+    TcpFlow &flow = _flows[key];
+    flow.client_address = client;
+    flow.client_port = client_port;
+    flow.server_address = to_server ? segment.destination : segment.source;
+    flow.server_port = _port;
+    flow.start = segment.timestamp;
+    found = _flows.find(key);
+  }
+
+  TcpFlow &flow = found->second;
+  if (to_server) {
+    flow.request.add(segment);
+  } else {
+    flow.response.add(segment);
+  }
+
+  if ((segment.flags & TCP_RST) ||
+      (flow.request.closed && flow.response.closed)) {
+    finish(key);
+  }
+}
+
+/**
+ * @brief  Hands over all connections that were not closed in the capture
+ * @retval None
+ */
+void TcpReassembler::flush() {
+  std::vector<std::string> keys;
+  for (auto &flow : _flows) {
+    keys.push_back(flow.first);
+  }
+  for (auto &key : keys) {
+    finish(key);
+  }
+}
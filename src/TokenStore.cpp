@@ -0,0 +1,486 @@
+#include "../include/TokenStore.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char TOKEN_MAGIC[] = "ISATOK02";
+const size_t TOKEN_HEADER_LENGTH = 40;
+/* Header fields behind the magic */
+const size_t TOKEN_CAPACITY = 8;
+const size_t TOKEN_COUNT = 16;
+const size_t TOKEN_TOMBSTONES = 24;
+const size_t TOKEN_END = 32;
+/* Slot fields, the record holds the key followed by the token */
+const size_t SLOT_HASH = 0;
+const size_t SLOT_STATE = 8;
+const size_t SLOT_KEY_LENGTH = 12;
+const size_t SLOT_TOKEN_LENGTH = 16;
+const size_t SLOT_RECORD = 24;
+const uint8_t SLOT_EMPTY = 0;
+const uint8_t SLOT_USED = 1;
+const uint8_t SLOT_DELETED = 2;
+const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+const uint64_t FNV_PRIME_64 = 1099511628211ull;
+
+/**
+ * @brief  Computes FNV-1a hash of the key
+ * @param  &key: key
+ * @retval hash
+ */
+static uint64_t hashKey(const std::string &key) {
+  uint64_t hash = FNV_OFFSET_BASIS;
+  for (unsigned char c : key) {
+    hash = (hash ^ c) * FNV_PRIME_64;
+  }
+  return hash;
+}
+
+/**
+ * @brief  Reads 32-bit length of the slot
+ * @param  *slot: slot
+ * @param  field: offset of the length within the slot
+ * @retval length
+ */
+static uint32_t readLength(const uint8_t *slot, size_t field) {
+  uint32_t length;
+  memcpy(&length, slot + field, sizeof(length));
+  return length;
+}
+
+/**
+ * @brief  TokenStore constructor, the store is opened by open
+ * @param  filename: store file
+ * @retval Constructed object
+ */
+TokenStore::TokenStore(const std::string filename) : _filename(filename) {}
+
+/**
+ * @brief  TokenStore destructor, unmaps the store
+ * @retval None
+ */
+TokenStore::~TokenStore() { unmap(); }
+
+/**
+ * @brief  Joins server and username into the key, a newline does not occur
+ * in server names
+ * @param  &server: name of the server including its port
+ * @param  &user: username
+ * @retval key
+ */
+std::string TokenStore::makeKey(const std::string &server,
+                                const std::string &user) {
+  return server + "\n" + user;
+}
+
+/**
+ * @brief  Maps the store, it is extended to the size first when shorter
+ * @param  size: size of the mapping in bytes
+ * @retval True: store is mapped | False: mapping failed
+ */
+bool TokenStore::map(size_t size) {
+  struct stat info;
+  if (fstat(_fd, &info) == -1 ||
+      (static_cast<size_t>(info.st_size) < size &&
+       ftruncate(_fd, size) == -1)) {
+    return false;
+  }
+  if (_data) {
+    munmap(_data, _size);
+    _data = nullptr;
+    _size = 0;
+  }
+  void *mapped =
+      mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+  if (mapped == MAP_FAILED) {
+    return false;
+  }
+  _data = static_cast<uint8_t *>(mapped);
+  _size = size;
+  return true;
+}
+
+/**
+ * @brief  Unmaps and closes the store
+ * @retval None
+ */
+void TokenStore::unmap() {
+  if (_data) {
+    munmap(_data, _size);
+    _data = nullptr;
+    _size = 0;
+  }
+  if (_fd != -1) {
+    close(_fd);
+    _fd = -1;
+  }
+}
+
+/**
+ * @brief  Locks the store against other processes
+ * @param  exclusive: True: store is changed | False: store is only read
+ * @retval True: store is locked | False: locking failed
+ */
+bool TokenStore::lock(bool exclusive) {
+  return flock(_fd, exclusive ? LOCK_EX : LOCK_SH) == 0;
+}
+
+/**
+ * @brief  Unlocks the store
+ * @retval None
+ */
+void TokenStore::unlock() { flock(_fd, LOCK_UN); }
+
+/**
+ * @brief  Maps the whole store again when another process grew it, to be
+ * called with the lock held
+ * @retval True: mapping is current and valid | False: store is not valid
+ */
+bool TokenStore::refresh() {
+  struct stat info;
+  if (fstat(_fd, &info) == -1 ||
+      static_cast<size_t>(info.st_size) < TOKEN_HEADER_LENGTH) {
+    return false;
+  }
+  if (static_cast<size_t>(info.st_size) != _size && !map(info.st_size)) {
+    return false;
+  }
+  uint64_t capacity = readHeader(TOKEN_CAPACITY);
+  uint64_t end = readHeader(TOKEN_END);
+  return memcmp(_data, TOKEN_MAGIC, sizeof(TOKEN_MAGIC) - 1) == 0 &&
+         capacity && !(capacity & (capacity - 1)) &&
+         capacity <= _size / SLOT_LENGTH &&
+         TOKEN_HEADER_LENGTH + capacity * SLOT_LENGTH <= end && end <= _size;
+}
+
+/**
+ * @brief  Reads the header field
+ * @param  field: offset of the field
+ * @retval value
+ */
+uint64_t TokenStore::readHeader(size_t field) const {
+  uint64_t value;
+  memcpy(&value, _data + field, sizeof(value));
+  return value;
+}
+
+/**
+ * @brief  Writes the header field
+ * @param  field: offset of the field
+ * @param  value: value
+ * @retval None
+ */
+void TokenStore::writeHeader(size_t field, uint64_t value) {
+  memcpy(_data + field, &value, sizeof(value));
+}
+
+/**
+ * @brief  Returns the slot of the table
+ * @param  index: index of the slot
+ * @retval slot
+ */
+uint8_t *TokenStore::getSlot(uint64_t index) const {
+  return _data + TOKEN_HEADER_LENGTH + index * SLOT_LENGTH;
+}
+
+/**
+ * @brief  Returns the record of the slot
+ * @param  *slot: used slot
+ * @retval key followed by the token, nullptr when it is out of the records
+ */
+const uint8_t *TokenStore::getRecord(const uint8_t *slot) const {
+  uint64_t offset;
+  memcpy(&offset, slot + SLOT_RECORD, sizeof(offset));
+  uint64_t length = static_cast<uint64_t>(readLength(slot, SLOT_KEY_LENGTH)) +
+                    readLength(slot, SLOT_TOKEN_LENGTH);
+  uint64_t start =
+      TOKEN_HEADER_LENGTH + readHeader(TOKEN_CAPACITY) * SLOT_LENGTH;
+  uint64_t end = readHeader(TOKEN_END);
+  return offset >= start && offset <= end && length <= end - offset
+             ? _data + offset
+             : nullptr;
+}
+
+/**
+ * @brief  Finds the slot of the key by linear probing
+ * @param  &key: key
+ * @param  hash: hash of the key
+ * @param  insert: True: the first free slot is returned when the key is
+ * missing | False: only the slot of the key is returned
+ * @retval index of the slot, capacity when there is none
+ */
+uint64_t TokenStore::findSlot(const std::string &key, uint64_t hash,
+                              bool insert) const {
+  uint64_t capacity = readHeader(TOKEN_CAPACITY);
+  uint64_t free_slot = capacity;
+  for (uint64_t probe = 0; probe < capacity; probe++) {
+    uint64_t index = (hash + probe) & (capacity - 1);
+    const uint8_t *slot = getSlot(index);
+    uint8_t state = slot[SLOT_STATE];
+    if (state == SLOT_EMPTY) {
+      return insert && free_slot == capacity ? index : free_slot;
+    }
+    if (state == SLOT_DELETED) {
+      if (insert && free_slot == capacity) {
+        free_slot = index;
+      }
+      continue;
+    }
+    uint64_t slot_hash;
+    memcpy(&slot_hash, slot + SLOT_HASH, sizeof(slot_hash));
+    const uint8_t *record = getRecord(slot);
+    if (slot_hash == hash && record &&
+        readLength(slot, SLOT_KEY_LENGTH) == key.size() &&
+        memcmp(record, key.data(), key.size()) == 0) {
+      return index;
+    }
+  }
+  return free_slot;
+}
+
+/**
+ * @brief  Rebuilds the table without deleted slots, twice larger when it is
+ * half full, and packs the live records behind it, to be called with the
+ * exclusive lock held
+ * @param  extra: length of the record about to be added
+ * @retval True: table was rebuilt | False: store could not be extended
+ */
+bool TokenStore::grow(uint64_t extra) {
+  struct Record {
+    uint64_t hash;
+    uint32_t key_length;
+    std::string data;
+  };
+  uint64_t capacity = readHeader(TOKEN_CAPACITY);
+  uint64_t count = readHeader(TOKEN_COUNT);
+  std::vector<Record> records;
+  records.reserve(count);
+  uint64_t live{};
+  for (uint64_t i = 0; i < capacity; i++) {
+    const uint8_t *slot = getSlot(i);
+    const uint8_t *record = getRecord(slot);
+    if (slot[SLOT_STATE] != SLOT_USED || !record) {
+      continue;
+    }
+    uint64_t hash;
+    memcpy(&hash, slot + SLOT_HASH, sizeof(hash));
+    uint32_t key_length = readLength(slot, SLOT_KEY_LENGTH);
+    records.push_back(
+        {hash, key_length,
+         std::string(reinterpret_cast<const char *>(record),
+                     key_length + readLength(slot, SLOT_TOKEN_LENGTH))});
+    live += records.back().data.size();
+  }
+
+  /* Records get twice the room they take so that updates append for a while
+   * before the next rebuild */
+  uint64_t new_capacity = count * 2 >= capacity ? capacity * 2 : capacity;
+  uint64_t start = TOKEN_HEADER_LENGTH + new_capacity * SLOT_LENGTH;
+  uint64_t size = start + std::max<uint64_t>(INITIAL_RECORDS,
+                                             (live + extra) * 2);
+  if (!map(std::max<uint64_t>(size, _size))) {
+    return false;
+  }
+  memset(getSlot(0), 0, new_capacity * SLOT_LENGTH);
+  writeHeader(TOKEN_CAPACITY, new_capacity);
+  writeHeader(TOKEN_COUNT, records.size());
+  writeHeader(TOKEN_TOMBSTONES, 0);
+  uint64_t end = start;
+  for (auto &record : records) {
+    for (uint64_t probe = 0;; probe++) {
+      uint8_t *slot = getSlot((record.hash + probe) & (new_capacity - 1));
+      if (slot[SLOT_STATE] == SLOT_EMPTY) {
+        uint32_t token_length =
+            static_cast<uint32_t>(record.data.size() - record.key_length);
+        memcpy(slot + SLOT_HASH, &record.hash, sizeof(record.hash));
+        memcpy(slot + SLOT_KEY_LENGTH, &record.key_length,
+               sizeof(record.key_length));
+        memcpy(slot + SLOT_TOKEN_LENGTH, &token_length, sizeof(token_length));
+        memcpy(slot + SLOT_RECORD, &end, sizeof(end));
+        slot[SLOT_STATE] = SLOT_USED;
+        break;
+      }
+    }
+    memcpy(_data + end, record.data.data(), record.data.size());
+    end += record.data.size();
+  }
+  writeHeader(TOKEN_END, end);
+  return true;
+}
+
+/**
+ * @brief  Opens or creates the store
+ * @retval True: store is ready | False: store is not valid
+ */
+bool TokenStore::open() {
+  _fd = ::open(_filename.c_str(), O_RDWR | O_CREAT, 0600);
+  if (_fd == -1 || !lock(true)) {
+    unmap();
+    return false;
+  }
+  struct stat info;
+  bool valid = fstat(_fd, &info) != -1;
+  if (valid && static_cast<size_t>(info.st_size) < TOKEN_HEADER_LENGTH) {
+    valid = map(TOKEN_HEADER_LENGTH + INITIAL_CAPACITY * SLOT_LENGTH +
+                INITIAL_RECORDS);
+    if (valid) {
+      memcpy(_data, TOKEN_MAGIC, sizeof(TOKEN_MAGIC) - 1);
+      writeHeader(TOKEN_CAPACITY, INITIAL_CAPACITY);
+      writeHeader(TOKEN_COUNT, 0);
+      writeHeader(TOKEN_TOMBSTONES, 0);
+      writeHeader(TOKEN_END,
+                  TOKEN_HEADER_LENGTH + INITIAL_CAPACITY * SLOT_LENGTH);
+    }
+  }
+  valid = valid && refresh();
+  unlock();
+  if (!valid) {
+    unmap();
+  }
+  return valid;
+}
+
+/**
+ * @brief  Looks up the login token of the user on the server
+ * @param  &server: name of the server including its port
+ * @param  &user: username
+ * @param  &token: login token
+ * @retval True: user is logged in | False: there is no token
+ */
+bool TokenStore::get(const std::string &server, const std::string &user,
+                     std::string &token) {
+  std::string key = makeKey(server, user);
+  if (!lock(false)) {
+    return false;
+  }
+  bool found{false};
+  if (refresh()) {
+    uint64_t index = findSlot(key, hashKey(key), false);
+    if (index < readHeader(TOKEN_CAPACITY)) {
+      const uint8_t *slot = getSlot(index);
+      token.assign(reinterpret_cast<const char *>(getRecord(slot)) +
+                       readLength(slot, SLOT_KEY_LENGTH),
+                   readLength(slot, SLOT_TOKEN_LENGTH));
+      found = true;
+    }
+  }
+  unlock();
+  return found;
+}
+
+/**
+ * @brief  Returns users logged in to the server, the whole table is scanned
+ * @param  &server: name of the server including its port
+ * @retval usernames
+ */
+std::vector<std::string> TokenStore::getUsers(const std::string &server) {
+  std::vector<std::string> users;
+  std::string prefix = makeKey(server, "");
+  if (!lock(false)) {
+    return users;
+  }
+  if (refresh()) {
+    uint64_t capacity = readHeader(TOKEN_CAPACITY);
+    for (uint64_t i = 0; i < capacity; i++) {
+      const uint8_t *slot = getSlot(i);
+      const uint8_t *record = getRecord(slot);
+      uint32_t length = readLength(slot, SLOT_KEY_LENGTH);
+      if (slot[SLOT_STATE] == SLOT_USED && record && length >= prefix.size() &&
+          memcmp(record, prefix.data(), prefix.size()) == 0) {
+        users.emplace_back(reinterpret_cast<const char *>(record) +
+                               prefix.size(),
+                           length - prefix.size());
+      }
+    }
+  }
+  unlock();
+  return users;
+}
+
+/**
+ * @brief  Stores the login token of the user on the server, a token not
+ * longer than the stored one is written in place, others are appended to the
+ * records, the table is rebuilt when it is three quarters full or the
+ * records run out of room
+ * @param  &server: name of the server including its port
+ * @param  &user: username
+ * @param  &token: login token
+ * @retval True: token is stored | False: the store could not be changed
+ */
+bool TokenStore::put(const std::string &server, const std::string &user,
+                     const std::string &token) {
+  std::string key = makeKey(server, user);
+  if (key.size() > UINT32_MAX || token.size() > UINT32_MAX || !lock(true)) {
+    return false;
+  }
+  bool stored = refresh();
+  uint64_t hash = hashKey(key);
+  uint64_t length = key.size() + token.size();
+  if (stored &&
+      ((readHeader(TOKEN_COUNT) + readHeader(TOKEN_TOMBSTONES) + 1) * 4 >
+           readHeader(TOKEN_CAPACITY) * 3 ||
+       readHeader(TOKEN_END) + length > _size)) {
+    stored = grow(length);
+  }
+  uint64_t index = stored ? findSlot(key, hash, true) : 0;
+  if (stored && index < readHeader(TOKEN_CAPACITY)) {
+    uint8_t *slot = getSlot(index);
+    uint32_t token_length = static_cast<uint32_t>(token.size());
+    uint64_t record;
+    if (slot[SLOT_STATE] == SLOT_USED &&
+        readLength(slot, SLOT_TOKEN_LENGTH) >= token.size()) {
+      memcpy(&record, slot + SLOT_RECORD, sizeof(record));
+    } else {
+      if (slot[SLOT_STATE] == SLOT_DELETED) {
+        writeHeader(TOKEN_TOMBSTONES, readHeader(TOKEN_TOMBSTONES) - 1);
+      }
+      if (slot[SLOT_STATE] != SLOT_USED) {
+        writeHeader(TOKEN_COUNT, readHeader(TOKEN_COUNT) + 1);
+      }
+      record = readHeader(TOKEN_END);
+      writeHeader(TOKEN_END, record + length);
+    }
+    uint32_t key_length = static_cast<uint32_t>(key.size());
+    memcpy(_data + record, key.data(), key.size());
+    memcpy(_data + record + key.size(), token.data(), token.size());
+    memcpy(slot + SLOT_HASH, &hash, sizeof(hash));
+    memcpy(slot + SLOT_KEY_LENGTH, &key_length, sizeof(key_length));
+    memcpy(slot + SLOT_TOKEN_LENGTH, &token_length, sizeof(token_length));
+    memcpy(slot + SLOT_RECORD, &record, sizeof(record));
+    slot[SLOT_STATE] = SLOT_USED;
+  } else {
+    stored = false;
+  }
+  unlock();
+  return stored;
+}
+
+/**
+ * @brief  Removes the login token of the user on the server, the slot is
+ * left as a tombstone for probing
+ * @param  &server: name of the server including its port
+ * @param  &user: username
+ * @retval True: token was removed | False: there was no token
+ */
+bool TokenStore::remove(const std::string &server, const std::string &user) {
+  std::string key = makeKey(server, user);
+  if (!lock(true)) {
+    return false;
+  }
+  bool removed{false};
+  if (refresh()) {
+    uint64_t index = findSlot(key, hashKey(key), false);
+    if (index < readHeader(TOKEN_CAPACITY)) {
+      getSlot(index)[SLOT_STATE] = SLOT_DELETED;
+      writeHeader(TOKEN_COUNT, readHeader(TOKEN_COUNT) - 1);
+      writeHeader(TOKEN_TOMBSTONES, readHeader(TOKEN_TOMBSTONES) + 1);
+      removed = true;
+    }
+  }
+  unlock();
+  return removed;
+}
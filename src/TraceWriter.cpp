@@ -0,0 +1,172 @@
+#include "../include/TraceWriter.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+/**
+ * @brief  TraceWriter constructor
+ * @param  process: name of the process shown in the trace viewer
+ * @retval Constructed object
+ */
+TraceWriter::TraceWriter(std::string process) : _process(process) {}
+
+/**
+ * @brief  Writes string escaped for JSON
+ * @param  &os: output stream
+ * @param  &value: string to be written
+ * @retval None
+ */
+void TraceWriter::writeEscaped(std::ostream &os, const std::string &value) {
+  for (char c : value) {
+    switch (c) {
+    case '"':
+      os << "\\\"";
+      break;
+    case '\\':
+      os << "\\\\";
+      break;
+    case '\n':
+      os << "\\n";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        os << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+           << static_cast<int>(c) << std::dec << std::setfill(' ');
+      } else {
+        os << c;
+      }
+    }
+  }
+}
+
+/**
+ * @brief  Names the track, spans of one track never overlap
+ * @param  track: track identifier
+ * @param  name: name shown in the trace viewer
+ * @retval None
+ */
+void TraceWriter::setTrackName(int track, const std::string name) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _tracks[track] = name;
+}
+
+/**
+ * @brief  Adds one span to the trace
+ * @param  track: track identifier
+ * @param  name: span name
+ * @param  category: span category
+ * @param  start: start timestamp
+ * @param  end: end timestamp
+ * @param  args: JSON object members shown with the span
+ * @retval None
+ */
+void TraceWriter::addSpan(int track, const std::string name,
+                          const std::string category, uint64_t start,
+                          uint64_t end, const std::string args) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _events.push_back(
+      {name, category, track, start, std::max(start, end), args});
+}
+
+/**
+ * @brief  Adds the request span with its connect, send, wait, receive and
+ * parse phases, a phase that never started is left out, so a failed connect
+ * gives the request and connect spans only
+ * @param  track: track of the connection
+ * @param  command: command of the request
+ * @param  &timing: timestamps of the request
+ * @param  parse_end: timestamp when the response was processed
+ * @retval None
+ */
+void TraceWriter::addRequest(int track, const std::string command,
+                             const RequestTiming &timing,
+                             uint64_t parse_end) {
+  /* The server may close the connection without sending anything */
+  uint64_t first_byte =
+      timing.first_byte ? timing.first_byte : timing.last_byte;
+  std::string args = "\"bytes_sent\":" + std::to_string(timing.bytes_sent) +
+                     ",\"bytes_received\":" +
+                     std::to_string(timing.bytes_received) +
+                     ",\"syscalls\":" + std::to_string(timing.syscalls);
+
+  /* Zero timestamps would move the origin of the whole trace to zero */
+  auto addPhase = [&](const char *name, const char *category, uint64_t start,
+                      uint64_t end) {
+    if (start) {
+      _events.push_back(
+          {name, category, track, start, std::max(start, end), ""});
+    }
+  };
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (!timing.connect_start) {
+    return;
+  }
+  _events.push_back({command, "request", track, timing.connect_start,
+                     std::max(timing.connect_start, parse_end), args});
+  addPhase("connect", "network", timing.connect_start, timing.connect_end);
+  if (!timing.send_start) {
+    return;
+  }
+  addPhase("send", "network", timing.send_start, timing.send_end);
+  addPhase("wait", "network", timing.send_end, first_byte);
+  addPhase("receive", "network", first_byte, timing.last_byte);
+  addPhase("parse", "client", timing.last_byte, parse_end);
+}
+
+/**
+ * @brief  Returns number of collected spans
+ * @retval number of spans
+ */
+size_t TraceWriter::getEventCount() const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _events.size();
+}
+
+/**
+ * @brief  Writes the trace in Chrome Trace Event JSON format, timestamps are
+ * in microseconds from the first span
+ * @param  &os: output stream
+ * @retval None
+ */
+void TraceWriter::write(std::ostream &os) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  uint64_t origin{};
+  if (!_events.empty()) {
+    origin = std::min_element(_events.begin(), _events.end(),
+                              [](const TraceEvent &a, const TraceEvent &b) {
+                                return a.start < b.start;
+                              })
+                 ->start;
+  }
+
+  os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[" << std::endl;
+  os << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+        "\"args\":{\"name\":\"";
+  writeEscaped(os, _process);
+  os << "\"}}";
+  for (auto &track : _tracks) {
+    os << "," << std::endl
+       << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+       << track.first << ",\"args\":{\"name\":\"";
+    writeEscaped(os, track.second);
+    os << "\"}},{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,"
+          "\"tid\":"
+       << track.first << ",\"args\":{\"sort_index\":" << track.first << "}}";
+  }
+
+  os << std::fixed << std::setprecision(3);
+  for (auto &event : _events) {
+    os << "," << std::endl << "{\"name\":\"";
+    writeEscaped(os, event.name);
+    os << "\",\"cat\":\"" << event.category
+       << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.track
+       << ",\"ts\":" << (event.start - origin) / 1e3
+       << ",\"dur\":" << (event.end - event.start) / 1e3;
+    if (!event.args.empty()) {
+      os << ",\"args\":{" << event.args << "}";
+    }
+    os << "}";
+  }
+  os << std::endl << "]}" << std::endl;
+}